@@ -0,0 +1,200 @@
+/* *****************************************************************************
+ * 
+ * Name:    blur.c
+ * Author:  Gabriel Gonzalez
+ * Email:   gabeg@bu.edu
+ * License: The MIT License (MIT)
+ * 
+ * Description: Benchmark the background blur.
+ *              
+ * Notes: Usage: elmbench-blur [radius] [runs]
+ * 
+ *        The plain C kernel and the SSE2 one blur the same noise, at the size
+ *        of the default frame and of a full HD screen. Before either is timed,
+ *        both are run on the same pixels at a few radii and the results are
+ *        compared, and the benchmark fails if a single pixel differs.
+ * 
+ *        Without SSE2, elm_blur() uses the plain C kernel as well, so the
+ *        comparison passes trivially and the timings are the same.
+ * 
+ * *****************************************************************************
+ */
+
+/* Includes */
+#include "elmbench.h"
+#include "elmblur.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Defines */
+#define ELM_BENCH_BLUR_RADIUS 8
+
+/* Typedefs */
+typedef struct
+{
+    int       width;
+    int       height;
+    int       radius;
+    uint32_t *pixels;
+} ElmBenchBlur;
+
+/* Private functions */
+static void elm_bench_blur_new(void *data);
+static void elm_bench_blur_scalar(void *data);
+static int  elm_bench_blur_compare(int width, int height, int radius);
+static void elm_bench_blur_fill(uint32_t *pixels, size_t count);
+
+/* Private variables */
+static const int Sizes[][2] = {{270, 150}, {1920, 1080}};
+static const int Radii[]    = {1, 8, 40};
+
+/* ************************************************************************** */
+/* Run the benchmark */
+int main(int argc, char **argv)
+{
+    int          radius = (argc > 1) ? atoi(argv[1]) : ELM_BENCH_BLUR_RADIUS;
+    int          runs   = elm_bench_get_runs(argc, argv, 2);
+    ElmBenchBlur bench;
+    char         name[64];
+    size_t       i;
+    size_t       j;
+
+    if (radius <= 0) {
+        fprintf(stderr, "Usage: %s [radius] [runs]\n", argv[0]);
+        return 1;
+    }
+
+    for (i=0; i < sizeof(Sizes)/sizeof(*Sizes); i++)
+    {
+        for (j=0; j < sizeof(Radii)/sizeof(*Radii); j++) {
+            if (elm_bench_blur_compare(Sizes[i][0], Sizes[i][1], Radii[j])) {
+                return 2;
+            }
+        }
+
+        /* And at the radius that is timed, unless it was just checked */
+        for (j=0; (j < sizeof(Radii)/sizeof(*Radii)) && (Radii[j] != radius);
+             j++) {}
+
+        if ((j == sizeof(Radii)/sizeof(*Radii))
+            && elm_bench_blur_compare(Sizes[i][0], Sizes[i][1], radius))
+        {
+            return 2;
+        }
+    }
+
+    for (i=0; i < sizeof(Sizes)/sizeof(*Sizes); i++)
+    {
+        bench.width  = Sizes[i][0];
+        bench.height = Sizes[i][1];
+        bench.radius = radius;
+
+        if (!(bench.pixels=malloc(sizeof(uint32_t) * bench.width
+                                  * bench.height)))
+        {
+            return 1;
+        }
+
+        elm_bench_blur_fill(bench.pixels, bench.width*bench.height);
+
+        snprintf(name, sizeof(name), "blur: scalar, %dx%d", bench.width,
+                 bench.height);
+        elm_bench_run(name, elm_bench_blur_scalar, &bench, runs,
+                      bench.width*bench.height);
+
+        snprintf(name, sizeof(name), "blur: elm_blur, %dx%d", bench.width,
+                 bench.height);
+        elm_bench_run(name, elm_bench_blur_new, &bench, runs,
+                      bench.width*bench.height);
+
+        free(bench.pixels);
+    }
+
+    return 0;
+}
+
+/* ************************************************************************** */
+/* Blur with the fastest kernel */
+void elm_bench_blur_new(void *data)
+{
+    ElmBenchBlur *bench = data;
+
+    elm_blur(bench->pixels, bench->width, bench->height, bench->width,
+             bench->radius);
+}
+
+/* ************************************************************************** */
+/* Blur with the plain C kernel */
+void elm_bench_blur_scalar(void *data)
+{
+    ElmBenchBlur *bench = data;
+
+    elm_blur_scalar(bench->pixels, bench->width, bench->height, bench->width,
+                    bench->radius);
+}
+
+/* ************************************************************************** */
+/* Blur the same pixels with both kernels and report the first pixel that
+ * differs. The rows are padded, the way cairo pads them, so that the stride is
+ * used too. */
+int elm_bench_blur_compare(int width, int height, int radius)
+{
+    int       stride = width + 3;
+    size_t    count  = (size_t)stride * height;
+    uint32_t *fast   = malloc(sizeof(*fast) * count);
+    uint32_t *slow   = malloc(sizeof(*slow) * count);
+    int       status = 0;
+    int       x;
+    int       y;
+
+    if (!fast || !slow) {
+        free(fast);
+        free(slow);
+        return -1;
+    }
+
+    elm_bench_blur_fill(fast, count);
+    memcpy(slow, fast, sizeof(*slow) * count);
+
+    if ((elm_blur(fast, width, height, stride, radius) < 0)
+        || (elm_blur_scalar(slow, width, height, stride, radius) < 0))
+    {
+        status = -1;
+        goto cleanup;
+    }
+
+    for (y=0; y < height; y++) {
+        for (x=0; x < width; x++) {
+            if (fast[y*stride+x] != slow[y*stride+x]) {
+                fprintf(stderr, "blur: %dx%d radius %d differs at (%d, %d): "
+                        "%08x, expected %08x\n", width, height, radius, x, y,
+                        fast[y*stride+x], slow[y*stride+x]);
+                status = -2;
+                goto cleanup;
+            }
+        }
+    }
+
+    fprintf(stderr, "blur: %dx%d radius %d, kernels match\n", width, height,
+            radius);
+
+cleanup:
+    free(fast);
+    free(slow);
+
+    return status;
+}
+
+/* ************************************************************************** */
+/* Fill pixels with the same noise every time */
+void elm_bench_blur_fill(uint32_t *pixels, size_t count)
+{
+    uint32_t seed = 1;
+    size_t   i;
+
+    for (i=0; i < count; i++) {
+        seed      = seed*1664525 + 1013904223;
+        pixels[i] = seed;
+    }
+}
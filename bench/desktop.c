@@ -0,0 +1,203 @@
+/* *****************************************************************************
+ * 
+ * Name:    desktop.c
+ * Author:  Gabriel Gonzalez
+ * Email:   gabeg@bu.edu
+ * License: The MIT License (MIT)
+ * 
+ * Description: Benchmark the desktop entry parser.
+ *              
+ * Notes: Usage: elmbench-desktop <dir> [runs]
+ * 
+ *        The directory is a fixture from 'fixtures.sh xsessions'. Each run
+ *        reads every session file in it. elm_str_read_desktop_entry() is
+ *        compared to what it replaced, two elm_str_findline() calls per file
+ *        for 'Name=' and 'Exec='. The old function is kept here as it was.
+ * 
+ *        The old substring match also picks up 'GenericName=' and 'TryExec='
+ *        lines, so the number of files where it found the wrong key is
+ *        reported too.
+ * 
+ * *****************************************************************************
+ */
+
+/* Includes */
+#include "elmbench.h"
+#include "elmdef.h"
+#include "elmstr.h"
+#include <dirent.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* Defines */
+#define ELM_BENCH_DESKTOP_LOCALE "fr_CA.UTF-8"
+
+/* Typedefs */
+typedef struct
+{
+    const char *dir;
+    size_t      files;
+    size_t      parsed;
+    size_t      wrong;
+} ElmBenchDesktop;
+
+/* Private functions */
+static void   elm_bench_desktop_new(void *data);
+static void   elm_bench_desktop_old(void *data);
+static char * elm_bench_old_findline(char *file, char *substring);
+
+/* ************************************************************************** */
+/* Run the benchmark */
+int main(int argc, char **argv)
+{
+    ElmBenchDesktop  bench = {0};
+    int              runs  = elm_bench_get_runs(argc, argv, 2);
+    DIR             *dir;
+    struct dirent   *entry;
+
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <dir> [runs]\n", argv[0]);
+        return 1;
+    }
+
+    if (!(dir=opendir(argv[1]))) {
+        perror(argv[1]);
+        return 1;
+    }
+
+    while ((entry=readdir(dir))) {
+        bench.files += (strstr(entry->d_name, ".desktop") != NULL);
+    }
+
+    closedir(dir);
+
+    bench.dir = argv[1];
+
+    elm_bench_run("desktop: findline x2", elm_bench_desktop_old, &bench, runs,
+                  bench.files);
+    fprintf(stderr, "%-32s %10zu of %zu files, %zu with a wrong key\n", "",
+            bench.parsed, bench.files, bench.wrong);
+
+    elm_bench_run("desktop: single pass", elm_bench_desktop_new, &bench, runs,
+                  bench.files);
+    fprintf(stderr, "%-32s %10zu of %zu files\n", "", bench.parsed,
+            bench.files);
+
+    return 0;
+}
+
+/* ************************************************************************** */
+/* Read every session file with the desktop entry parser */
+void elm_bench_desktop_new(void *data)
+{
+    ElmBenchDesktop    *bench = data;
+    ElmStrDesktopEntry  desktop;
+    DIR                *dir   = opendir(bench->dir);
+    struct dirent      *entry;
+    char                path[PATH_MAX];
+
+    bench->parsed = 0;
+
+    if (!dir) {
+        return;
+    }
+
+    while ((entry=readdir(dir)))
+    {
+        if (!strstr(entry->d_name, ".desktop")) {
+            continue;
+        }
+
+        snprintf(path, sizeof(path), "%s/%s", bench->dir, entry->d_name);
+
+        if (elm_str_read_desktop_entry(path, ELM_BENCH_DESKTOP_LOCALE,
+                                       &desktop) == 0)
+        {
+            bench->parsed++;
+            elm_str_free_desktop_entry(&desktop);
+        }
+    }
+
+    closedir(dir);
+}
+
+/* ************************************************************************** */
+/* Read every session file with two elm_str_findline() calls, the way the
+ * xsession app used to */
+void elm_bench_desktop_old(void *data)
+{
+    ElmBenchDesktop *bench = data;
+    DIR             *dir   = opendir(bench->dir);
+    struct dirent   *entry;
+    char             path[PATH_MAX];
+    char            *name;
+    char            *exec;
+
+    bench->parsed = 0;
+    bench->wrong  = 0;
+
+    if (!dir) {
+        return;
+    }
+
+    while ((entry=readdir(dir)))
+    {
+        if (!strstr(entry->d_name, ".desktop")) {
+            continue;
+        }
+
+        snprintf(path, sizeof(path), "%s/%s", bench->dir, entry->d_name);
+
+        name = elm_bench_old_findline(path, "Name=");
+        exec = elm_bench_old_findline(path, "Exec=");
+
+        if (name && exec) {
+            bench->parsed++;
+            bench->wrong += ((strncmp(name, "Name=", 5) != 0)
+                             || (strncmp(exec, "Exec=", 5) != 0));
+        }
+
+        free(name);
+        free(exec);
+    }
+
+    closedir(dir);
+}
+
+/* ************************************************************************** */
+/* Old elm_str_findline() */
+char * elm_bench_old_findline(char *file, char *substring)
+{
+    FILE *fhandle = NULL;
+    char *read    = NULL;
+
+    /* Make sure file can be read */
+    if (access(file, R_OK)) {
+        return NULL;
+    }
+
+    if (!(fhandle=fopen(file, "r"))) {
+        return NULL;
+    }
+
+    /* Read file */
+    char  line[ELM_MAX_PATH_SIZE] = {0};
+    char *strip;
+
+    while (fgets(line, sizeof(line), fhandle)) {
+        strip = elm_str_strip(line);
+
+        /* Match found */
+        if (strstr(strip, substring)) {
+            read = elm_str_copy(strip);
+            break;
+        }
+    }
+
+    fclose(fhandle);
+
+    return read;
+}
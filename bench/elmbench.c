@@ -0,0 +1,91 @@
+/* *****************************************************************************
+ * 
+ * Name:    elmbench.c
+ * Author:  Gabriel Gonzalez
+ * Email:   gabeg@bu.edu
+ * License: The MIT License (MIT)
+ * 
+ * Description: Timing harness shared by the benchmarks.
+ *              
+ * Notes: A benchmark is run once untimed, to warm the caches, then timed over
+ *        a number of runs. The mean and the fastest run are reported, along
+ *        with the number of items handled per second at the mean. Results go
+ *        to stderr, so that whatever the code under test prints to stdout can
+ *        be thrown away.
+ * 
+ * *****************************************************************************
+ */
+
+/* Includes */
+#include "elmbench.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/* ************************************************************************** */
+/* Return the number of runs given on the command line at an index, or the
+ * default */
+int elm_bench_get_runs(int argc, char **argv, int index)
+{
+    int runs;
+
+    if (index >= argc) {
+        return ELM_BENCH_RUNS;
+    }
+
+    runs = atoi(argv[index]);
+
+    return (runs > 0) ? runs : ELM_BENCH_RUNS;
+}
+
+/* ************************************************************************** */
+/* Return the monotonic time in nanoseconds */
+int64_t elm_bench_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (int64_t)ts.tv_sec*1000000000 + ts.tv_nsec;
+}
+
+/* ************************************************************************** */
+/* Time a function over a number of runs and report it. Items is how many
+ * things a single run handles, or 0 to leave out the rate. Return the mean
+ * time of a run, in milliseconds. */
+double elm_bench_run(const char *name, ElmBenchFunc func, void *data,
+                     int runs, double items)
+{
+    int64_t start;
+    int64_t elapsed;
+    int64_t total = 0;
+    int64_t best  = INT64_MAX;
+    double  mean;
+    int     i;
+
+    func(data);
+
+    for (i=0; i < runs; i++)
+    {
+        start   = elm_bench_now();
+
+        func(data);
+
+        elapsed = elm_bench_now() - start;
+        total  += elapsed;
+        best    = (elapsed < best) ? elapsed : best;
+    }
+
+    mean = (double)total / runs / 1e6;
+
+    if (items > 0) {
+        fprintf(stderr, "%-32s %10.3f ms/run (best %.3f ms) %12.0f /s\n",
+                name, mean, best/1e6, items/(mean/1e3));
+    }
+    else {
+        fprintf(stderr, "%-32s %10.3f ms/run (best %.3f ms)\n",
+                name, mean, best/1e6);
+    }
+
+    return mean;
+}
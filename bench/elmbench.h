@@ -0,0 +1,34 @@
+/* *****************************************************************************
+ * 
+ * Name:    elmbench.h
+ * Author:  Gabriel Gonzalez
+ * Email:   gabeg@bu.edu
+ * License: The MIT License (MIT)
+ * 
+ * Description: Timing harness shared by the benchmarks.
+ * 
+ * Notes: None.
+ * 
+ * *****************************************************************************
+ */
+
+/* Header guard */
+#ifndef ELM_BENCH_H
+#define ELM_BENCH_H
+
+/* Includes */
+#include <stdint.h>
+
+/* Default number of timed runs */
+#define ELM_BENCH_RUNS 20
+
+/* Typedefs */
+typedef void (*ElmBenchFunc)(void *data);
+
+/* Public functions  */
+int     elm_bench_get_runs(int argc, char **argv, int index);
+int64_t elm_bench_now(void);
+double  elm_bench_run(const char *name, ElmBenchFunc func, void *data,
+                      int runs, double items);
+
+#endif /* ELM_BENCH_H */
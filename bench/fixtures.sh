@@ -0,0 +1,119 @@
+#!/bin/sh
+# ------------------------------------------------------------------------------
+#
+# Name:    fixtures.sh
+# Author:  Gabriel Gonzalez
+# Email:   gabeg@bu.edu
+# License: The MIT License (MIT)
+#
+# Description: Generate the fixtures of the benchmarks.
+#
+# Notes: Usage: fixtures.sh <kind> <dir> <count>
+#
+#        proc: A fake /proc with <count> process directories, each with a
+#              cmdline file. The last process runs Xorg, and there are a few
+#              non-process entries, as in the real one.
+#
+#        xsessions: <count> xsession files, with a name in ten locales, a long
+#                   comment and a desktop action. Keys that the old substring
+#                   match confused, GenericName and TryExec, come before Name
+#                   and Exec. Some are hidden or have a TryExec that cannot
+#                   be found.
+#
+# ------------------------------------------------------------------------------
+
+usage()
+{
+    echo "Usage: ${0##*/} proc|xsessions <dir> <count>" 1>&2
+    exit 1
+}
+
+# ------------------------------------------------------------------------------
+# Fake /proc
+fixture_proc()
+{
+    dir="${1}"
+    count="${2}"
+
+    mkdir -p "${dir}/self" "${dir}/sys"
+    : > "${dir}/uptime"
+
+    # One mkdir for all of the process directories
+    (cd "${dir}" && seq 301 $((count + 300)) | xargs mkdir -p)
+
+    i=1
+    while [ ${i} -le ${count} ]
+    do
+        pid=$((i + 300))
+
+        if [ ${i} -eq ${count} ]
+        then
+            printf '/usr/bin/Xorg\0:0\0-nolisten\0tcp\0' > "${dir}/${pid}/cmdline"
+        else
+            printf '/usr/lib/worker\0--id\0%d\0' ${i} > "${dir}/${pid}/cmdline"
+        fi
+
+        i=$((i + 1))
+    done
+}
+
+# ------------------------------------------------------------------------------
+# Session files
+fixture_xsessions()
+{
+    dir="${1}"
+    count="${2}"
+    comment=$(printf '%0300d' 0 | tr 0 x)
+
+    mkdir -p "${dir}"
+
+    i=0
+    while [ ${i} -lt ${count} ]
+    do
+        {
+            printf '# Desktop file %d\n' ${i}
+            printf '[Desktop Entry]\nType=XSession\nEncoding=UTF-8\n'
+            printf 'GenericName=Generic %d\n' ${i}
+
+            if [ $((i % 3)) -eq 0 ]
+            then
+                printf 'TryExec=/bin/sh\n'
+            elif [ $((i % 7)) -eq 0 ]
+            then
+                printf 'TryExec=nonexistent-prog-%d\n' ${i}
+            fi
+
+            printf 'Name=Session %d\n' ${i}
+
+            for lang in de fr fr_CA es it ja zh_CN pt_BR ru sr@latin
+            do
+                printf 'Name[%s]=Sitzung %s %d\n' ${lang} ${lang} ${i}
+            done
+
+            printf 'Comment=%s\n' "${comment}"
+            printf 'Exec=start-session-%d --flag %%U\nIcon=foo\n' ${i}
+
+            if [ $((i % 50)) -eq 0 ]
+            then
+                printf 'NoDisplay=true\n'
+            fi
+
+            printf '\n[Desktop Action new]\nName=Action\nExec=other\n'
+        } > "$(printf '%s/s%04d.desktop' "${dir}" ${i})"
+
+        i=$((i + 1))
+    done
+}
+
+# ------------------------------------------------------------------------------
+# Main
+if [ $# -ne 3 ]
+then
+    usage
+fi
+
+case "${1}" in
+    proc)      fixture_proc "${2}" "${3}" ;;
+    xsessions) fixture_xsessions "${2}" "${3}" ;;
+    *)         usage ;;
+esac
@@ -0,0 +1,215 @@
+/* *****************************************************************************
+ * 
+ * Name:    log.c
+ * Author:  Gabriel Gonzalez
+ * Email:   gabeg@bu.edu
+ * License: The MIT License (MIT)
+ * 
+ * Description: Benchmark log messages per second.
+ *              
+ * Notes: Usage: elmbench-log [count] [runs]
+ * 
+ *        Each run logs a burst of messages from a forked child, and is timed
+ *        until the child exits, so that the messages still buffered by the
+ *        writer thread are counted too. A child that logs nothing is timed as
+ *        well, and the rates are also given without that fork and exit time.
+ *        The log file is under the ELM_LOG_DIR that the benchmarks are built
+ *        with.
+ * 
+ *        elmprintf() is compared to the writer it replaced, which opened the
+ *        log file, wrote one line and closed it again for every message. The
+ *        old writer is kept here as it was.
+ * 
+ *        The default burst is about what a login logs. A message that does not
+ *        fit in the ring is dropped rather than waited for, so the number of
+ *        lines that made it to the file is reported as well.
+ * 
+ * *****************************************************************************
+ */
+
+/* Includes */
+#include "elmbench.h"
+#include "elmdef.h"
+#include "elmio.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+/* Defines */
+#define ELM_BENCH_LOG_COUNT 200
+
+/* Typedefs */
+typedef struct
+{
+    int   count;
+    void  (*log)(int index);
+} ElmBenchLog;
+
+/* Private functions */
+static void   elm_bench_log_run(void *data);
+static void   elm_bench_log_report(const char *name, int count, double mean,
+                                   double base);
+static void   elm_bench_log_none(int index);
+static void   elm_bench_log_new(int index);
+static void   elm_bench_log_old(int index);
+static void   elm_bench_old_printf(ElmPrint mode, const char *vafmt, ...);
+static size_t elm_bench_log_lines(void);
+
+/* ************************************************************************** */
+/* Run the benchmark */
+int main(int argc, char **argv)
+{
+    int         count = (argc > 1) ? atoi(argv[1]) : ELM_BENCH_LOG_COUNT;
+    int         runs  = elm_bench_get_runs(argc, argv, 2);
+    ElmBenchLog none  = {0, elm_bench_log_none};
+    ElmBenchLog old   = {0, elm_bench_log_old};
+    ElmBenchLog new   = {0, elm_bench_log_new};
+    double      base;
+    double      mean;
+
+    if (count <= 0) {
+        fprintf(stderr, "Usage: %s [count] [runs]\n", argv[0]);
+        return 1;
+    }
+
+    none.count = count;
+    old.count  = count;
+    new.count  = count;
+
+    /* Both writers print to stdout as well */
+    if (!freopen("/dev/null", "w", stdout)) {
+        return 1;
+    }
+
+    mkdir(ELM_LOG_DIR, 0755);
+
+    base = elm_bench_run("log: fork and exit", elm_bench_log_run, &none, runs,
+                         0);
+    mean = elm_bench_run("log: open/write/close", elm_bench_log_run, &old,
+                         runs, count);
+
+    elm_bench_log_report("log: open/write/close", count, mean, base);
+
+    mean = elm_bench_run("log: elmprintf", elm_bench_log_run, &new, runs,
+                         count);
+
+    elm_bench_log_report("log: elmprintf", count, mean, base);
+
+    return 0;
+}
+
+/* ************************************************************************** */
+/* Log a burst of messages from a child, into an empty log file */
+void elm_bench_log_run(void *data)
+{
+    ElmBenchLog *bench = data;
+    pid_t        pid;
+    int          i;
+
+    unlink(ELM_LOG);
+
+    if ((pid=fork()) < 0) {
+        exit(1);
+    }
+
+    if (pid == 0) {
+        for (i=0; i < bench->count; i++) {
+            bench->log(i);
+        }
+
+        exit(0);
+    }
+
+    waitpid(pid, NULL, 0);
+}
+
+/* ************************************************************************** */
+/* Report the lines that made it to the log file, and the rate without the time
+ * it takes to fork and exit */
+void elm_bench_log_report(const char *name, int count, double mean,
+                          double base)
+{
+    fprintf(stderr, "%-32s %10zu of %d lines", name, elm_bench_log_lines(),
+            count);
+
+    if (mean > base) {
+        fprintf(stderr, ", %.0f /s without fork", count/((mean-base)/1e3));
+    }
+
+    fprintf(stderr, "\n");
+}
+
+/* ************************************************************************** */
+/* Log nothing */
+void elm_bench_log_none(int index)
+{
+}
+
+/* ************************************************************************** */
+/* Log a message with elmprintf() */
+void elm_bench_log_new(int index)
+{
+    elmprintf(LOGINFO, "Setting environment variable '%s' to '%d'.",
+              "ELM_BENCH", index);
+}
+
+/* ************************************************************************** */
+/* Log a message with the old writer */
+void elm_bench_log_old(int index)
+{
+    elm_bench_old_printf(LOGINFO, "Setting environment variable '%s' to '%d'.",
+                         "ELM_BENCH", index);
+}
+
+/* ************************************************************************** */
+/* Old elmprintf(), for an informational log message */
+void elm_bench_old_printf(ElmPrint mode, const char *vafmt, ...)
+{
+    static char  preamble[ELM_MAX_MSG_SIZE];
+    char         now[128];
+    time_t       t = time(0);
+    FILE        *stream;
+    va_list      ap;
+    va_list      aq;
+
+    strftime(now, sizeof(now), "%Y-%m-%d %I:%M:%S %p", localtime(&t));
+    snprintf(preamble, sizeof(preamble), "[%s] %s %s\n", now, "INFO ", vafmt);
+
+    va_start(ap, vafmt);
+    va_copy(aq, ap);
+
+    vfprintf(stdout, preamble, ap);
+
+    stream = fopen(ELM_LOG, "a+");
+    vfprintf(stream, preamble, aq);
+    fclose(stream);
+
+    va_end(aq);
+    va_end(ap);
+}
+
+/* ************************************************************************** */
+/* Count the lines in the log file */
+size_t elm_bench_log_lines(void)
+{
+    FILE   *stream = fopen(ELM_LOG, "r");
+    size_t  lines  = 0;
+    int     c;
+
+    if (!stream) {
+        return 0;
+    }
+
+    while ((c=fgetc(stream)) != EOF) {
+        lines += (c == '\n');
+    }
+
+    fclose(stream);
+
+    return lines;
+}
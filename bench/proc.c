@@ -0,0 +1,234 @@
+/* *****************************************************************************
+ * 
+ * Name:    proc.c
+ * Author:  Gabriel Gonzalez
+ * Email:   gabeg@bu.edu
+ * License: The MIT License (MIT)
+ * 
+ * Description: Benchmark the /proc scanner behind elm_sys_pgrep().
+ *              
+ * Notes: Usage: elmbench-proc <root> [runs]
+ * 
+ *        The root is a proc fixture from 'fixtures.sh proc', in which one
+ *        process runs Xorg. The streaming iterator is compared to the scan it
+ *        replaced, which copied every process directory name into an array,
+ *        then built a path and called stat(), access() and open() for each
+ *        one. The old scan is kept here as it was, with the proc root as a
+ *        parameter.
+ * 
+ * *****************************************************************************
+ */
+
+/* Includes */
+#include "elmbench.h"
+#include "elmsys.h"
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+/* Typedefs */
+typedef struct
+{
+    const char *root;
+    const char *program;
+    pid_t       pid;
+} ElmBenchProc;
+
+/* Private functions */
+static void    elm_bench_proc_new(void *data);
+static void    elm_bench_proc_old(void *data);
+static pid_t   elm_bench_old_pgrep(const char *root, const char *program);
+static char ** elm_bench_old_get_proc(const char *root);
+
+/* ************************************************************************** */
+/* Run the benchmark */
+int main(int argc, char **argv)
+{
+    ElmBenchProc match   = {NULL, "Xorg", 0};
+    ElmBenchProc nomatch = {NULL, "no-such-program", 0};
+    int          runs    = elm_bench_get_runs(argc, argv, 2);
+    pid_t        oldpid;
+
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <root> [runs]\n", argv[0]);
+        return 1;
+    }
+
+    match.root   = argv[1];
+    nomatch.root = argv[1];
+
+    elm_bench_run("proc: old scan, match", elm_bench_proc_old, &match, runs,
+                  0);
+    oldpid = match.pid;
+    elm_bench_run("proc: iterator, match", elm_bench_proc_new, &match, runs,
+                  0);
+
+    if (match.pid != oldpid) {
+        fprintf(stderr, "proc: old scan found %d, iterator found %d\n", oldpid,
+                match.pid);
+        return 2;
+    }
+
+    elm_bench_run("proc: old scan, no match", elm_bench_proc_old, &nomatch,
+                  runs, 0);
+    elm_bench_run("proc: iterator, no match", elm_bench_proc_new, &nomatch,
+                  runs, 0);
+
+    return 0;
+}
+
+/* ************************************************************************** */
+/* Look for the program with the streaming iterator, the way elm_sys_pgrep()
+ * does */
+void elm_bench_proc_new(void *data)
+{
+    ElmBenchProc *bench = data;
+    ElmSysProc    proc;
+    uid_t         uid   = getuid();
+
+    bench->pid = 0;
+
+    if (elm_sys_proc_open(&proc, bench->root,
+                          (uid > 0) ? uid : ELM_SYS_ANY_UID,
+                          bench->program) < 0)
+    {
+        return;
+    }
+
+    bench->pid = elm_sys_proc_next(&proc);
+
+    elm_sys_proc_close(&proc);
+}
+
+/* ************************************************************************** */
+/* Look for the program with the old scan */
+void elm_bench_proc_old(void *data)
+{
+    ElmBenchProc *bench = data;
+
+    bench->pid = elm_bench_old_pgrep(bench->root, bench->program);
+}
+
+/* ************************************************************************** */
+/* Old elm_sys_pgrep(). The process array is freed, which the old code forgot
+ * to do. */
+pid_t elm_bench_old_pgrep(const char *root, const char *program)
+{
+    uid_t         uid   = getuid();
+    pid_t         pid   = 0;
+    char         *ptr;
+    char         *end;
+    char         *fpath;
+    char          buffer[256];
+    struct stat   info;
+    int           nbytes;
+    int           fd;
+    size_t        size;
+
+    char **proc = elm_bench_old_get_proc(root);
+    size_t i;
+
+    if (!proc) {
+        return 0;
+    }
+
+    for (i=0; proc[i]; i++)
+    {
+        if (pid > 0) {
+            free(proc[i]);
+            continue;
+        }
+
+        size  = strlen(root) + strlen(proc[i]) + sizeof("//cmdline");
+        fpath = malloc(size);
+
+        snprintf(fpath, size, "%s/%s/cmdline", root, proc[i]);
+
+        if ((stat(fpath, &info) < 0)
+            || ((info.st_uid != uid) && (uid > 0))
+            || (access(fpath, R_OK) < 0))
+        {
+            free(fpath);
+            free(proc[i]);
+            continue;
+        }
+
+        if (((fd=open(fpath, O_RDONLY)) < 0)
+            || ((nbytes=read(fd, buffer, sizeof(buffer))) <= 0))
+        {
+            if (fd >= 0) {
+                close(fd);
+            }
+
+            free(fpath);
+            free(proc[i]);
+            continue;
+        }
+
+        end = buffer + nbytes;
+        for (ptr=buffer; ptr < end; ) {
+            if (strstr(ptr, program)) {
+                pid = strtol(proc[i], 0, 10);
+                break;
+            }
+
+            while (*ptr++) {}
+        }
+
+        close(fd);
+        free(fpath);
+        free(proc[i]);
+    }
+
+    free(proc);
+
+    return pid;
+}
+
+/* ************************************************************************** */
+/* Old elm_sys_get_proc(), which grows the array by one for each process */
+char ** elm_bench_old_get_proc(const char *root)
+{
+    DIR           *dhandle = opendir(root);
+    struct dirent *entry;
+    char          *endptr;
+    char         **procs   = NULL;
+    size_t         index   = 1;
+
+    if (!dhandle) {
+        return NULL;
+    }
+
+    while ((entry=readdir(dhandle)))
+    {
+        if (entry->d_type != DT_DIR) {
+            continue;
+        }
+
+        if (!strtol(entry->d_name, &endptr, 10) || (*endptr != '\0')) {
+            continue;
+        }
+
+        if (!procs && !(procs=calloc(1, sizeof *procs))) {
+            break;
+        }
+
+        if (!(procs[index-1]=strdup(entry->d_name))) {
+            break;
+        }
+
+        if (!(procs=realloc(procs, (index+1) * sizeof *procs))) {
+            break;
+        }
+
+        procs[index++] = NULL;
+    }
+
+    closedir(dhandle);
+
+    return procs;
+}
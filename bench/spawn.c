@@ -0,0 +1,209 @@
+/* *****************************************************************************
+ * 
+ * Name:    spawn.c
+ * Author:  Gabriel Gonzalez
+ * Email:   gabeg@bu.edu
+ * License: The MIT License (MIT)
+ * 
+ * Description: Benchmark starting a program from a large greeter.
+ *              
+ * Notes: Usage: elmbench-spawn [runs]
+ * 
+ *        The cost of fork() grows with the memory of the parent, so the
+ *        launches are timed with the resident memory of the benchmark grown to
+ *        each of a few sizes. The memory is written to, so that all of it is
+ *        mapped, the way the heap of a running GTK greeter is.
+ * 
+ *        elm_spawn() is compared to what it replaced, a fork() whose child
+ *        resets its signal mask and runs exec. The old launcher is kept here,
+ *        with the mask that elm_spawn() uses. elm_spawn() takes the
+ *        posix_spawn() path for a program that keeps the identity of the
+ *        greeter, and the vfork() path when a directory is given, so both are
+ *        timed through it.
+ * 
+ *        Each launch of /bin/true is timed until it has exited, so what the
+ *        parent pays to copy and tear down its page tables is counted.
+ *        elm_spawn() logs every launch, and the old launcher logs one line as
+ *        well so that the writer costs the same for all three.
+ * 
+ * *****************************************************************************
+ */
+
+/* Includes */
+#include "elmbench.h"
+#include "elmdef.h"
+#include "elmio.h"
+#include "elmspawn.h"
+#include "elmsupervisor.h"
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+/* Defines */
+#define ELM_BENCH_SPAWN_COUNT   10
+#define ELM_BENCH_SPAWN_PROGRAM "/bin/true"
+
+/* Typedefs */
+typedef struct
+{
+    ElmSpawnAttr  attr;
+    pid_t       (*spawn)(const ElmSpawnAttr *attr);
+} ElmBenchSpawn;
+
+/* Private functions */
+static void   elm_bench_spawn_run(void *data);
+static pid_t  elm_bench_old_spawn(const ElmSpawnAttr *attr);
+static int    elm_bench_spawn_grow(size_t index);
+static long   elm_bench_spawn_get_rss(void);
+
+/* Private variables */
+static const size_t  Sizes[] = {16, 64, 256};
+static char         *Heap[sizeof(Sizes)/sizeof(*Sizes)];
+extern char        **environ;
+
+/* ************************************************************************** */
+/* Run the benchmark */
+int main(int argc, char **argv)
+{
+    char          *args[] = {ELM_BENCH_SPAWN_PROGRAM, NULL};
+    int            runs   = elm_bench_get_runs(argc, argv, 1);
+    ElmBenchSpawn  old    = {.spawn = elm_bench_old_spawn};
+    ElmBenchSpawn  posix  = {.spawn = elm_spawn};
+    ElmBenchSpawn  shared = {.spawn = elm_spawn};
+    char           name[64];
+    size_t         i;
+
+    elm_spawn_attr_init(&old.attr, args);
+    elm_spawn_attr_init(&posix.attr, args);
+    elm_spawn_attr_init(&shared.attr, args);
+
+    /* Any directory takes the vfork() path */
+    shared.attr.cwd = "/";
+
+    /* The log is printed to stdout as well */
+    if (!freopen("/dev/null", "w", stdout)) {
+        return 1;
+    }
+
+    mkdir(ELM_LOG_DIR, 0755);
+
+    for (i=0; i < sizeof(Sizes)/sizeof(*Sizes); i++)
+    {
+        if (elm_bench_spawn_grow(i) < 0) {
+            fprintf(stderr, "spawn: unable to grow to %zu MB\n", Sizes[i]);
+            return 1;
+        }
+
+        fprintf(stderr, "spawn: %ld kB resident\n", elm_bench_spawn_get_rss());
+
+        snprintf(name, sizeof(name), "spawn: fork+exec, %zu MB", Sizes[i]);
+        elm_bench_run(name, elm_bench_spawn_run, &old, runs,
+                      ELM_BENCH_SPAWN_COUNT);
+
+        snprintf(name, sizeof(name), "spawn: posix_spawn, %zu MB", Sizes[i]);
+        elm_bench_run(name, elm_bench_spawn_run, &posix, runs,
+                      ELM_BENCH_SPAWN_COUNT);
+
+        snprintf(name, sizeof(name), "spawn: vfork, %zu MB", Sizes[i]);
+        elm_bench_run(name, elm_bench_spawn_run, &shared, runs,
+                      ELM_BENCH_SPAWN_COUNT);
+    }
+
+    return 0;
+}
+
+/* ************************************************************************** */
+/* Launch the program a few times, waiting for each one to exit */
+void elm_bench_spawn_run(void *data)
+{
+    ElmBenchSpawn *bench = data;
+    pid_t          pid;
+    int            i;
+
+    for (i=0; i < ELM_BENCH_SPAWN_COUNT; i++)
+    {
+        if ((pid=bench->spawn(&bench->attr)) < 0) {
+            exit(2);
+        }
+
+        waitpid(pid, NULL, 0);
+    }
+}
+
+/* ************************************************************************** */
+/* Old launcher, with the signal mask that elm_spawn() gives the child */
+pid_t elm_bench_old_spawn(const ElmSpawnAttr *attr)
+{
+    char *const *argv = attr->argv;
+    sigset_t     mask;
+    pid_t        pid;
+
+    elm_supervisor_get_signals(&mask);
+
+    switch ((pid=fork()))
+    {
+    case 0:
+        sigprocmask(SIG_SETMASK, &mask, NULL);
+        execve(argv[0], argv, environ);
+        _exit(127);
+    case -1:
+        elmprintf(LOGERRNO, "%s '%s'", "Error during fork to start", argv[0]);
+        return -1;
+    default:
+        break;
+    }
+
+    elmprintf(LOGINFO, "Running '%s' (pid=%d).", argv[0], pid);
+
+    return pid;
+}
+
+/* ************************************************************************** */
+/* Grow the heap, and write to it, until a total size in MB has been
+ * allocated. The memory is kept until the benchmark exits. */
+int elm_bench_spawn_grow(size_t index)
+{
+    static size_t total = 0;
+    size_t        size;
+
+    if (Sizes[index]*1024*1024 <= total) {
+        return 0;
+    }
+
+    size = Sizes[index]*1024*1024 - total;
+
+    if (!(Heap[index]=malloc(size))) {
+        return -1;
+    }
+
+    memset(Heap[index], 1, size);
+
+    total += size;
+
+    return 0;
+}
+
+/* ************************************************************************** */
+/* Return the resident memory of the benchmark, in kB */
+long elm_bench_spawn_get_rss(void)
+{
+    FILE *stream = fopen("/proc/self/statm", "r");
+    long  size   = 0;
+    long  rss    = 0;
+
+    if (!stream) {
+        return -1;
+    }
+
+    if (fscanf(stream, "%ld %ld", &size, &rss) != 2) {
+        rss = -1;
+    }
+
+    fclose(stream);
+
+    return (rss < 0) ? rss : rss * (sysconf(_SC_PAGESIZE) / 1024);
+}
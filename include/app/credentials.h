@@ -20,11 +20,13 @@
 #include "elmapp.h"
 #include "elmconf.h"
 #include "elmgtk.h"
+#include "elmpreload.h"
 #include "elmsession.h"
 
 /* Public functions */
 GtkWidget * new_username_widget(void);
 GtkWidget * new_password_widget(void);
 void        set_credential_info(GtkWidget *widget, gpointer data);
+void        reset_credential_widget(GtkWidget *widget);
 
 #endif /* ELM_CREDENTIALS_H */
@@ -23,5 +23,6 @@
 
 /* Public functions */
 GtkWidget * display_datetime(ElmCallback callback);
+void        reset_datetime(void);
 
 #endif /* ELM_DATETIME_H */
@@ -24,5 +24,6 @@
 
 /* Public functions */
 GtkWidget * display_login(ElmCallback callback);
+void        reset_login(void);
 
 #endif /* ELM_LOGIN_H */
@@ -28,5 +28,6 @@ GtkWidget * new_xsession_widget(void);
 GtkWidget * get_xsession_button_widget(void);
 GtkWidget * get_xsession_menu_widget(void);
 void        set_xsession_info(GtkWidget *widget, gpointer data);
+void        reset_xsession_widget(GtkWidget *widget);
 
 #endif /* ELM_XSESSION_H */
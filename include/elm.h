@@ -25,6 +25,7 @@
 #include "elmsession.h"
 #include "elminterface.h"
 #include "elmio.h"
+#include "elmtrace.h"
 #include "elmx.h"
 #include "elmsys.h"
 #include <cairo.h>
@@ -46,8 +46,33 @@ typedef struct ElmApp
 {
     GtkWidget *     (*display)(ElmCallback);
     enum ElmGravity   gravity;
-    unsigned int      x;
-    unsigned int      y;
+    int               x;
+    int               y;
+    void            (*reset)(void);
 } ElmApp;
 
+/* Version of the plugin descriptor, bumped whenever it or the functions that
+ * plugins call change incompatibly */
+#define ELM_APP_ABI_VERSION 1
+
+/* Plugin descriptor. A plugin exports one, named elm_app_plugin, with the
+ * ELM_APP_PLUGIN() macro. Where it goes on the screen is set in the config
+ * file. The prepare function is optional and runs on a worker thread, before
+ * display is called from the main loop. */
+typedef struct ElmAppPlugin
+{
+    unsigned int   abi;
+    const char    *name;
+    int          (*prepare)(void);
+    GtkWidget *  (*display)(ElmCallback);
+    void         (*reset)(void);
+} ElmAppPlugin;
+
+#define ELM_APP_PLUGIN_SYMBOL "elm_app_plugin"
+
+#define ELM_APP_PLUGIN(name, prepare, display, reset)              \
+    const ElmAppPlugin elm_app_plugin = {                          \
+        ELM_APP_ABI_VERSION, (name), (prepare), (display), (reset) \
+    }
+
 #endif /* ELM_APP_H */
@@ -0,0 +1,31 @@
+/* *****************************************************************************
+ * 
+ * Name:    elmbackground.h
+ * Author:  Gabriel Gonzalez
+ * Email:   gabeg@bu.edu
+ * License: The MIT License (MIT)
+ * 
+ * Description: Pre-scaled background image cache.
+ * 
+ * Notes: None.
+ * 
+ * *****************************************************************************
+ */
+
+/* Header guard */
+#ifndef ELM_BACKGROUND_H
+#define ELM_BACKGROUND_H
+
+/* Includes */
+#include <cairo.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+/* Public functions */
+cairo_surface_t * elm_background_load(const char *path, int width, int height);
+cairo_surface_t * elm_background_new(GdkPixbuf *pixbuf, const char *path,
+                                     int width, int height);
+int               elm_background_blur(cairo_surface_t *surface, int radius);
+int               elm_background_is_cached(const char *path, int width,
+                                           int height);
+
+#endif /* ELM_BACKGROUND_H */
@@ -0,0 +1,27 @@
+/* *****************************************************************************
+ * 
+ * Name:    elmblur.h
+ * Author:  Gabriel Gonzalez
+ * Email:   gabeg@bu.edu
+ * License: The MIT License (MIT)
+ * 
+ * Description: Blur raw ARGB32 pixels.
+ * 
+ * Notes: None.
+ * 
+ * *****************************************************************************
+ */
+
+/* Header guard */
+#ifndef ELM_BLUR_H
+#define ELM_BLUR_H
+
+/* Includes */
+#include <stdint.h>
+
+/* Public functions */
+int elm_blur(uint32_t *pixels, int width, int height, int stride, int radius);
+int elm_blur_scalar(uint32_t *pixels, int width, int height, int stride,
+                    int radius);
+
+#endif /* ELM_BLUR_H */
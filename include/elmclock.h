@@ -0,0 +1,31 @@
+/* *****************************************************************************
+ * 
+ * Name:    elmclock.h
+ * Author:  Gabriel Gonzalez
+ * Email:   gabeg@bu.edu
+ * License: The MIT License (MIT)
+ * 
+ * Description: Shared greeter clock.
+ * 
+ * Notes: None.
+ * 
+ * *****************************************************************************
+ */
+
+/* Header guard */
+#ifndef ELM_CLOCK_H
+#define ELM_CLOCK_H
+
+/* Called with the current time, formatted, whenever it reads differently */
+typedef void (*ElmClockCallback)(const char *text, void *data);
+
+/* Public functions */
+int  elm_clock_subscribe(const char *format, ElmClockCallback callback,
+                         void *data);
+int  elm_clock_unsubscribe(ElmClockCallback callback, void *data);
+int  elm_clock_set_format(ElmClockCallback callback, void *data,
+                          const char *format);
+void elm_clock_refresh(void);
+void elm_clock_pause(int flag);
+
+#endif /* ELM_CLOCK_H */
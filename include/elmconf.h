@@ -20,13 +20,34 @@
 #include <glib.h>
 #include <stdbool.h>
 
+/* Typedefs */
+typedef struct ElmConfSnapshot ElmConfSnapshot;
+
+typedef void (*ElmConfCallback)(const char *group, void *data);
+
+typedef struct
+{
+    unsigned int parses;
+    unsigned int lookups;
+    unsigned int misses;
+} ElmConfStats;
+
 /* Public functions */
-char *  elm_conf_read(const char *group, const char *key);
-char *  elm_conf_read_str(const char *group, const char *key);
-int     elm_conf_read_int(const char *group, const char *key);
-bool    elm_conf_read_bool(const char *group, const char *key);
-char ** elm_conf_get_groups(void);
-char ** elm_conf_get_keys(const char *group);
-int     elm_is_key_err(GError **err);
+const char * elm_conf_read(const char *group, const char *key);
+const char * elm_conf_read_str(const char *group, const char *key);
+int          elm_conf_read_int(const char *group, const char *key);
+bool         elm_conf_read_bool(const char *group, const char *key);
+char **      elm_conf_get_groups(void);
+char **      elm_conf_get_keys(const char *group);
+int          elm_conf_load(void);
+int          elm_conf_watch(void);
+int          elm_conf_reload(void);
+int          elm_conf_subscribe(const char *group, ElmConfCallback callback,
+                                void *data);
+int          elm_conf_unsubscribe(const char *group, ElmConfCallback callback,
+                                  void *data);
+void         elm_conf_get_stats(ElmConfStats *stats);
+void         elm_conf_log_stats(void);
+int          elm_is_key_err(GError **err);
 
 #endif /* ELM_CONF_H */
@@ -61,10 +61,15 @@
 #define ELM_CMD_XMODMAP  "/usr/bin/xmodmap"
 
 /* Paths */
-#define ELM_RUN_DIR "/var/run/" PROGRAM
-#define ELM_LOG_DIR "/var/log/" PROGRAM
-#define ELM_LOG     ELM_LOG_DIR "/elm.log"
-#define ELM_XLOG    ELM_LOG_DIR "/Xorg.log"
+#define ELM_RUN_DIR    "/var/run/" PROGRAM
+#ifndef ELM_LOG_DIR
+#define ELM_LOG_DIR    "/var/log/" PROGRAM
+#endif
+#define ELM_CACHE_DIR  "/var/cache/" PROGRAM
+#define ELM_LOG        ELM_LOG_DIR "/elm.log"
+#define ELM_XLOG       ELM_LOG_DIR "/Xorg.log"
+#define ELM_CSS_DIR    "/etc/X11/elm/share/css"
+#define ELM_PLUGIN_DIR "/usr/lib/" PROGRAM "/plugins"
 
 /* Sizes */
 
@@ -76,4 +81,12 @@
 #define ELM_MAX_LINE_SIZE 256
 #define ELM_MAX_MSG_SIZE  256
 
+#define ELM_MAX_LOG_LINE_SIZE  1024
+#define ELM_MAX_LOG_BUF_SIZE   8192
+#define ELM_LOG_RING_SIZE      256
+
+#define ELM_MAX_DENTS_SIZE   8192
+#define ELM_MAX_PREFS_SIZE   (1024*1024)
+#define ELM_MAX_DESKTOP_SIZE 8192
+
 #endif /* ELM_DEF_H */
@@ -24,24 +24,26 @@
 
 /* Public functions */
 int         elm_gtk_add_widget(GtkWidget **container, GtkWidget *widget);
-int         elm_gtk_add_css_from_conf(GtkWidget **widget, char *selector,
-                                      char *group, char *key);
-int         elm_gtk_add_css_from_file(GtkWidget **widget, const char *selector,
-                                      const char *file);
+int         elm_gtk_add_class(GtkWidget **widget, const char *name);
+int         elm_gtk_load_theme(void);
 int         elm_gtk_default_widget(GtkWidget **window, GtkWidget **widget);
 int         elm_gtk_focus(GtkWidget **widget);
 int         elm_gtk_set_window_position(GtkWidget **window, unsigned int x,
                                         unsigned int y);
 int         elm_gtk_set_window_size(GtkWidget **window, int width, int height);
 int         elm_gtk_set_window_transparent(GtkWidget **window);
+int         elm_gtk_set_window_background(GtkWidget **window,
+                                          cairo_surface_t *surface);
 int         elm_gtk_set_widget_size(GtkWidget **widget, int width, int height);
 int         elm_gtk_set_widget_size_from_conf(GtkWidget **widget,
                                               const char *group,
                                               const char *xkey,
                                               const char *ykey);
 char *      elm_gtk_get_css_decl(char *name, char *args);
-char *      elm_gtk_get_css_decl_bg(char *path);
+char *      elm_gtk_get_css_decl_bg(const char *path);
 char *      elm_gtk_get_css_rule(char *selector, char *declarations);
 GtkWidget * elm_gtk_get_window(GtkWidget **widget);
+cairo_surface_t * elm_gtk_get_backdrop(GtkWidget *widget, int radius);
+void        elm_gtk_clear_backdrops(GtkWidget *widget);
 
 #endif /* ELM_GTK_H */
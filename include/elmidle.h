@@ -0,0 +1,27 @@
+/* *****************************************************************************
+ * 
+ * Name:    elmidle.h
+ * Author:  Gabriel Gonzalez
+ * Email:   gabeg@bu.edu
+ * License: The MIT License (MIT)
+ * 
+ * Description: Put the greeter to sleep when nobody is using it.
+ * 
+ * Notes: None.
+ * 
+ * *****************************************************************************
+ */
+
+/* Header guard */
+#ifndef ELM_IDLE_H
+#define ELM_IDLE_H
+
+/* Called from the main loop when the greeter goes idle (1) or wakes up (0) */
+typedef void (*ElmIdleChanged)(int idle, void *data);
+
+/* Public functions */
+int  elm_idle_init(ElmIdleChanged callback, void *data);
+void elm_idle_set_enabled(int flag);
+int  elm_idle_is_idle(void);
+
+#endif /* ELM_IDLE_H */
@@ -19,6 +19,7 @@
 /* Inlcudes */
 #include <errno.h>
 #include <string.h>
+#include <sys/types.h>
 
 /* Typedefs */
 typedef enum
@@ -35,11 +36,70 @@ typedef enum
     LOGWARN  = (1 <<  8) * 1,
     LOGWARNO = (1 <<  8) * 2,
     LOGERR   = (1 << 10) * 1,
-    LOGERRNO = (1 << 10) * 2
+    LOGERRNO = (1 << 10) * 2,
+    DEBUG    = (1 << 12) * 1,
+    DEBUGNO  = (1 << 12) * 2,
+    LOGDEBUG = (1 << 14) * 1,
+    LOGDBGNO = (1 << 14) * 2
 } ElmPrint;
 
+typedef enum
+{
+    ELM_LEVEL_DEBUG = 0,
+    ELM_LEVEL_INFO  = 1,
+    ELM_LEVEL_WARN  = 2,
+    ELM_LEVEL_ERROR = 3
+} ElmLevel;
+
+typedef enum
+{
+    ELM_LOG_FILE    = (1 << 0),
+    ELM_LOG_JOURNAL = (1 << 1)
+} ElmLogBackend;
+
+/* Lowest level that is compiled in. Debug messages are left out of release
+ * builds. */
+#ifndef ELM_LOG_MIN_LEVEL
+    #ifdef NDEBUG
+        #define ELM_LOG_MIN_LEVEL ELM_LEVEL_INFO
+    #else
+        #define ELM_LOG_MIN_LEVEL ELM_LEVEL_DEBUG
+    #endif
+#endif
+
+/* Level of a print mode. Folds to a constant for a constant mode. */
+#define ELM_IO_LEVEL(mode)                                                   \
+    (((mode) & (DEBUG | DEBUGNO | LOGDEBUG | LOGDBGNO)) ? ELM_LEVEL_DEBUG  \
+     : ((mode) & (INFO | INFNO | LOGINFO | LOGINFNO))   ? ELM_LEVEL_INFO   \
+     : ((mode) & (WARN | WARNO | LOGWARN | LOGWARNO))   ? ELM_LEVEL_WARN   \
+     : ELM_LEVEL_ERROR)
+
+/* Print a message, if its level is enabled. The arguments are not evaluated
+ * when it is not. */
+#define elmprintf(mode, ...)                                  \
+    do {                                                      \
+        if ((ELM_IO_LEVEL(mode) >= ELM_LOG_MIN_LEVEL)         \
+            && elm_io_is_enabled(ELM_IO_LEVEL(mode)))         \
+        {                                                     \
+            elm_io_printf((mode), __FILE__, __LINE__, __func__, \
+                          __VA_ARGS__);                       \
+        }                                                     \
+    } while (0)
+
 /* Public functions  */
-void elmprintf(ElmPrint mode, const char *vafmt, ...);
-void elm_io_set_verbose(int flag);
+void         elm_io_printf(ElmPrint mode, const char *file, int line,
+                           const char *func, const char *vafmt, ...);
+int          elm_io_is_enabled(ElmLevel level);
+void         elm_io_set_verbose(int count);
+void         elm_io_set_level(ElmLevel level);
+ElmLevel     elm_io_level_from_string(const char *string);
+void         elm_io_set_backend(int backend);
+int          elm_io_get_backend(void);
+int          elm_io_backend_from_string(const char *string);
+void         elm_io_set_phase(const char *phase);
+void         elm_io_set_user(const char *user);
+void         elm_io_set_session_pid(pid_t pid);
+void         elm_io_reopen(void);
+unsigned int elm_io_get_dropped(void);
 
 #endif /* ELM_IO_H */
@@ -29,6 +29,7 @@ typedef struct
     int    (*setup_signal_catcher)(void);
     int    (*show_apps)(void);
     int    (*hide_apps)(void);
+    int    (*reset_apps)(void);
     void   (*set_preview_mode)(int flag);
 } ElmLoginManager;
 
@@ -0,0 +1,30 @@
+/* *****************************************************************************
+ * 
+ * Name:    elmplugin.h
+ * Author:  Gabriel Gonzalez
+ * Email:   gabeg@bu.edu
+ * License: The MIT License (MIT)
+ * 
+ * Description: Load apps from shared objects.
+ * 
+ * Notes: None.
+ * 
+ * *****************************************************************************
+ */
+
+/* Header guard */
+#ifndef ELM_PLUGIN_H
+#define ELM_PLUGIN_H
+
+/* Includes */
+#include "elmapp.h"
+
+/* Called from the main loop with each plugin app that is ready to display */
+typedef void (*ElmPluginReady)(const ElmApp *app, void *data);
+
+/* Public functions */
+int elm_plugin_load(void);
+int elm_plugin_add_apps(ElmPluginReady callback, void *data);
+int elm_plugin_load_lazy(ElmPluginReady callback, void *data);
+
+#endif /* ELM_PLUGIN_H */
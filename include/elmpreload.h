@@ -0,0 +1,27 @@
+/* *****************************************************************************
+ * 
+ * Name:    elmpreload.h
+ * Author:  Gabriel Gonzalez
+ * Email:   gabeg@bu.edu
+ * License: The MIT License (MIT)
+ * 
+ * Description: Preload display-independent resources while X starts.
+ * 
+ * Notes: None.
+ * 
+ * *****************************************************************************
+ */
+
+/* Header guard */
+#ifndef ELM_PRELOAD_H
+#define ELM_PRELOAD_H
+
+/* Includes */
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+/* Public functions */
+int         elm_preload_start(void);
+void        elm_preload_wait(void);
+GdkPixbuf * elm_preload_get_pixbuf(const char *path);
+
+#endif /* ELM_PRELOAD_H */
@@ -0,0 +1,45 @@
+/* *****************************************************************************
+ * 
+ * Name:    elmspawn.h
+ * Author:  Gabriel Gonzalez
+ * Email:   gabeg@bu.edu
+ * License: The MIT License (MIT)
+ * 
+ * Description: Launch helper programs without copying the greeter.
+ * 
+ * Notes: None.
+ * 
+ * *****************************************************************************
+ */
+
+/* Header guard */
+#ifndef ELM_SPAWN_H
+#define ELM_SPAWN_H
+
+/* Includes */
+#include <sys/types.h>
+
+/* Defines */
+#define ELM_SPAWN_SETPGID 0x1
+#define ELM_SPAWN_SETSID  0x2
+#define ELM_SPAWN_NO_ID   ((uid_t)-1)
+
+/* How to start a program. Zeroed fields are inherited from the greeter, except
+ * for uid and gid, which must be set to ELM_SPAWN_NO_ID to keep them. */
+typedef struct
+{
+    char *const  *argv;
+    char *const  *envp;
+    const char   *cwd;
+    uid_t         uid;
+    gid_t         gid;
+    const gid_t  *groups;
+    int           ngroups;
+    int           flags;
+} ElmSpawnAttr;
+
+/* Public functions */
+void  elm_spawn_attr_init(ElmSpawnAttr *attr, char *const argv[]);
+pid_t elm_spawn(const ElmSpawnAttr *attr);
+
+#endif /* ELM_SPAWN_H */
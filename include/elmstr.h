@@ -19,12 +19,24 @@
 /* Includes */
 #include <stdlib.h>
 
+/* The keys of a desktop entry that the greeter uses */
+typedef struct
+{
+    char *name;
+    char *exec;
+    char *tryexec;
+    int   hidden;
+} ElmStrDesktopEntry;
+
 /* Public functions  */
 char * elm_str_copy(char *string);
 char * elm_str_vcopy(size_t size, const char *format, ...);
 char * elm_str_path(const char *format, ...);
 char * elm_str_readline(char *file);
-char * elm_str_findline(char *file, char *substring);
 char * elm_str_strip(char *string);
+int    elm_str_read_desktop_entry(const char *file, const char *locale,
+                                  ElmStrDesktopEntry *entry);
+void   elm_str_free_desktop_entry(ElmStrDesktopEntry *entry);
+int    elm_str_is_executable(const char *file);
 
 #endif /* ELM_STR_H */
@@ -0,0 +1,40 @@
+/* *****************************************************************************
+ * 
+ * Name:    elmsupervisor.h
+ * Author:  Gabriel Gonzalez
+ * Email:   gabeg@bu.edu
+ * License: The MIT License (MIT)
+ * 
+ * Description: Watch child processes and signals from the main loop.
+ * 
+ * Notes: None.
+ * 
+ * *****************************************************************************
+ */
+
+/* Header guard */
+#ifndef ELM_SUPERVISOR_H
+#define ELM_SUPERVISOR_H
+
+/* Includes */
+#include <signal.h>
+#include <sys/resource.h>
+#include <sys/signalfd.h>
+#include <sys/types.h>
+
+/* Called from the main loop once a child exited and was reaped */
+typedef void (*ElmSupervisorExit)(pid_t pid, int status,
+                                  const struct rusage *usage, void *data);
+
+/* Called from the main loop when a caught signal arrives */
+typedef void (*ElmSupervisorSignal)(const struct signalfd_siginfo *info);
+
+/* Public functions */
+int  elm_supervisor_init(void);
+int  elm_supervisor_catch(int sig, ElmSupervisorSignal handler);
+int  elm_supervisor_watch(pid_t pid, const char *name,
+                          ElmSupervisorExit callback, void *data);
+int  elm_supervisor_wait(pid_t pid, int timeout);
+void elm_supervisor_get_signals(sigset_t *mask);
+
+#endif /* ELM_SUPERVISOR_H */
@@ -17,11 +17,35 @@
 #define ELM_SYS_H
 
 /* Includes */
+#include "elmdef.h"
 #include <unistd.h>
+#include <sys/types.h>
+
+/* Match processes of any user */
+#define ELM_SYS_ANY_UID ((uid_t)-1)
+
+/* Process iterator. Lives on the stack, nothing is allocated per process. */
+typedef struct
+{
+    int         dirfd;
+    int         offset;
+    int         length;
+    uid_t       uid;
+    const char *match;
+    pid_t       pid;
+    char        name[16];
+    char        cmdline[ELM_MAX_MSG_SIZE];
+    int         cmdlength;
+    char        dents[ELM_MAX_DENTS_SIZE];
+} ElmSysProc;
 
 /* Public functions  */
-pid_t   elm_sys_pgrep(const char *program);
-char *  elm_sys_basename(const char *string);
-char ** elm_sys_get_proc(void);
+pid_t  elm_sys_pgrep(const char *program);
+char * elm_sys_basename(const char *string);
+int    elm_sys_proc_open(ElmSysProc *proc, const char *root, uid_t uid,
+                         const char *match);
+pid_t  elm_sys_proc_next(ElmSysProc *proc);
+int    elm_sys_proc_openat(ElmSysProc *proc, const char *file, int flags);
+void   elm_sys_proc_close(ElmSysProc *proc);
 
 #endif /* ELM_SYS_H */
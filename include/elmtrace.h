@@ -0,0 +1,29 @@
+/* *****************************************************************************
+ * 
+ * Name:    elmtrace.h
+ * Author:  Gabriel Gonzalez
+ * Email:   gabeg@bu.edu
+ * License: The MIT License (MIT)
+ * 
+ * Description: Startup phase tracer.
+ * 
+ * Notes: None.
+ * 
+ * *****************************************************************************
+ */
+
+/* Header guard */
+#ifndef ELM_TRACE_H
+#define ELM_TRACE_H
+
+/* Includes */
+#include <stdint.h>
+
+/* Public functions */
+int     elm_trace_open(const char *path);
+int     elm_trace_is_enabled(void);
+int64_t elm_trace_begin(void);
+void    elm_trace_end(const char *name, int64_t start);
+void    elm_trace_instant(const char *name);
+
+#endif /* ELM_TRACE_H */
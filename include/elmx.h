@@ -16,11 +16,18 @@
 #ifndef ELM_X_H
 #define ELM_X_H
 
+/* Includes */
+#include "elmspawn.h"
+
+/* Called from the main loop when the screen dimensions change */
+typedef void (*ElmXScreenChanged)(int width, int height, void *data);
+
 /* Public functions */
-int elm_x_start(void);
-int elm_x_set_cursor(void);
-int elm_x_set_transparency(int flag);
-int elm_x_load_user_preferences(void);
-int elm_x_screen_dimensions(int *width, int *height);
+int           elm_x_start(void);
+int           elm_x_set_transparency(int flag);
+int           elm_x_load_user_preferences(const ElmSpawnAttr *user);
+int           elm_x_screen_dimensions(int *width, int *height);
+void          elm_x_set_screen_callback(ElmXScreenChanged callback, void *data);
+unsigned long elm_x_get_requests(void);
 
 #endif /* ELM_X_H */
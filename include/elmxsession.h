@@ -0,0 +1,42 @@
+/* *****************************************************************************
+ * 
+ * Name:    elmxsession.h
+ * Author:  Gabriel Gonzalez
+ * Email:   gabeg@bu.edu
+ * License: The MIT License (MIT)
+ * 
+ * Description: Catalogue of the xsessions installed on the system.
+ * 
+ * Notes: None.
+ * 
+ * *****************************************************************************
+ */
+
+/* Header guard */
+#ifndef ELM_XSESSION_CATALOGUE_H
+#define ELM_XSESSION_CATALOGUE_H
+
+/* Includes */
+#include <glib.h>
+
+/* An xsession, along with the file it came from, as kept in the cache */
+typedef struct
+{
+    char   *name;
+    char   *exec;
+    char   *tryexec;
+    char   *file;
+    gint64  mtime;
+    gint64  size;
+} ElmXSession;
+
+/* Called from the main loop once the xsessions were refreshed */
+typedef void (*ElmXSessionChanged)(void *data);
+
+/* Public functions */
+int                 elm_xsession_load(void);
+const ElmXSession * elm_xsession_get(size_t index);
+int                 elm_xsession_watch(ElmXSessionChanged callback,
+                                       void *data);
+
+#endif /* ELM_XSESSION_CATALOGUE_H */
@@ -16,12 +16,10 @@
 #include "app/credentials.h"
 
 /* Private functions */
-static int elm_app_set_entry_buffer(GtkWidget *widget, char *placeholder);
-static int elm_app_set_entry_icon(GtkWidget *widget, char *name);
-static int elm_app_set_default_user(GtkWidget *widget);
-
-/* Private variables */
-static const char *Style = "/etc/X11/elm/share/css/credentials.css";
+static int  elm_app_set_entry_buffer(GtkWidget *widget, char *placeholder);
+static int  elm_app_set_entry_icon(GtkWidget *widget, char *name);
+static int  elm_app_set_default_user(GtkWidget *widget);
+static void elm_app_credentials_conf_changed(const char *group, void *data);
 
 /* ************************************************************************** */
 /* Create username entry */
@@ -38,8 +36,9 @@ GtkWidget * new_username_widget(void)
     elm_app_set_entry_buffer(Username, "Username");
     elm_app_set_entry_icon(Username, "Username");
     elm_app_set_default_user(Username);
+    elm_conf_subscribe("Images", elm_app_credentials_conf_changed, &Username);
     elm_gtk_set_widget_size_from_conf(&Username, "Credentials", "Width", "Height");
-    elm_gtk_add_css_from_file(&Username, NULL, Style);
+    elm_gtk_add_class(&Username, "Credentials");
     gtk_entry_set_activates_default(GTK_ENTRY(Username), TRUE);
 
     gtk_widget_show(Username);
@@ -61,11 +60,12 @@ GtkWidget * new_password_widget(void)
     /* Setup widget */
     elm_app_set_entry_buffer(Password, "Password");
     elm_app_set_entry_icon(Password, "Password");
+    elm_conf_subscribe("Images", elm_app_credentials_conf_changed, &Password);
     gtk_entry_set_visibility(GTK_ENTRY(Password), FALSE);
     gtk_entry_set_invisible_char(GTK_ENTRY(Password), '*');
     gtk_entry_set_activates_default(GTK_ENTRY(Password), TRUE);
     elm_gtk_set_widget_size_from_conf(&Password, "Credentials", "Width", "Height");
-    elm_gtk_add_css_from_file(&Password, NULL, Style);
+    elm_gtk_add_class(&Password, "Credentials");
 
     gtk_widget_show(Password);
 
@@ -89,6 +89,19 @@ void set_credential_info(GtkWidget *widget, gpointer data)
     strncpy(helper->data, text, length);
 }
 
+/* ************************************************************************** */
+/* Clear an entry. The username entry goes back to the default user. */
+void reset_credential_widget(GtkWidget *widget)
+{
+    const char *name = gtk_entry_get_placeholder_text(GTK_ENTRY(widget));
+
+    gtk_entry_set_text(GTK_ENTRY(widget), "");
+
+    if (name && !strcmp(name, "Username")) {
+        elm_app_set_default_user(widget);
+    }
+}
+
 /* ************************************************************************** */
 /* Set entry box text buffer */
 int elm_app_set_entry_buffer(GtkWidget *widget, char *placeholder)
@@ -110,17 +123,22 @@ int elm_app_set_entry_buffer(GtkWidget *widget, char *placeholder)
 /* Set entry box icon, if specified in config file */
 int elm_app_set_entry_icon(GtkWidget *widget, char *name)
 {
-    char      *icon;
-    GdkPixbuf *pixbuf;
+    const char *icon;
+    GdkPixbuf  *pixbuf;
 
     if (!(icon=elm_conf_read("Images", name))) {
         return -1;
     }
 
-    pixbuf = gdk_pixbuf_new_from_file(icon, NULL);
+    if (!(pixbuf=elm_preload_get_pixbuf(icon))
+        && !(pixbuf=gdk_pixbuf_new_from_file(icon, NULL)))
+    {
+        return -2;
+    }
 
     gtk_entry_set_icon_from_pixbuf(GTK_ENTRY(widget), GTK_ENTRY_ICON_PRIMARY,
                                    pixbuf);
+    g_object_unref(pixbuf);
 
     return 0;
 }
@@ -129,7 +147,7 @@ int elm_app_set_entry_icon(GtkWidget *widget, char *name)
 /* Set default user, if specified in config file */
 int elm_app_set_default_user(GtkWidget *widget)
 {
-    char *user = NULL;
+    const char *user = NULL;
 
     if (!(user=elm_conf_read("Main", "DefaultUser")) || !user[0]) {
         return -1;
@@ -139,3 +157,16 @@ int elm_app_set_default_user(GtkWidget *widget)
 
     return 0;
 }
+
+/* ************************************************************************** */
+/* Apply new entry box icons. The placeholder text of an entry is also the
+ * name of its icon in the config file. */
+void elm_app_credentials_conf_changed(const char *group, void *data)
+{
+    GtkWidget **widget = data;
+    const char *name   = gtk_entry_get_placeholder_text(GTK_ENTRY(*widget));
+
+    if (name) {
+        elm_app_set_entry_icon(*widget, (char*)name);
+    }
+}
@@ -7,21 +7,26 @@
  * 
  * Description: Display the date and time.
  *              
- * Notes: None.
+ * Notes: The labels are updated by the greeter clock, which only wakes up when
+ *        the text of one of them changes.
  * 
  * *****************************************************************************
  */
 
 /* Includes */
 #include "app/datetime.h"
-#include <time.h>
+#include "elmclock.h"
 
 /* Private functions */
-static gboolean elm_app_set_label_date(gpointer data);
-static gboolean elm_app_set_label_time(gpointer data);
+static void         elm_app_set_label(const char *text, void *data);
+static const char * elm_app_get_date_format(void);
+static const char * elm_app_get_time_format(void);
+static void         elm_app_datetime_conf_changed(const char *group,
+                                                  void *data);
 
 /* Private variables */
-static const char *Style = "/etc/X11/elm/share/css/datetime.css";
+static GtkWidget *Date = NULL;
+static GtkWidget *Time = NULL;
 
 /* ************************************************************************** */
 /* Create date and time application */
@@ -31,76 +36,68 @@ GtkWidget * display_datetime(ElmCallback callback)
 
     /* Create widgets */
     static GtkWidget *box  = NULL;
-    static GtkWidget *date = NULL;
-    static GtkWidget *time = NULL;
 
     box  = gtk_box_new(GTK_ORIENTATION_VERTICAL, 10);
-    date = gtk_label_new("");
-    time = gtk_label_new("");
-
-    /* Set refresh rate of time */
-    int sec = elm_conf_read_int("Datetime", "RefreshTime");
-
-    if (sec < 0) {
-        sec = 5;
-    }
+    Date = gtk_label_new("");
+    Time = gtk_label_new("");
 
     /* Finish setting up widgets */
-    gtk_box_pack_start(GTK_BOX(box), time, TRUE, TRUE, 0);
-    gtk_box_pack_start(GTK_BOX(box), date, TRUE, TRUE, 0);
-
-    gtk_widget_set_halign(date, GTK_ALIGN_CENTER);
-    gtk_widget_set_halign(time, GTK_ALIGN_CENTER);
-    elm_gtk_add_css_from_file(&date, "Date", Style);
-    elm_gtk_add_css_from_file(&time, "Time", Style);
-    elm_app_set_label_date(&date);
-    elm_app_set_label_time(&time);
-
-    g_timeout_add_seconds(sec, elm_app_set_label_date, &date);
-    g_timeout_add_seconds(sec, elm_app_set_label_time, &time);
-    gtk_widget_show(date);
-    gtk_widget_show(time);
+    gtk_box_pack_start(GTK_BOX(box), Time, TRUE, TRUE, 0);
+    gtk_box_pack_start(GTK_BOX(box), Date, TRUE, TRUE, 0);
+
+    gtk_widget_set_halign(Date, GTK_ALIGN_CENTER);
+    gtk_widget_set_halign(Time, GTK_ALIGN_CENTER);
+    elm_gtk_add_class(&Date, "Date");
+    elm_gtk_add_class(&Time, "Time");
+    elm_clock_subscribe(elm_app_get_date_format(), elm_app_set_label, &Date);
+    elm_clock_subscribe(elm_app_get_time_format(), elm_app_set_label, &Time);
+    elm_conf_subscribe("Datetime", elm_app_datetime_conf_changed, NULL);
+
+    gtk_widget_show(Date);
+    gtk_widget_show(Time);
     gtk_widget_show(box);
 
     return box;
 }
 
 /* ************************************************************************** */
-/* Set date */
-gboolean elm_app_set_label_date(gpointer data)
+/* Refresh the date and time, before the greeter is shown again */
+void reset_datetime(void)
 {
-    GtkWidget **label  = (GtkWidget**) data;
-    time_t      now    = time(NULL);
-    struct tm  *tm     = localtime(&now);
-    char       *format = elm_conf_read("Datetime", "DateFormat");
-    char        string[64];
-
-    if (!format) {
-        format = "%A, %B %-d";
-    }
+    elm_clock_refresh();
+}
 
-    strftime(string, sizeof(string), format, tm);
-    gtk_label_set_text(GTK_LABEL(*label), string);
+/* ************************************************************************** */
+/* Set the text of the date or time label */
+void elm_app_set_label(const char *text, void *data)
+{
+    GtkWidget **label = (GtkWidget**) data;
 
-    return TRUE;
+    gtk_label_set_text(GTK_LABEL(*label), text);
 }
 
 /* ************************************************************************** */
-/* Set time */
-gboolean elm_app_set_label_time(gpointer data)
+/* Return the date format */
+const char * elm_app_get_date_format(void)
 {
-    GtkWidget **label  = (GtkWidget**) data;
-    time_t      now    = time(NULL);
-    struct tm  *tm     = localtime(&now);
-    char       *format = elm_conf_read("Datetime", "TimeFormat");
-    char        string[64];
+    const char *format = elm_conf_read("Datetime", "DateFormat");
 
-    if (!format) {
-        format = "%-I:%M %p";
-    }
+    return (format) ? format : "%A, %B %-d";
+}
 
-    strftime(string, sizeof(string), format, tm);
-    gtk_label_set_text(GTK_LABEL(*label), string);
+/* ************************************************************************** */
+/* Return the time format */
+const char * elm_app_get_time_format(void)
+{
+    const char *format = elm_conf_read("Datetime", "TimeFormat");
+
+    return (format) ? format : "%-I:%M %p";
+}
 
-    return TRUE;
+/* ************************************************************************** */
+/* Apply new date and time formats */
+void elm_app_datetime_conf_changed(const char *group, void *data)
+{
+    elm_clock_set_format(elm_app_set_label, &Date, elm_app_get_date_format());
+    elm_clock_set_format(elm_app_set_label, &Time, elm_app_get_time_format());
 }
@@ -18,9 +18,7 @@
 
 /* Private functions */
 static gboolean elm_app_draw_frame(GtkWidget *drawing, cairo_t *cr, gpointer data);
-
-/* Private variables */
-static const char *Style = "/etc/X11/elm/share/css/frame.css";
+static void     elm_app_frame_conf_changed(const char *group, void *data);
 
 /* ************************************************************************** */
 /* Create login frame application */
@@ -38,8 +36,10 @@ GtkWidget * new_frame_widget(void)
     /* Setup widgets */
     gtk_fixed_put(GTK_FIXED(container), drawing, 0, 0);
     elm_gtk_set_widget_size_from_conf(&drawing, "Frame", "Width", "Height");
+    elm_gtk_add_class(&drawing, "Frame");
 
     g_signal_connect(drawing, "draw", G_CALLBACK(elm_app_draw_frame), NULL);
+    elm_conf_subscribe("Frame", elm_app_frame_conf_changed, drawing);
     gtk_widget_show(drawing);
     gtk_widget_show(container);
 
@@ -58,7 +58,6 @@ gboolean elm_app_draw_frame(GtkWidget *drawing, cairo_t *cr, gpointer data)
     /* Render background */
     GtkStyleContext *context = gtk_widget_get_style_context(drawing);
 
-    elm_gtk_add_css_from_file(&drawing, "Frame", Style);
     gtk_render_background(context, cr, 0, 0, width, height);
 
     /* Curved edges */
@@ -67,6 +66,15 @@ gboolean elm_app_draw_frame(GtkWidget *drawing, cairo_t *cr, gpointer data)
     cairo_arc(cr, curve,           1.0*height-curve, curve,  90*deg, 180*deg);
     cairo_arc(cr, curve,           curve,            curve, 180*deg, 270*deg);
 
+    /* Frosted glass, from the background that is under the frame */
+    int              radius   = elm_conf_read_int("Frame", "Blur");
+    cairo_surface_t *backdrop = NULL;
+
+    if ((radius > 0) && (backdrop=elm_gtk_get_backdrop(drawing, radius))) {
+        cairo_set_source_surface(cr, backdrop, 0, 0);
+        cairo_fill_preserve(cr);
+    }
+
     /* Set frame color */
     GtkStateFlags flags = gtk_style_context_get_state(context);
     GdkRGBA       color;
@@ -79,3 +87,10 @@ gboolean elm_app_draw_frame(GtkWidget *drawing, cairo_t *cr, gpointer data)
 
     return FALSE;
 }
+
+/* ************************************************************************** */
+/* Redraw the frame with a new blur radius */
+void elm_app_frame_conf_changed(const char *group, void *data)
+{
+    gtk_widget_queue_draw(GTK_WIDGET(data));
+}
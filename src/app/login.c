@@ -27,7 +27,9 @@ static void        elm_app_set_default_widget(GtkWidget *widget, gpointer data);
 static void        elm_app_set_focus_on_widget(GtkWidget *widget, gpointer data);
 
 /* Private variables */
-static const char *Style = "/etc/X11/elm/share/css/login.css";
+static GtkWidget *Username = NULL;
+static GtkWidget *Password = NULL;
+static GtkWidget *Xsession = NULL;
 
 /* ************************************************************************** */
 /* Create login fields application */
@@ -40,34 +42,31 @@ GtkWidget * display_login(ElmCallback callback)
     static GtkWidget *container = NULL;
     static GtkWidget *entrybox  = NULL;
     static GtkWidget *buttonbox = NULL;
-    static GtkWidget *username  = NULL;
-    static GtkWidget *password  = NULL;
-    static GtkWidget *xsession  = NULL;
     static GtkWidget *button    = NULL;
 
     frame     = new_frame_widget();
     container = gtk_box_new(GTK_ORIENTATION_VERTICAL,   15);
     entrybox  = gtk_box_new(GTK_ORIENTATION_VERTICAL,    5);
     buttonbox = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 10);
-    username  = new_username_widget();
-    password  = new_password_widget();
-    xsession  = new_xsession_widget();
+    Username  = new_username_widget();
+    Password  = new_password_widget();
+    Xsession  = new_xsession_widget();
     button    = new_login_button("Login");
 
     /* Setup session information struct and its helpers */
     ElmSessionInfo       *info    = elm_session_info_new();
-    ElmSessionInfoHelper *uhelper = elm_session_info_helper_new(username, info->username);
-    ElmSessionInfoHelper *phelper = elm_session_info_helper_new(password, info->password);
-    ElmSessionInfoHelper *xhelper = elm_session_info_helper_new(xsession, info->xsession);
+    ElmSessionInfoHelper *uhelper = elm_session_info_helper_new(Username, info->username);
+    ElmSessionInfoHelper *phelper = elm_session_info_helper_new(Password, info->password);
+    ElmSessionInfoHelper *xhelper = elm_session_info_helper_new(Xsession, info->xsession);
 
     /* Finish setting up widgets */
     gtk_fixed_put(GTK_FIXED(frame), container, 0, 0);
     gtk_box_pack_start(GTK_BOX(container), entrybox,  TRUE,  TRUE,  0);
     gtk_box_pack_start(GTK_BOX(container), buttonbox, TRUE,  TRUE,  0);
-    gtk_box_pack_start(GTK_BOX(entrybox),  username,  FALSE, FALSE, 0);
-    gtk_box_pack_start(GTK_BOX(entrybox),  password,  FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(entrybox),  Username,  FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(entrybox),  Password,  FALSE, FALSE, 0);
     gtk_box_pack_start(GTK_BOX(buttonbox), button,    FALSE, FALSE, 0);
-    gtk_box_pack_start(GTK_BOX(buttonbox), xsession,  FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(buttonbox), Xsession,  FALSE, FALSE, 0);
     gtk_widget_set_margin_top(container,   20);
     gtk_widget_set_margin_start(container, 20);
 
@@ -76,13 +75,13 @@ GtkWidget * display_login(ElmCallback callback)
     g_signal_connect(button, "clicked", G_CALLBACK(set_xsession_info),    xhelper);
     g_signal_connect(button, "clicked", G_CALLBACK(callback),             info);
     g_signal_connect(frame,  "show",    G_CALLBACK(elm_app_set_default_widget),  &button);
-    g_signal_connect(frame,  "show",    G_CALLBACK(elm_app_set_focus_on_widget), &username);
+    g_signal_connect(frame,  "show",    G_CALLBACK(elm_app_set_focus_on_widget), &Username);
     g_signal_connect(frame,  "map",     G_CALLBACK(elm_app_set_default_widget),  &button);
-    g_signal_connect(frame,  "map",     G_CALLBACK(elm_app_set_focus_on_widget), &username);
+    g_signal_connect(frame,  "map",     G_CALLBACK(elm_app_set_focus_on_widget), &Username);
 
-    gtk_widget_show(username);
-    gtk_widget_show(password);
-    gtk_widget_show(xsession);
+    gtk_widget_show(Username);
+    gtk_widget_show(Password);
+    gtk_widget_show(Xsession);
     gtk_widget_show(button);
     gtk_widget_show(entrybox);
     gtk_widget_show(buttonbox);
@@ -92,6 +91,17 @@ GtkWidget * display_login(ElmCallback callback)
     return frame;
 }
 
+/* ************************************************************************** */
+/* Clear the entries and reselect the default xsession, before the greeter is
+ * shown again. Focus returns to the username entry. */
+void reset_login(void)
+{
+    reset_credential_widget(Username);
+    reset_credential_widget(Password);
+    reset_xsession_widget(Xsession);
+    elm_gtk_focus(&Username);
+}
+
 /* ************************************************************************** */
 /* Create login button */
 GtkWidget * new_login_button(const char *text)
@@ -101,7 +111,7 @@ GtkWidget * new_login_button(const char *text)
     button = gtk_button_new_with_label(text);
 
     elm_gtk_set_widget_size_from_conf(&button, "Login", "Width", "Height");
-    elm_gtk_add_css_from_file(&button, "LoginButton", Style);
+    elm_gtk_add_class(&button, "LoginButton");
 
     return button;
 }
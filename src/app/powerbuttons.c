@@ -22,9 +22,6 @@ static void elm_app_system_shutdown(GtkButton *button, gpointer data);
 static void elm_app_system_reboot(GtkButton   *button, gpointer data);
 static void elm_app_system_cancel(GtkButton   *button, gpointer data);
 
-/* Private variables */
-static const char *Style = "/etc/X11/elm/share/css/powerbuttons.css";
-
 /* ************************************************************************** */
 /* Display system action options */
 GtkWidget * display_power_buttons(ElmCallback callback)
@@ -38,8 +35,7 @@ GtkWidget * display_power_buttons(ElmCallback callback)
 
     /* Setup widget */
     gtk_button_set_relief(GTK_BUTTON(button), GTK_RELIEF_NONE);
-    elm_gtk_add_css_from_conf(&button, "PowerButton", "Images", "Power");
-    elm_gtk_add_css_from_file(&button, "PowerButton", Style);
+    elm_gtk_add_class(&button, "PowerButton");
     elm_gtk_set_widget_size_from_conf(&button, "Powerbuttons", "Width", "Height");
 
     g_signal_connect(button, "clicked", G_CALLBACK(elm_app_system_prompt), NULL);
@@ -79,7 +75,7 @@ void elm_app_system_prompt(GtkButton *button, gpointer data)
     gtk_widget_set_margin_end(container,    margin/2);
     gtk_widget_set_margin_bottom(label,     margin);
 
-    elm_gtk_add_css_from_file(&shutdown, "ShutdownButton", Style);
+    elm_gtk_add_class(&shutdown, "ShutdownButton");
     gtk_dialog_set_default_response(GTK_DIALOG(dialog), 0);
     gtk_window_set_transient_for(GTK_WINDOW(dialog), window);
     gtk_window_set_modal(GTK_WINDOW(dialog), TRUE);
@@ -15,13 +15,11 @@
 
 /* Includes */
 #include "app/xsession.h"
+#include "elmxsession.h"
 
 /* Private functions */
-static int      elm_app_set_xsession_menu(GtkWidget **menu);
-static char *** elm_app_get_available_xsessions(void);
-
-/* Private variables */
-static const char *Style = "/etc/X11/elm/share/css/xsession.css";
+static int  elm_app_set_xsession_menu(GtkWidget **menu);
+static void elm_app_xsession_changed(void *data);
 
 /* ************************************************************************** */
 /* Create xsession menu button */
@@ -38,8 +36,9 @@ GtkWidget * new_xsession_widget(void)
 
     /* Setup widgets */
     elm_app_set_xsession_menu(&Xmenu);
+    elm_xsession_watch(elm_app_xsession_changed, Xmenu);
     elm_gtk_set_widget_size_from_conf(&Xbutton, "XSession", "Width", "Height");
-    elm_gtk_add_css_from_file(&Xbutton, "XSession", Style);
+    elm_gtk_add_class(&Xbutton, "XSession");
     gtk_menu_button_set_popup(GTK_MENU_BUTTON(Xbutton), Xmenu);
 
     gtk_widget_show_all(Xmenu);
@@ -66,171 +65,81 @@ void set_xsession_info(GtkWidget *widget, gpointer data)
 }
 
 /* ************************************************************************** */
-/* Populate menu with xsession(s) on system */
-int elm_app_set_xsession_menu(GtkWidget **menu)
+/* Select the first xsession in the menu again */
+void reset_xsession_widget(GtkWidget *widget)
 {
-    char      ***xsessions = elm_app_get_available_xsessions();
-    GSList      *group     = NULL;
-    GtkWidget   *menuitem  = NULL;
-    size_t       index;
+    GtkMenu *menu  = gtk_menu_button_get_popup(GTK_MENU_BUTTON(widget));
+    GList   *items = gtk_container_get_children(GTK_CONTAINER(menu));
 
-    if (!xsessions) {
-        return -1;
+    if (!items) {
+        return;
     }
 
+    gtk_check_menu_item_set_active(GTK_CHECK_MENU_ITEM(items->data), TRUE);
+    gtk_menu_set_active(menu, 0);
+    g_list_free(items);
+}
+
+/* ************************************************************************** */
+/* Populate menu with xsession(s) on system */
+int elm_app_set_xsession_menu(GtkWidget **menu)
+{
+    const ElmXSession *xsession;
+    GSList            *group    = NULL;
+    GtkWidget         *menuitem = NULL;
+    size_t             index;
+
     /* Create the radio buttons for the window managers */
-    for (index=0; xsessions[0][index] && xsessions[1][index]; index++)
+    for (index=0; (xsession=elm_xsession_get(index)); index++)
     {
-        menuitem = gtk_radio_menu_item_new_with_label(group, xsessions[0][index]);
+        menuitem = gtk_radio_menu_item_new_with_label(group, xsession->name);
         group    = gtk_radio_menu_item_get_group(GTK_RADIO_MENU_ITEM(menuitem));
 
-        gtk_widget_set_tooltip_text(menuitem, xsessions[1][index]);
+        gtk_widget_set_tooltip_text(menuitem, xsession->exec);
         gtk_menu_attach(GTK_MENU(*menu), menuitem, 0, 1, index, index+1);
         gtk_widget_show(menuitem);
-
-        elm_std_free(&xsessions[0][index]);
-        elm_std_free(&xsessions[1][index]);
     }
 
-    /* Clear memory */
-    elm_std_free(&xsessions[0]);
-    elm_std_free(&xsessions[1]);
-    elm_std_free(&xsessions);
-
-    return 0;
+    return (index) ? 0 : -1;
 }
 
 /* ************************************************************************** */
-/* Return all avaiable xsessions on the system */
-char *** elm_app_get_available_xsessions(void)
+/* Rebuild the menu after the xsessions on the system changed. The selected
+ * xsession stays selected, if it is still there. */
+void elm_app_xsession_changed(void *data)
 {
-    /* Open directory for reading */
-    const char    *dir     = "/usr/share/xsessions";
-    DIR           *dhandle = opendir(dir);
-    struct dirent *entry;
-
-    if (!dhandle) {
-        return NULL;
+    GtkWidget *menu     = data;
+    GtkWidget *active   = gtk_menu_get_active(GTK_MENU(menu));
+    gchar     *selected = (active) ? gtk_widget_get_tooltip_text(active) : NULL;
+    GList     *items    = gtk_container_get_children(GTK_CONTAINER(menu));
+    GList     *item;
+    gchar     *text;
+    guint      index;
+
+    for (item=items; item; item=item->next) {
+        gtk_widget_destroy(item->data);
     }
 
-    /* Allocate initial memory spaces for main pointer and its two columns */
-    char   ***xsessions = NULL;
-    char     *path      = NULL;
-    char     *nameline  = NULL;
-    char     *execline  = NULL;
-    size_t    index     = 1;
-    size_t    i;
-
-    if (!(xsessions=calloc(2, sizeof *xsessions))) {
-        elmprintf(LOGERRNO, "Unable to allocate xsessions array");
-        return NULL;
-    }
-    else {
-        xsessions[0] = NULL;
-        xsessions[1] = NULL;
-    }
-
-    if (!(xsessions[0]=calloc(1, sizeof *xsessions[0]))) {
-        elmprintf(LOGERRNO, "%s '%lu'",
-                  "Unable to allocate xsessions array", 0);
-        goto cleanup;
-    }
+    g_list_free(items);
+    elm_app_set_xsession_menu(&menu);
 
-    if (!(xsessions[1]=calloc(1, sizeof *xsessions[0]))) {
-        elmprintf(LOGERRNO, "%s '%lu'",
-                  "Unable to allocate xsessions array", 1);
-        goto cleanup;
-    }
+    items = gtk_container_get_children(GTK_CONTAINER(menu));
 
-    /* Iterate over files in directory */
-    while ((entry=readdir(dhandle)))
+    for (item=items, index=0; selected && item; item=item->next, index++)
     {
-        /* Clear previously allocated memory */
-        if (path) {
-            elm_std_free(&path);
-        }
-
-        if (nameline) {
-            elm_std_free(&nameline);
-        }
-
-        if (execline) {
-            elm_std_free(&execline);
+        text = gtk_widget_get_tooltip_text(item->data);
+
+        if (g_strcmp0(text, selected) == 0) {
+            gtk_check_menu_item_set_active(GTK_CHECK_MENU_ITEM(item->data),
+                                           TRUE);
+            gtk_menu_set_active(GTK_MENU(menu), index);
+            g_free(text);
+            break;
         }
 
-        /* Check extension of file is correct */
-        if ((entry->d_type != DT_REG) || (!strstr(entry->d_name, ".desktop"))) {
-            continue;
-        }
-
-        /* Read file */
-        path     = elm_str_path("%s/%s", dir, entry->d_name);
-        nameline = elm_str_findline(path, "Name=");
-        execline = elm_str_findline(path, "Exec=");
-
-        if (!nameline || !execline) {
-            continue;
-        }
-
-        /* Copy string to array */
-        if (!(xsessions[0][index-1]=elm_str_copy(&nameline[5]))) {
-            goto cleanup;
-        }
-
-        if (!(xsessions[1][index-1]=elm_str_copy(&execline[5]))) {
-            goto cleanup;
-        }
-
-        /* Resize allocated memory for next xsession */
-        if (!(xsessions[0]=realloc(xsessions[0],
-                                   (index+1) * sizeof *xsessions[0])))
-        {
-            elmprintf(LOGERRNO, "Unable to reallocate xsessions array");
-            goto cleanup;
-        }
-
-        if (!(xsessions[1]=realloc(xsessions[1],
-                                   (index+1) * sizeof *xsessions[0])))
-        {
-            elmprintf(LOGERRNO, "Unable to reallocate xsessions array");
-            goto cleanup;
-        }
-
-        xsessions[0][index] = NULL;
-        xsessions[1][index] = NULL;
-        index++;
-    }
-
-    closedir(dhandle);
-
-    return xsessions;
-
-cleanup:
-    if (path) {
-        elm_std_free(&path);
-    }
-
-    if (nameline) {
-        elm_std_free(&nameline);
-    }
-
-    if (execline) {
-        elm_std_free(&execline);
+        g_free(text);
     }
 
-    for (i=0; i < (index-1); i++) {
-        elm_std_free(&xsessions[0][i]);
-        elm_std_free(&xsessions[1][i]);
-    }
-
-    if (xsessions[0]) {
-        elm_std_free(&xsessions[0]);
-    }
-    if (xsessions[1]) {
-        elm_std_free(&xsessions[1]);
-    }
-
-    elm_std_free(&xsessions);
-
-    return NULL;
+    g_list_free(items);
+    g_free(selected);
 }
@@ -46,6 +46,7 @@ int main(int argc, char **argv)
         { "preview", optional_argument, 0, 'p' },
         { "run",     optional_argument, 0, 'r' },
         { "logout",  optional_argument, 0,  0 },
+        { "trace",   required_argument, 0, 't' },
         { 0,         0,                 0,  0 }
     };
 
@@ -63,7 +64,7 @@ int main(int argc, char **argv)
             exit(ELM_EXIT_SUCCESS);
 
         case 'v':
-            options.verbose = 1;
+            options.verbose++;
             elm_io_set_verbose(options.verbose);
             break;
 
@@ -76,6 +77,10 @@ int main(int argc, char **argv)
             options.run = 1;
             break;
 
+        case 't':
+            elm_trace_open(optarg);
+            break;
+
         case 0:
             options.logout = 1;
             elmprintf(LOGWARN, "Logout needs to be implemented. Exiting.");
@@ -112,7 +117,7 @@ void usage(void)
     printf("        Print program usage.\n");
     printf("\n");
     printf("    -v, --verbose\n");
-    printf("        Verbose output.\n");
+    printf("        Verbose output. Repeat for more detail.\n");
     printf("\n");
     printf("    -p, --preview\n");
     printf("        Run login manager in Preview Mode (ignores X window setup).\n");
@@ -122,4 +127,8 @@ void usage(void)
     printf("\n");
     printf("    --logout\n");
     printf("        Logout of user session.\n");
+    printf("\n");
+    printf("    --trace=<file>\n");
+    printf("        Write a trace of startup and login phases to a file, in Chrome\n");
+    printf("        trace event format.\n");
 }
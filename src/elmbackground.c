@@ -0,0 +1,456 @@
+/* *****************************************************************************
+ * 
+ * Name:    elmbackground.c
+ * Author:  Gabriel Gonzalez
+ * Email:   gabeg@bu.edu
+ * License: The MIT License (MIT)
+ * 
+ * Description: Pre-scaled background image cache.
+ *              
+ * Notes: The background image is decoded and scaled to cover the screen once,
+ *        and the result is kept in the cache directory as a raw ARGB32 cairo
+ *        surface. Later starts map the file and paint from it directly, with
+ *        no decoding or scaling.
+ * 
+ *        A cache file is named after a hash of the image path, mtime, and
+ *        size, followed by the screen geometry. The same key is stored in the
+ *        file header and checked when the file is mapped. Editing or replacing
+ *        the image changes the key, so a stale entry is never used.
+ * 
+ *        On a miss, the surface is built from the decoded image right away and
+ *        written out by a detached thread, so the greeter does not wait on the
+ *        disk. The file is written under a temporary name and renamed into
+ *        place, and entries for older versions of the image are removed.
+ * 
+ *        Parts of the background can be blurred, for widgets that look like
+ *        frosted glass without a compositor.
+ * 
+ * *****************************************************************************
+ */
+
+/* Includes */
+#include "elmbackground.h"
+#include "elmblur.h"
+#include "elmdef.h"
+#include "elmio.h"
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <gdk/gdk.h>
+
+/* Typedefs */
+typedef struct
+{
+    char     magic[8];
+    uint32_t width;
+    uint32_t height;
+    uint32_t stride;
+    uint32_t reserved;
+    int64_t  mtime;
+    int64_t  mtimensec;
+    int64_t  size;
+    char     path[ELM_MAX_PATH_SIZE];
+} ElmBackgroundHeader;
+
+typedef struct
+{
+    void   *address;
+    size_t  length;
+} ElmBackgroundMap;
+
+typedef struct
+{
+    ElmBackgroundHeader  header;
+    cairo_surface_t     *surface;
+    uint64_t             key;
+} ElmBackgroundJob;
+
+/* Private functions */
+static int      elm_background_get_header(const char *path, int width,
+                                          int height,
+                                          ElmBackgroundHeader *header);
+static uint64_t elm_background_get_key(const ElmBackgroundHeader *header);
+static void     elm_background_get_file(uint64_t key, int width, int height,
+                                        char *buf, size_t size);
+static void *   elm_background_write(void *data);
+static void     elm_background_remove_stale(uint64_t key);
+static void     elm_background_unmap(void *data);
+
+/* Private variables */
+static const char                  Magic[8] = "ELMBG\0\0\1";
+static const cairo_user_data_key_t MapKey;
+
+/* ************************************************************************** */
+/* Return the cached background surface for an image and screen size, or NULL
+ * if there is no valid cache entry */
+cairo_surface_t * elm_background_load(const char *path, int width, int height)
+{
+    ElmBackgroundHeader  want;
+    ElmBackgroundHeader *have;
+    ElmBackgroundMap    *map;
+    cairo_surface_t     *surface;
+    struct stat          info;
+    char                 file[ELM_MAX_PATH_SIZE];
+    void                *address;
+    int                  fd;
+
+    if (elm_background_get_header(path, width, height, &want) < 0) {
+        return NULL;
+    }
+
+    elm_background_get_file(elm_background_get_key(&want), width, height,
+                            file, sizeof(file));
+
+    if ((fd=open(file, (O_RDONLY | O_CLOEXEC))) < 0) {
+        return NULL;
+    }
+
+    if ((fstat(fd, &info) < 0)
+        || ((size_t)info.st_size != (sizeof(want) + (size_t)want.stride*height)))
+    {
+        close(fd);
+        return NULL;
+    }
+
+    /* Private writable mapping, as cairo wants a non-const buffer. Pages are
+     * only copied if written to, which painting from the surface never does. */
+    address = mmap(NULL, info.st_size, (PROT_READ | PROT_WRITE), MAP_PRIVATE,
+                   fd, 0);
+
+    close(fd);
+
+    if (address == MAP_FAILED) {
+        elmprintf(LOGERRNO, "%s '%s'", "Unable to map background cache", file);
+        return NULL;
+    }
+
+    /* Check that the entry is for this image */
+    have = address;
+
+    if (memcmp(have, &want, sizeof(want)) != 0) {
+        elmprintf(LOGWARN, "Ignoring background cache '%s': Key mismatch.",
+                  file);
+        munmap(address, info.st_size);
+        return NULL;
+    }
+
+    surface = cairo_image_surface_create_for_data((unsigned char*)address
+                                                      + sizeof(want),
+                                                  CAIRO_FORMAT_ARGB32, width,
+                                                  height, want.stride);
+    map     = malloc(sizeof(*map));
+
+    if (!map || (cairo_surface_status(surface) != CAIRO_STATUS_SUCCESS)) {
+        cairo_surface_destroy(surface);
+        munmap(address, info.st_size);
+        free(map);
+        return NULL;
+    }
+
+    map->address = address;
+    map->length  = info.st_size;
+
+    cairo_surface_set_user_data(surface, &MapKey, map, elm_background_unmap);
+    elmprintf(LOGINFO, "Using background cache '%s'.", file);
+
+    return surface;
+}
+
+/* ************************************************************************** */
+/* Scale an image to cover the screen, centered, and return it as a surface.
+ * The surface is written to the cache in the background. */
+cairo_surface_t * elm_background_new(GdkPixbuf *pixbuf, const char *path,
+                                     int width, int height)
+{
+    ElmBackgroundJob *job;
+    cairo_surface_t  *surface;
+    cairo_t          *cr;
+    pthread_t         thread;
+    pthread_attr_t    attr;
+    double            xscale;
+    double            yscale;
+    double            scale;
+
+    if (!pixbuf || (width <= 0) || (height <= 0)) {
+        return NULL;
+    }
+
+    surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, width, height);
+
+    if (cairo_surface_status(surface) != CAIRO_STATUS_SUCCESS) {
+        cairo_surface_destroy(surface);
+        return NULL;
+    }
+
+    /* Scale to cover */
+    xscale = (double)width  / gdk_pixbuf_get_width(pixbuf);
+    yscale = (double)height / gdk_pixbuf_get_height(pixbuf);
+    scale  = (xscale > yscale) ? xscale : yscale;
+
+    cr = cairo_create(surface);
+
+    cairo_translate(cr,
+                    (width  - (gdk_pixbuf_get_width(pixbuf)  * scale)) / 2,
+                    (height - (gdk_pixbuf_get_height(pixbuf) * scale)) / 2);
+    cairo_scale(cr, scale, scale);
+    gdk_cairo_set_source_pixbuf(cr, pixbuf, 0, 0);
+    cairo_pattern_set_filter(cairo_get_source(cr), CAIRO_FILTER_GOOD);
+    cairo_paint(cr);
+    cairo_destroy(cr);
+    cairo_surface_flush(surface);
+
+    /* Write cache entry */
+    if (!(job=calloc(1, sizeof(*job)))) {
+        return surface;
+    }
+
+    if (elm_background_get_header(path, width, height, &job->header) < 0) {
+        free(job);
+        return surface;
+    }
+
+    job->header.stride = cairo_image_surface_get_stride(surface);
+    job->surface       = cairo_surface_reference(surface);
+    job->key           = elm_background_get_key(&job->header);
+
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+    if (pthread_create(&thread, &attr, elm_background_write, job) != 0) {
+        elmprintf(LOGWARN, "Unable to start background cache writer.");
+        cairo_surface_destroy(job->surface);
+        free(job);
+    }
+
+    pthread_attr_destroy(&attr);
+
+    return surface;
+}
+
+/* ************************************************************************** */
+/* Blur an ARGB32 surface in place */
+int elm_background_blur(cairo_surface_t *surface, int radius)
+{
+    int       width  = cairo_image_surface_get_width(surface);
+    int       height = cairo_image_surface_get_height(surface);
+    int       stride = cairo_image_surface_get_stride(surface) / 4;
+    uint32_t *pixels;
+
+    if (radius <= 0) {
+        return 0;
+    }
+
+    if (cairo_image_surface_get_format(surface) != CAIRO_FORMAT_ARGB32) {
+        return -1;
+    }
+
+    cairo_surface_flush(surface);
+
+    pixels = (uint32_t*) cairo_image_surface_get_data(surface);
+
+    if (elm_blur(pixels, width, height, stride, radius) < 0) {
+        return -2;
+    }
+
+    cairo_surface_mark_dirty(surface);
+
+    return 0;
+}
+
+/* ************************************************************************** */
+/* Check if the cache has an entry for the current version of an image at a
+ * screen size. This is the same file that elm_background_load() looks up. */
+int elm_background_is_cached(const char *path, int width, int height)
+{
+    ElmBackgroundHeader header;
+    char                file[ELM_MAX_PATH_SIZE];
+
+    if ((width <= 0) || (height <= 0)) {
+        return 0;
+    }
+
+    if (elm_background_get_header(path, width, height, &header) < 0) {
+        return 0;
+    }
+
+    elm_background_get_file(elm_background_get_key(&header), width, height,
+                            file, sizeof(file));
+
+    return (access(file, R_OK) == 0);
+}
+
+/* ************************************************************************** */
+/* Fill in the cache header for an image and screen size */
+int elm_background_get_header(const char *path, int width, int height,
+                              ElmBackgroundHeader *header)
+{
+    struct stat info;
+
+    if (!path || (strlen(path) >= sizeof(header->path))) {
+        return -1;
+    }
+
+    if (stat(path, &info) < 0) {
+        return -2;
+    }
+
+    memset(header, 0, sizeof(*header));
+    memcpy(header->magic, Magic, sizeof(header->magic));
+    strncpy(header->path, path, sizeof(header->path)-1);
+
+    header->width     = width;
+    header->height    = height;
+    header->stride    = cairo_format_stride_for_width(CAIRO_FORMAT_ARGB32,
+                                                      width);
+    header->mtime     = info.st_mtim.tv_sec;
+    header->mtimensec = info.st_mtim.tv_nsec;
+    header->size      = info.st_size;
+
+    return 0;
+}
+
+/* ************************************************************************** */
+/* Return the cache key of an image: a hash of its path, mtime, and size. The
+ * screen size is not part of the key. */
+uint64_t elm_background_get_key(const ElmBackgroundHeader *header)
+{
+    const unsigned char *fields[] = {(const unsigned char*)header->path,
+                                     (const unsigned char*)&header->mtime,
+                                     (const unsigned char*)&header->mtimensec,
+                                     (const unsigned char*)&header->size};
+    const size_t         sizes[]  = {strlen(header->path),
+                                     sizeof(header->mtime),
+                                     sizeof(header->mtimensec),
+                                     sizeof(header->size)};
+    uint64_t             hash     = 0xcbf29ce484222325ULL;
+    size_t               i;
+    size_t               j;
+
+    /* FNV-1a */
+    for (i=0; i < (sizeof(sizes)/sizeof(*sizes)); i++)
+    {
+        for (j=0; j < sizes[i]; j++)
+        {
+            hash ^= fields[i][j];
+            hash *= 0x100000001b3ULL;
+        }
+    }
+
+    return hash;
+}
+
+/* ************************************************************************** */
+/* Write the name of a cache file into a buffer */
+void elm_background_get_file(uint64_t key, int width, int height, char *buf,
+                             size_t size)
+{
+    snprintf(buf, size, "%s/background-%016" PRIx64 "-%dx%d.argb",
+             ELM_CACHE_DIR, key, width, height);
+}
+
+/* ************************************************************************** */
+/* Write a cache entry. Runs on its own thread. */
+void * elm_background_write(void *data)
+{
+    ElmBackgroundJob *job    = data;
+    unsigned char    *pixels = cairo_image_surface_get_data(job->surface);
+    size_t            length = (size_t)job->header.stride * job->header.height;
+    char              file[ELM_MAX_PATH_SIZE];
+    char              temp[ELM_MAX_PATH_SIZE];
+    int               fd;
+
+    elm_background_get_file(job->key, job->header.width, job->header.height,
+                            file, sizeof(file));
+    snprintf(temp, sizeof(temp), "%s/.background-XXXXXX", ELM_CACHE_DIR);
+
+    if ((mkdir(ELM_CACHE_DIR, 0755) < 0) && (errno != EEXIST)) {
+        elmprintf(LOGERRNO, "%s '%s'", "Unable to create directory",
+                  ELM_CACHE_DIR);
+        goto cleanup;
+    }
+
+    if ((fd=mkstemp(temp)) < 0) {
+        elmprintf(LOGERRNO, "%s '%s'", "Unable to create background cache",
+                  temp);
+        goto cleanup;
+    }
+
+    if ((write(fd, &job->header, sizeof(job->header))
+            != (ssize_t)sizeof(job->header))
+        || (write(fd, pixels, length) != (ssize_t)length)
+        || (fchmod(fd, 0644) < 0))
+    {
+        elmprintf(LOGERRNO, "%s '%s'", "Unable to write background cache",
+                  temp);
+        close(fd);
+        unlink(temp);
+        goto cleanup;
+    }
+
+    close(fd);
+
+    if (rename(temp, file) < 0) {
+        elmprintf(LOGERRNO, "%s '%s'", "Unable to rename background cache",
+                  temp);
+        unlink(temp);
+        goto cleanup;
+    }
+
+    elm_background_remove_stale(job->key);
+    elmprintf(LOGINFO, "Wrote background cache '%s'.", file);
+
+cleanup:
+    cairo_surface_destroy(job->surface);
+    free(job);
+
+    return NULL;
+}
+
+/* ************************************************************************** */
+/* Remove cache entries for other versions of the image */
+void elm_background_remove_stale(uint64_t key)
+{
+    struct dirent *entry;
+    DIR           *dir;
+    char           prefix[64];
+    char           file[ELM_MAX_PATH_SIZE];
+
+    if (!(dir=opendir(ELM_CACHE_DIR))) {
+        return;
+    }
+
+    snprintf(prefix, sizeof(prefix), "background-%016" PRIx64 "-", key);
+
+    while ((entry=readdir(dir)))
+    {
+        if ((strncmp(entry->d_name, "background-", 11) != 0)
+            || (strncmp(entry->d_name, prefix, strlen(prefix)) == 0))
+        {
+            continue;
+        }
+
+        snprintf(file, sizeof(file), "%s/%s", ELM_CACHE_DIR, entry->d_name);
+        unlink(file);
+    }
+
+    closedir(dir);
+}
+
+/* ************************************************************************** */
+/* Unmap a cache file once its surface is destroyed */
+void elm_background_unmap(void *data)
+{
+    ElmBackgroundMap *map = data;
+
+    munmap(map->address, map->length);
+    free(map);
+}
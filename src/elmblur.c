@@ -0,0 +1,177 @@
+/* *****************************************************************************
+ * 
+ * Name:    elmblur.c
+ * Author:  Gabriel Gonzalez
+ * Email:   gabeg@bu.edu
+ * License: The MIT License (MIT)
+ * 
+ * Description: Blur raw ARGB32 pixels.
+ *              
+ * Notes: Three box blurs in a row come close to a Gaussian blur, and each
+ *        costs the same for any radius, as it keeps a running sum. Each pass
+ *        blurs the rows and writes them out as columns, so the same code does
+ *        both directions.
+ * 
+ *        With SSE2, the four channels of a pixel are summed at once. The plain
+ *        C kernel is always built, for elm_blur_scalar(), and both must give
+ *        the same pixels. The blur benchmark checks that they do.
+ * 
+ * *****************************************************************************
+ */
+
+/* Includes */
+#include "elmblur.h"
+#include <stdlib.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/* Typedefs */
+typedef void (*ElmBlurLine)(const uint32_t *src, uint32_t *dst, int length,
+                            int step, int radius);
+
+/* Private functions */
+static int  elm_blur_run(ElmBlurLine line, uint32_t *pixels, int width,
+                         int height, int stride, int radius);
+static void elm_blur_line(const uint32_t *src, uint32_t *dst, int length,
+                          int step, int radius);
+
+#ifdef __SSE2__
+static void           elm_blur_line_sse2(const uint32_t *src, uint32_t *dst,
+                                         int length, int step, int radius);
+static inline __m128i elm_blur_unpack(uint32_t pixel);
+#endif
+
+/* ************************************************************************** */
+/* Blur pixels in place, with the fastest kernel. The stride is in pixels. */
+int elm_blur(uint32_t *pixels, int width, int height, int stride, int radius)
+{
+#ifdef __SSE2__
+    return elm_blur_run(elm_blur_line_sse2, pixels, width, height, stride,
+                        radius);
+#else
+    return elm_blur_run(elm_blur_line, pixels, width, height, stride, radius);
+#endif
+}
+
+/* ************************************************************************** */
+/* Blur pixels in place, with the plain C kernel */
+int elm_blur_scalar(uint32_t *pixels, int width, int height, int stride,
+                    int radius)
+{
+    return elm_blur_run(elm_blur_line, pixels, width, height, stride, radius);
+}
+
+/* ************************************************************************** */
+/* Blur pixels in place with a line kernel */
+int elm_blur_run(ElmBlurLine line, uint32_t *pixels, int width, int height,
+                 int stride, int radius)
+{
+    uint32_t *temp;
+    int       pass;
+    int       i;
+
+    if (radius <= 0) {
+        return 0;
+    }
+
+    if (!(temp=malloc(sizeof(*temp) * width * height))) {
+        return -1;
+    }
+
+    for (pass=0; pass < 3; pass++)
+    {
+        for (i=0; i < height; i++) {
+            line(&pixels[i*stride], &temp[i], width, height, radius);
+        }
+
+        for (i=0; i < width; i++) {
+            line(&temp[i*height], &pixels[i], height, stride, radius);
+        }
+    }
+
+    free(temp);
+
+    return 0;
+}
+
+/* ************************************************************************** */
+/* Box blur a line of pixels. The result is written every step pixels, and
+ * pixels past either end repeat the one at the edge. */
+void elm_blur_line(const uint32_t *src, uint32_t *dst, int length, int step,
+                   int radius)
+{
+    uint32_t sum[4] = {0, 0, 0, 0};
+    uint32_t add;
+    uint32_t sub;
+    uint32_t out;
+    uint32_t size   = 2*radius+1;
+    int      i;
+    int      c;
+
+    for (i=-radius-1; i < radius; i++) {
+        add = src[(i < 0) ? 0 : (i < length) ? i : length-1];
+
+        for (c=0; c < 4; c++) {
+            sum[c] += (add >> (8*c)) & 0xff;
+        }
+    }
+
+    for (i=0; i < length; i++) {
+        add = src[(i+radius < length) ? i+radius : length-1];
+        sub = src[(i-radius-1 > 0) ? i-radius-1 : 0];
+        out = 0;
+
+        for (c=0; c < 4; c++) {
+            sum[c] += ((add >> (8*c)) & 0xff) - ((sub >> (8*c)) & 0xff);
+            out    |= ((sum[c] + size/2) / size) << (8*c);
+        }
+
+        dst[i*step] = out;
+    }
+}
+
+#ifdef __SSE2__
+/* ************************************************************************** */
+/* Box blur a line of pixels, with the four channels in one vector. The mean
+ * is rounded to nearest in single precision. A mean over an odd number of
+ * pixels is never halfway between two values, so this rounds the same way as
+ * the plain C kernel. */
+void elm_blur_line_sse2(const uint32_t *src, uint32_t *dst, int length,
+                        int step, int radius)
+{
+    const __m128  scale = _mm_set1_ps(1.0f / (2*radius+1));
+    __m128i       sum   = _mm_setzero_si128();
+    __m128i       out;
+    int           i;
+    int           j;
+
+    for (i=-radius-1; i < radius; i++) {
+        j   = (i < 0) ? 0 : (i < length) ? i : length-1;
+        sum = _mm_add_epi32(sum, elm_blur_unpack(src[j]));
+    }
+
+    for (i=0; i < length; i++) {
+        j   = (i+radius < length) ? i+radius : length-1;
+        sum = _mm_add_epi32(sum, elm_blur_unpack(src[j]));
+        j   = (i-radius-1 > 0) ? i-radius-1 : 0;
+        sum = _mm_sub_epi32(sum, elm_blur_unpack(src[j]));
+        out = _mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(sum), scale));
+        out = _mm_packs_epi32(out, out);
+        out = _mm_packus_epi16(out, out);
+
+        dst[i*step] = _mm_cvtsi128_si32(out);
+    }
+}
+
+/* ************************************************************************** */
+/* Spread the four channels of a pixel over the lanes of a vector */
+__m128i elm_blur_unpack(uint32_t pixel)
+{
+    const __m128i zero = _mm_setzero_si128();
+
+    return _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(pixel), zero),
+                              zero);
+}
+#endif
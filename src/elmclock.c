@@ -0,0 +1,343 @@
+/* *****************************************************************************
+ * 
+ * Name:    elmclock.c
+ * Author:  Gabriel Gonzalez
+ * Email:   gabeg@bu.edu
+ * License: The MIT License (MIT)
+ * 
+ * Description: Shared greeter clock.
+ *              
+ * Notes: Subscribers give a strftime() format. The clock only wakes up when
+ *        the next of them could read differently: on the second for formats
+ *        with seconds, on the minute for formats with minutes, on the hour for
+ *        formats with hours, and at midnight otherwise. Boundaries are found
+ *        in local time, so they stay right across time zone offsets and
+ *        daylight saving time.
+ * 
+ *        A subscriber is only called when its text changed. A timer that fires
+ *        a little early formats the same text, and is simply set again.
+ * 
+ * *****************************************************************************
+ */
+
+/* Includes */
+#include "elmclock.h"
+#include "elmdef.h"
+#include "elmio.h"
+#include <glib.h>
+#include <string.h>
+#include <time.h>
+
+/* Typedefs */
+typedef enum
+{
+    ELM_CLOCK_SECOND,
+    ELM_CLOCK_MINUTE,
+    ELM_CLOCK_HOUR,
+    ELM_CLOCK_DAY
+} ElmClockPrecision;
+
+typedef struct
+{
+    char              *format;
+    ElmClockPrecision  precision;
+    char               text[ELM_MAX_MSG_SIZE];
+    ElmClockCallback   callback;
+    void              *data;
+} ElmClockSubscriber;
+
+/* Private functions */
+static ElmClockSubscriber * elm_clock_find(ElmClockCallback callback,
+                                           void *data);
+static void                 elm_clock_update(ElmClockSubscriber *sub,
+                                             time_t now);
+static void                 elm_clock_update_all(void);
+static void                 elm_clock_schedule(void);
+static gboolean             elm_clock_tick(gpointer data);
+static ElmClockPrecision    elm_clock_get_precision(const char *format);
+static time_t               elm_clock_get_boundary(time_t now,
+                                                   ElmClockPrecision precision);
+
+/* Private variables */
+static GSList        *Subscribers = NULL;
+static guint          Timer       = 0;
+static unsigned long  Ticks       = 0;
+static int            Paused      = 0;
+
+/* ************************************************************************** */
+/* Call a function with the current time, formatted, now and whenever the text
+ * changes */
+int elm_clock_subscribe(const char *format, ElmClockCallback callback,
+                        void *data)
+{
+    ElmClockSubscriber *sub;
+
+    if (!format || !callback) {
+        return -1;
+    }
+
+    /* Already subscribed, only the format changes */
+    if (elm_clock_find(callback, data)) {
+        return elm_clock_set_format(callback, data, format);
+    }
+
+    sub           = g_new0(ElmClockSubscriber, 1);
+    sub->callback = callback;
+    sub->data     = data;
+    Subscribers   = g_slist_append(Subscribers, sub);
+
+    if (elm_clock_set_format(callback, data, format) < 0) {
+        Subscribers = g_slist_remove(Subscribers, sub);
+        g_free(sub);
+        return -2;
+    }
+
+    return 0;
+}
+
+/* ************************************************************************** */
+/* Stop calling a function when the time changes */
+int elm_clock_unsubscribe(ElmClockCallback callback, void *data)
+{
+    ElmClockSubscriber *sub;
+
+    if (!(sub=elm_clock_find(callback, data))) {
+        return -1;
+    }
+
+    Subscribers = g_slist_remove(Subscribers, sub);
+
+    g_free(sub->format);
+    g_free(sub);
+    elm_clock_schedule();
+
+    return 0;
+}
+
+/* ************************************************************************** */
+/* Change the format of a subscriber. The text is formatted again right away. */
+int elm_clock_set_format(ElmClockCallback callback, void *data,
+                         const char *format)
+{
+    ElmClockSubscriber *sub;
+
+    if (!format || !(sub=elm_clock_find(callback, data))) {
+        return -1;
+    }
+
+    g_free(sub->format);
+
+    sub->format    = g_strdup(format);
+    sub->precision = elm_clock_get_precision(format);
+    sub->text[0]   = 0;
+
+    elm_clock_update(sub, time(NULL));
+    elm_clock_schedule();
+
+    return 0;
+}
+
+/* ************************************************************************** */
+/* Format the time again for every subscriber, such as after the greeter was
+ * hidden for a while */
+void elm_clock_refresh(void)
+{
+    elm_clock_update_all();
+    elm_clock_schedule();
+}
+
+/* ************************************************************************** */
+/* Stop the clock, such as while nobody looks at the greeter, or start it again
+ * with the current time */
+void elm_clock_pause(int flag)
+{
+    Paused = flag;
+
+    if (!Paused) {
+        elm_clock_update_all();
+    }
+
+    elm_clock_schedule();
+}
+
+/* ************************************************************************** */
+/* Return the subscriber for a function */
+ElmClockSubscriber * elm_clock_find(ElmClockCallback callback, void *data)
+{
+    ElmClockSubscriber *sub;
+    GSList             *node;
+
+    for (node=Subscribers; node; node=node->next)
+    {
+        sub = node->data;
+
+        if ((sub->callback == callback) && (sub->data == data)) {
+            return sub;
+        }
+    }
+
+    return NULL;
+}
+
+/* ************************************************************************** */
+/* Format the time for a subscriber, and call it if the text changed */
+void elm_clock_update(ElmClockSubscriber *sub, time_t now)
+{
+    struct tm tm;
+    char      text[ELM_MAX_MSG_SIZE];
+
+    localtime_r(&now, &tm);
+
+    if (!strftime(text, sizeof(text), sub->format, &tm)
+        || (strcmp(text, sub->text) == 0))
+    {
+        return;
+    }
+
+    memcpy(sub->text, text, sizeof(text));
+    sub->callback(sub->text, sub->data);
+}
+
+/* ************************************************************************** */
+/* Format the time for every subscriber */
+void elm_clock_update_all(void)
+{
+    time_t  now = time(NULL);
+    GSList *node;
+
+    for (node=Subscribers; node; node=node->next)
+    {
+        elm_clock_update(node->data, now);
+    }
+}
+
+/* ************************************************************************** */
+/* Set the timer for the next time that any subscriber could change */
+void elm_clock_schedule(void)
+{
+    ElmClockSubscriber *sub;
+    GSList             *node;
+    gint64              now  = g_get_real_time();
+    time_t              next = 0;
+    time_t              boundary;
+    gint64              delay;
+
+    if (Timer) {
+        g_source_remove(Timer);
+        Timer = 0;
+    }
+
+    for (node=Subscribers; node; node=node->next)
+    {
+        sub      = node->data;
+        boundary = elm_clock_get_boundary(now / G_USEC_PER_SEC, sub->precision);
+
+        if (!next || (boundary < next)) {
+            next = boundary;
+        }
+    }
+
+    if (!next || Paused) {
+        return;
+    }
+
+    /* Wake just after the boundary, rounded up to the millisecond */
+    delay = ((gint64)next * G_USEC_PER_SEC - now + 999) / 1000 + 1;
+    Timer = g_timeout_add(delay, elm_clock_tick, NULL);
+
+    elmprintf(LOGDEBUG, "Clock tick %lu, next in %ld ms.", Ticks, (long)delay);
+}
+
+/* ************************************************************************** */
+/* Update every subscriber and set the timer again */
+gboolean elm_clock_tick(gpointer data)
+{
+    Timer = 0;
+    Ticks++;
+
+    elm_clock_update_all();
+    elm_clock_schedule();
+
+    return G_SOURCE_REMOVE;
+}
+
+/* ************************************************************************** */
+/* Return the smallest unit of time that a format shows */
+ElmClockPrecision elm_clock_get_precision(const char *format)
+{
+    ElmClockPrecision  precision = ELM_CLOCK_DAY;
+    const char        *c;
+
+    for (c=strchr(format, '%'); c && c[1]; c=strchr(c+1, '%'))
+    {
+        /* Skip flags, width, and modifiers */
+        for (c++; *c && strchr("-_0^#EO123456789", *c); c++) {}
+
+        switch (*c) {
+        case 'S':
+        case 's':
+        case 'T':
+        case 'r':
+        case 'X':
+        case 'c':
+        case '+':
+            return ELM_CLOCK_SECOND;
+        case 'M':
+        case 'R':
+            precision = ELM_CLOCK_MINUTE;
+            break;
+        case 'H':
+        case 'I':
+        case 'k':
+        case 'l':
+        case 'p':
+        case 'P':
+            if (precision > ELM_CLOCK_HOUR) {
+                precision = ELM_CLOCK_HOUR;
+            }
+            break;
+        default:
+            break;
+        }
+
+        if (!*c) {
+            break;
+        }
+    }
+
+    return precision;
+}
+
+/* ************************************************************************** */
+/* Return the next time, after now, where a unit of time starts */
+time_t elm_clock_get_boundary(time_t now, ElmClockPrecision precision)
+{
+    struct tm tm;
+
+    if (precision == ELM_CLOCK_SECOND) {
+        return now+1;
+    }
+
+    localtime_r(&now, &tm);
+
+    tm.tm_sec = 0;
+
+    switch (precision) {
+    case ELM_CLOCK_MINUTE:
+        tm.tm_min++;
+        break;
+    case ELM_CLOCK_HOUR:
+        tm.tm_min = 0;
+        tm.tm_hour++;
+        break;
+    default:
+        tm.tm_min  = 0;
+        tm.tm_hour = 0;
+        tm.tm_mday++;
+        break;
+    }
+
+    tm.tm_isdst = -1;
+
+    return mktime(&tm);
+}
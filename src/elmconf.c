@@ -7,7 +7,20 @@
  * 
  * Description: Parse config files.
  * 
- * Notes: None.
+ * Notes: The config file is parsed once into an immutable snapshot. Every
+ *        value is converted up front (raw, unescaped, int, bool) and indexed
+ *        in a hash table, so reading a key is a single lookup that does not
+ *        allocate. Strings are interned and live for the whole program, which
+ *        is why callers must not free them.
+ *
+ *        The config file and its drop-in directory are watched with inotify.
+ *        A change is parsed into a new snapshot off to the side and published
+ *        with an atomic pointer swap, so a reader on another thread sees
+ *        either the old or the new config, never a partial one. A reader may
+ *        still hold an entry of a snapshot that was just replaced, and there
+ *        is no point at which that is known to be over, so replaced snapshots
+ *        are never freed. They are small, and only made when the config file
+ *        is edited.
  * 
  * *****************************************************************************
  */
@@ -16,113 +29,608 @@
 #include "elmconf.h"
 #include "elmdef.h"
 #include "elmio.h"
-#include "elmstr.h"
 #include <glib.h>
+#include <glib-unix.h>
 #include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+
+/* Typedefs */
+typedef struct
+{
+    const char *value;
+    const char *string;
+    int         integer;
+    int         intstatus;
+    bool        boolean;
+    int         boolstatus;
+} ElmConfEntry;
+
+typedef struct
+{
+    char           *group;
+    ElmConfCallback callback;
+    void           *data;
+} ElmConfSubscriber;
+
+struct ElmConfSnapshot
+{
+    int          valid;
+    GHashTable  *entries;
+    GHashTable  *keys;
+    char       **groups;
+};
 
 /* Private functions */
-int elm_conf_key_file(GKeyFile **keyfile, const char *configfile);
+static ElmConfSnapshot * elm_conf_get_snapshot(void);
+static ElmConfSnapshot * elm_conf_parse(const char *configfile,
+                                        const char *dropindir);
+static void              elm_conf_parse_dropins(GKeyFile *keyfile,
+                                                const char *dropindir);
+static void              elm_conf_parse_group(ElmConfSnapshot *snapshot,
+                                              GKeyFile *keyfile,
+                                              const char *group);
+static void              elm_conf_free(ElmConfSnapshot *snapshot);
+static gboolean          elm_conf_watch_event(gint fd, GIOCondition condition,
+                                              gpointer data);
+static int               elm_conf_watch_dropins(void);
+static gboolean          elm_conf_reload_timeout(gpointer data);
+static int               elm_conf_group_changed(ElmConfSnapshot *old,
+                                                ElmConfSnapshot *new,
+                                                const char *group);
+static void              elm_conf_notify(ElmConfSnapshot *old,
+                                         ElmConfSnapshot *new);
+static int               elm_conf_compare_names(const char **a,
+                                                const char **b);
+static ElmConfEntry *    elm_conf_lookup(const char *group, const char *key,
+                                         int *status);
+static const char *      elm_conf_intern(const char *string);
+static int               elm_conf_key(char *buf, size_t size,
+                                      const char *group, const char *key);
 
 /* Private variables */
-const char *ConfigFile = "/etc/X11/elm/etc/elm.conf";
+static const char      *ConfigDir   = "/etc/X11/elm/etc";
+static const char      *ConfigName  = "elm.conf";
+static const char      *ConfigFile  = "/etc/X11/elm/etc/elm.conf";
+static const char      *DropInName  = "elm.conf.d";
+static const char      *DropInDir   = "/etc/X11/elm/etc/elm.conf.d";
+static const guint      ReloadDelay = 250;
+static ElmConfSnapshot *Snapshot    = NULL;
+static GSList          *Retired     = NULL;
+static GSList          *Subscribers = NULL;
+static int              WatchFd     = -1;
+static int              DropInWd    = -1;
+static guint            ReloadId    = 0;
+static GStringChunk    *Strings     = NULL;
+static GMutex           StringsLock;
+static GMutex           LoadLock;
+static gint             ParseCount  = 0;
+static gint             LookupCount = 0;
+static gint             MissCount   = 0;
 
 /* ************************************************************************** */
 /* Read the configuration file and return the key value as a string */
-char * elm_conf_read(const char *group, const char *key)
+const char * elm_conf_read(const char *group, const char *key)
 {
-    GError      *err = NULL;
-    GKeyFile    *keyfile;
-    char        *value;
+    ElmConfEntry *entry = elm_conf_lookup(group, key, NULL);
 
-    if (elm_conf_key_file(&keyfile, ConfigFile) < 0) {
-        return NULL;
+    return (entry) ? entry->value : NULL;
+}
+
+/* ************************************************************************** */
+/* Read the configuration file and return the key value as an unescaped UTF-8
+ * string */
+const char * elm_conf_read_str(const char *group, const char *key)
+{
+    ElmConfEntry *entry = elm_conf_lookup(group, key, NULL);
+
+    return (entry) ? entry->string : NULL;
+}
+
+/* ************************************************************************** */
+/* Read the configuration file and return the key value as an int */
+int elm_conf_read_int(const char *group, const char *key)
+{
+    ElmConfEntry *entry;
+    int           status;
+
+    if (!(entry=elm_conf_lookup(group, key, &status))) {
+        return status;
     }
 
-    value = g_key_file_get_value(keyfile, group, key, &err);
+    if (entry->intstatus < 0) {
+        elmprintf(LOGWARN, "%s '%s' in group '%s' %s.",
+                  "Value of key", key, group, "is not an integer");
+        return entry->intstatus;
+    }
 
-    if (elm_is_key_err(&err)) {
-        return NULL;
+    return entry->integer;
+}
+
+/* ************************************************************************** */
+/* Read the configuration file and return the key value as a bool */
+bool elm_conf_read_bool(const char *group, const char *key)
+{
+    ElmConfEntry *entry;
+    int           status;
+
+    if (!(entry=elm_conf_lookup(group, key, &status))) {
+        return status;
+    }
+
+    if (entry->boolstatus < 0) {
+        elmprintf(LOGWARN, "%s '%s' in group '%s' %s.",
+                  "Value of key", key, group, "is not a boolean");
+        return entry->boolstatus;
     }
 
-    return elm_str_copy(value);
+    return entry->boolean;
 }
 
 /* ************************************************************************** */
-/* Read the configuration file and return the key value as an unescaped UTF-8
- * string */
-char * elm_conf_read_str(const char *group, const char *key)
+/* Return all groups in the config file */
+char ** elm_conf_get_groups(void)
 {
-    GError      *err = NULL;
-    GKeyFile    *keyfile;
-    char        *value;
+    ElmConfSnapshot *snapshot = elm_conf_get_snapshot();
 
-    if (elm_conf_key_file(&keyfile, ConfigFile) < 0) {
+    if (!snapshot->valid) {
         return NULL;
     }
 
-    value = g_key_file_get_string(keyfile, group, key, &err);
+    return g_strdupv(snapshot->groups);
+}
 
-    if (elm_is_key_err(&err)) {
+/* ************************************************************************** */
+/* Return all keys for a given group in the config file */
+char ** elm_conf_get_keys(const char *group)
+{
+    ElmConfSnapshot  *snapshot = elm_conf_get_snapshot();
+    char            **keys;
+
+    if (!snapshot->valid) {
+        return NULL;
+    }
+
+    if (!(keys=g_hash_table_lookup(snapshot->keys, group))) {
+        elmprintf(LOGWARN, "Config file does not have group '%s'.", group);
         return NULL;
     }
 
-    return elm_str_copy(value);
+    return g_strdupv(keys);
 }
 
 /* ************************************************************************** */
-/* Read the configuration file and return the key value as an int */
-int elm_conf_read_int(const char *group, const char *key)
+/* Parse the config file, if it has not been parsed already */
+int elm_conf_load(void)
+{
+    return (elm_conf_get_snapshot()->valid) ? 0 : -1;
+}
+
+/* ************************************************************************** */
+/* Return config parse and lookup counters */
+void elm_conf_get_stats(ElmConfStats *stats)
 {
-    GError   *err = NULL;
-    GKeyFile *keyfile;
-    gint      read;
+    stats->parses  = g_atomic_int_get(&ParseCount);
+    stats->lookups = g_atomic_int_get(&LookupCount);
+    stats->misses  = g_atomic_int_get(&MissCount);
+}
 
-    if (elm_conf_key_file(&keyfile, ConfigFile) < 0) {
-        return -1;
+/* ************************************************************************** */
+/* Print config parse and lookup counters */
+void elm_conf_log_stats(void)
+{
+    ElmConfStats stats;
+
+    elm_conf_get_stats(&stats);
+    elmprintf(LOGINFO, "Config file parsed %u time(s), %u lookup(s), %u miss(es).",
+              stats.parses, stats.lookups, stats.misses);
+}
+
+/* ************************************************************************** */
+/* Watch the config file and its drop-in directory for changes. The watch is
+ * serviced by the default GLib main context. */
+int elm_conf_watch(void)
+{
+    if (WatchFd >= 0) {
+        return 0;
     }
 
-    read = g_key_file_get_integer(keyfile, group, key, &err);
+    elmprintf(LOGINFO, "Watching config directory '%s'.", ConfigDir);
+
+    uint32_t mask = (IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE
+                     | IN_DELETE);
 
-    if (elm_is_key_err(&err)) {
+    if ((WatchFd=inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) < 0) {
+        elmprintf(LOGERRNO, "Unable to initialize inotify");
+        return -1;
+    }
+
+    if (inotify_add_watch(WatchFd, ConfigDir, mask) < 0) {
+        elmprintf(LOGERRNO, "%s '%s'", "Unable to watch directory", ConfigDir);
+        close(WatchFd);
+        WatchFd = -1;
         return -2;
     }
 
-    return read;
+    elm_conf_watch_dropins();
+    g_unix_fd_add(WatchFd, G_IO_IN, elm_conf_watch_event, NULL);
+
+    return 0;
 }
 
 /* ************************************************************************** */
-/* Read the configuration file and return the key value as a bool */
-bool elm_conf_read_bool(const char *group, const char *key)
+/* Reparse the config file and publish the new snapshot. Subscribers of every
+ * group that changed are notified. */
+int elm_conf_reload(void)
 {
-    GError   *err = NULL;
-    GKeyFile *keyfile;
-    gboolean  read;
+    elmprintf(LOGINFO, "Reloading config file.");
+
+    ElmConfSnapshot *new = elm_conf_parse(ConfigFile, DropInDir);
+    ElmConfSnapshot *old;
 
-    if (elm_conf_key_file(&keyfile, ConfigFile) < 0) {
+    if (!new->valid) {
+        elmprintf(LOGWARN, "Keeping current config: new config is invalid.");
+        elm_conf_free(new);
         return -1;
     }
 
-    read = g_key_file_get_boolean(keyfile, group, key, &err);
+    g_mutex_lock(&LoadLock);
+    old = g_atomic_pointer_exchange(&Snapshot, new);
+    g_mutex_unlock(&LoadLock);
 
-    if (elm_is_key_err(&err)) {
-        return -2;
+    /* Kept for the readers that may still be using it */
+    elm_conf_notify(old, new);
+
+    Retired = g_slist_prepend(Retired, old);
+
+    return 0;
+}
+
+/* ************************************************************************** */
+/* Call a function whenever a key in the given config group changes */
+int elm_conf_subscribe(const char *group, ElmConfCallback callback, void *data)
+{
+    ElmConfSubscriber *sub = g_new0(ElmConfSubscriber, 1);
+
+    sub->group    = g_strdup(group);
+    sub->callback = callback;
+    sub->data     = data;
+
+    Subscribers = g_slist_append(Subscribers, sub);
+
+    return 0;
+}
+
+/* ************************************************************************** */
+/* Stop calling a function when a config group changes */
+int elm_conf_unsubscribe(const char *group, ElmConfCallback callback,
+                         void *data)
+{
+    ElmConfSubscriber *sub;
+    GSList            *node;
+
+    for (node=Subscribers; node; node=node->next)
+    {
+        sub = node->data;
+
+        if ((sub->callback == callback) && (sub->data == data)
+            && !strcmp(sub->group, group))
+        {
+            Subscribers = g_slist_remove(Subscribers, sub);
+            g_free(sub->group);
+            g_free(sub);
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+/* ************************************************************************** */
+/* Check if an error occurred */
+int elm_is_key_err(GError **err)
+{
+    if (*err) {
+        elmprintf(LOGWARN, (*err)->message);
+        g_error_free(*err);
+        return 1;
+    }
+
+    return 0;
+}
+
+/* ************************************************************************** */
+/* Return the config snapshot, parsing the config file on first use */
+ElmConfSnapshot * elm_conf_get_snapshot(void)
+{
+    ElmConfSnapshot *snapshot = g_atomic_pointer_get(&Snapshot);
+
+    if (snapshot) {
+        return snapshot;
     }
 
-    return read;
+    g_mutex_lock(&LoadLock);
+
+    if (!(snapshot=g_atomic_pointer_get(&Snapshot))) {
+        snapshot = elm_conf_parse(ConfigFile, DropInDir);
+        g_atomic_pointer_set(&Snapshot, snapshot);
+    }
+
+    g_mutex_unlock(&LoadLock);
+
+    return snapshot;
 }
 
 /* ************************************************************************** */
-/* Return key populated by config file */
-int elm_conf_key_file(GKeyFile **keyfile, const char *configfile)
+/* Parse a config file into a new snapshot. A file that cannot be loaded gives
+ * an empty, invalid snapshot, so that lookups fail fast instead of retrying the
+ * parse. */
+ElmConfSnapshot * elm_conf_parse(const char *configfile, const char *dropindir)
 {
-    GKeyFileFlags  flags = G_KEY_FILE_NONE;
-    GError        *err   = NULL;
+    elmprintf(LOGINFO, "Parsing config file '%s'.", configfile);
 
-    *keyfile = g_key_file_new();
+    ElmConfSnapshot *snapshot = g_new0(ElmConfSnapshot, 1);
+    GKeyFile        *keyfile  = g_key_file_new();
+    GError          *err      = NULL;
+    size_t           i;
 
-    if (!g_key_file_load_from_file(*keyfile, configfile, flags, &err)) {
+    snapshot->entries = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                              NULL, g_free);
+    snapshot->keys    = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                              NULL, (GDestroyNotify)g_strfreev);
+
+    g_atomic_int_inc(&ParseCount);
+
+    if (!g_key_file_load_from_file(keyfile, configfile, G_KEY_FILE_NONE, &err)) {
         elm_is_key_err(&err);
-        *keyfile = NULL;
+        g_key_file_free(keyfile);
+        return snapshot;
+    }
+
+    elm_conf_parse_dropins(keyfile, dropindir);
+
+    snapshot->groups = g_key_file_get_groups(keyfile, NULL);
+
+    for (i=0; snapshot->groups[i]; i++) {
+        elm_conf_parse_group(snapshot, keyfile, snapshot->groups[i]);
+    }
+
+    snapshot->valid = 1;
+
+    g_key_file_free(keyfile);
+
+    return snapshot;
+}
+
+/* ************************************************************************** */
+/* Merge the '*.conf' files of the drop-in directory, in name order, over the
+ * main config file */
+void elm_conf_parse_dropins(GKeyFile *keyfile, const char *dropindir)
+{
+    GDir        *dir;
+    GPtrArray   *files;
+    GKeyFile    *dropin;
+    GError      *err = NULL;
+    const char  *name;
+    char       **groups;
+    char       **keys;
+    char        *value;
+    char        *path;
+    size_t       i;
+    size_t       j;
+    size_t       k;
+
+    if (!(dir=g_dir_open(dropindir, 0, NULL))) {
+        return;
+    }
+
+    files = g_ptr_array_new_with_free_func(g_free);
+
+    while ((name=g_dir_read_name(dir))) {
+        if (g_str_has_suffix(name, ".conf")) {
+            g_ptr_array_add(files, g_strdup(name));
+        }
+    }
+
+    g_dir_close(dir);
+    g_ptr_array_sort(files, (GCompareFunc)elm_conf_compare_names);
+
+    for (i=0; i < files->len; i++)
+    {
+        path   = g_build_filename(dropindir, g_ptr_array_index(files, i), NULL);
+        dropin = g_key_file_new();
+
+        elmprintf(LOGDEBUG, "Merging config drop-in '%s'.", path);
+
+        if (!g_key_file_load_from_file(dropin, path, G_KEY_FILE_NONE, &err)) {
+            elm_is_key_err(&err);
+            g_key_file_free(dropin);
+            g_free(path);
+            continue;
+        }
+
+        groups = g_key_file_get_groups(dropin, NULL);
+
+        for (j=0; groups[j]; j++)
+        {
+            keys = g_key_file_get_keys(dropin, groups[j], NULL, NULL);
+
+            for (k=0; keys && keys[k]; k++) {
+                value = g_key_file_get_value(dropin, groups[j], keys[k], NULL);
+                g_key_file_set_value(keyfile, groups[j], keys[k], value);
+                g_free(value);
+            }
+
+            g_strfreev(keys);
+        }
+
+        g_strfreev(groups);
+        g_key_file_free(dropin);
+        g_free(path);
+    }
+
+    g_ptr_array_free(files, TRUE);
+}
+
+/* ************************************************************************** */
+/* Convert and index every key in a config group */
+void elm_conf_parse_group(ElmConfSnapshot *snapshot, GKeyFile *keyfile,
+                          const char *group)
+{
+    ElmConfEntry  *entry;
+    GError        *err  = NULL;
+    char         **keys = g_key_file_get_keys(keyfile, group, NULL, NULL);
+    char           name[ELM_MAX_CONF_SIZE];
+    char          *value;
+    size_t         i;
+
+    if (!keys) {
+        return;
+    }
+
+    for (i=0; keys[i]; i++)
+    {
+        if (elm_conf_key(name, sizeof(name), group, keys[i]) < 0) {
+            continue;
+        }
+
+        entry = g_new0(ElmConfEntry, 1);
+
+        /* Raw and unescaped values */
+        value        = g_key_file_get_value(keyfile, group, keys[i], NULL);
+        entry->value = elm_conf_intern(value);
+        g_free(value);
+
+        value         = g_key_file_get_string(keyfile, group, keys[i], NULL);
+        entry->string = elm_conf_intern(value);
+        g_free(value);
+
+        /* Typed values */
+        entry->integer = g_key_file_get_integer(keyfile, group, keys[i], &err);
+
+        if (err) {
+            entry->intstatus = -2;
+            g_clear_error(&err);
+        }
+
+        entry->boolean = g_key_file_get_boolean(keyfile, group, keys[i], &err);
+
+        if (err) {
+            entry->boolstatus = -2;
+            g_clear_error(&err);
+        }
+
+        g_hash_table_replace(snapshot->entries,
+                             (char*)elm_conf_intern(name), entry);
+    }
+
+    g_hash_table_replace(snapshot->keys, (char*)elm_conf_intern(group), keys);
+}
+
+/* ************************************************************************** */
+/* Find the entry for a key. Status is set to -1 if the config file could not be
+ * loaded and -2 if the key does not exist. */
+ElmConfEntry * elm_conf_lookup(const char *group, const char *key, int *status)
+{
+    ElmConfSnapshot *snapshot = elm_conf_get_snapshot();
+    ElmConfEntry    *entry    = NULL;
+    char             name[ELM_MAX_CONF_SIZE];
+    int              dummy;
+
+    status  = (status) ? status : &dummy;
+    *status = 0;
+
+    g_atomic_int_inc(&LookupCount);
+
+    if (!snapshot->valid) {
+        *status = -1;
+        return NULL;
+    }
+
+    if ((elm_conf_key(name, sizeof(name), group, key) < 0)
+        || !(entry=g_hash_table_lookup(snapshot->entries, name)))
+    {
+        g_atomic_int_inc(&MissCount);
+        elmprintf(LOGWARN, "%s '%s' in group '%s'.",
+                  "Config file does not have key", key, group);
+        *status = -2;
+        return NULL;
+    }
+
+    return entry;
+}
+
+/* ************************************************************************** */
+/* Free a config snapshot. The interned strings are not freed. */
+void elm_conf_free(ElmConfSnapshot *snapshot)
+{
+    if (!snapshot) {
+        return;
+    }
+
+    g_hash_table_destroy(snapshot->entries);
+    g_hash_table_destroy(snapshot->keys);
+    g_strfreev(snapshot->groups);
+    g_free(snapshot);
+}
+
+/* ************************************************************************** */
+/* Handle inotify events in the config directories. Reloading is delayed a
+ * little so that a burst of events (an editor saving, a package unpacking
+ * several drop-ins) results in a single reload. */
+gboolean elm_conf_watch_event(gint fd, GIOCondition condition, gpointer data)
+{
+    char                        buf[4096]
+                                __attribute__((aligned(__alignof__(struct inotify_event))));
+    const struct inotify_event *event;
+    ssize_t                     nbytes;
+    char                       *ptr;
+    int                         reload = 0;
+
+    while ((nbytes=read(fd, buf, sizeof(buf))) > 0)
+    {
+        for (ptr=buf; ptr < buf+nbytes; ptr += sizeof(*event)+event->len)
+        {
+            event = (const struct inotify_event*) ptr;
+
+            if (!event->len) {
+                continue;
+            }
+
+            /* Change in the drop-in directory */
+            if (event->wd == DropInWd) {
+                reload |= g_str_has_suffix(event->name, ".conf");
+                continue;
+            }
+
+            /* Change in the config directory */
+            if (!strcmp(event->name, DropInName)) {
+                elm_conf_watch_dropins();
+                reload = 1;
+            }
+            else if (!strcmp(event->name, ConfigName)) {
+                reload = 1;
+            }
+        }
+    }
+
+    if (reload && !ReloadId) {
+        ReloadId = g_timeout_add(ReloadDelay, elm_conf_reload_timeout, NULL);
+    }
+
+    return G_SOURCE_CONTINUE;
+}
+
+/* ************************************************************************** */
+/* Watch the drop-in directory, if it exists */
+int elm_conf_watch_dropins(void)
+{
+    uint32_t mask = (IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE
+                     | IN_DELETE | IN_ONLYDIR);
+
+    if ((DropInWd=inotify_add_watch(WatchFd, DropInDir, mask)) < 0) {
         return -1;
     }
 
@@ -130,50 +638,115 @@ int elm_conf_key_file(GKeyFile **keyfile, const char *configfile)
 }
 
 /* ************************************************************************** */
-/* Return all groups in the config file */
-char ** elm_conf_get_groups(void)
+/* Reload the config file once the watched directories settle down */
+gboolean elm_conf_reload_timeout(gpointer data)
 {
-    GKeyFile  *keyfile;
-    char     **groups;
+    ReloadId = 0;
 
-    if (elm_conf_key_file(&keyfile, ConfigFile) < 0) {
-        return NULL;
+    elm_conf_reload();
+
+    return G_SOURCE_REMOVE;
+}
+
+/* ************************************************************************** */
+/* Check if the keys or values of a config group differ between two snapshots.
+ * Interned strings are shared, so equal values have equal pointers. */
+int elm_conf_group_changed(ElmConfSnapshot *old, ElmConfSnapshot *new,
+                           const char *group)
+{
+    char         **oldkeys = g_hash_table_lookup(old->keys, group);
+    char         **newkeys = g_hash_table_lookup(new->keys, group);
+    ElmConfEntry  *oldentry;
+    ElmConfEntry  *newentry;
+    char           name[ELM_MAX_CONF_SIZE];
+    size_t         i;
+
+    if (!oldkeys || !newkeys) {
+        return (oldkeys != newkeys);
     }
 
-    groups = g_key_file_get_groups(keyfile, NULL);
+    if (g_strv_length(oldkeys) != g_strv_length(newkeys)) {
+        return 1;
+    }
+
+    for (i=0; newkeys[i]; i++)
+    {
+        if (elm_conf_key(name, sizeof(name), group, newkeys[i]) < 0) {
+            continue;
+        }
 
-    return groups;
+        oldentry = g_hash_table_lookup(old->entries, name);
+        newentry = g_hash_table_lookup(new->entries, name);
+
+        if (!oldentry || !newentry || (oldentry->value != newentry->value)) {
+            return 1;
+        }
+    }
+
+    return 0;
 }
 
 /* ************************************************************************** */
-/* Return all keys for a given group in the config file */
-char ** elm_conf_get_keys(const char *group)
+/* Notify the subscribers of each config group that changed */
+void elm_conf_notify(ElmConfSnapshot *old, ElmConfSnapshot *new)
+{
+    ElmConfSubscriber *sub;
+    GSList            *node;
+    GSList            *next;
+
+    for (node=Subscribers; node; node=next)
+    {
+        sub  = node->data;
+        next = node->next;
+
+        if (!old->valid || elm_conf_group_changed(old, new, sub->group)) {
+            elmprintf(LOGINFO, "Config group '%s' changed.", sub->group);
+            sub->callback(sub->group, sub->data);
+        }
+    }
+}
+
+/* ************************************************************************** */
+/* Compare two file names */
+int elm_conf_compare_names(const char **a, const char **b)
+{
+    return strcmp(*a, *b);
+}
+
+/* ************************************************************************** */
+/* Return a copy of a string that lives for the rest of the program. Equal
+ * strings share the same copy. */
+const char * elm_conf_intern(const char *string)
 {
-    GError    *err = NULL;
-    GKeyFile  *keyfile;
-    char     **keys;
+    const char *interned;
 
-    if (elm_conf_key_file(&keyfile, ConfigFile) < 0) {
+    if (!string) {
         return NULL;
     }
 
-    keys = g_key_file_get_keys(keyfile, group, NULL, &err);
+    g_mutex_lock(&StringsLock);
 
-    if (elm_is_key_err(&err)) {
-        return NULL;
+    if (!Strings) {
+        Strings = g_string_chunk_new(ELM_MAX_LINE_SIZE);
     }
 
-    return keys;
+    interned = g_string_chunk_insert_const(Strings, string);
+
+    g_mutex_unlock(&StringsLock);
+
+    return interned;
 }
 
 /* ************************************************************************** */
-/* Check if an error occurred */
-int elm_is_key_err(GError **err)
+/* Write the hash table key for a group/key pair into a buffer */
+int elm_conf_key(char *buf, size_t size, const char *group, const char *key)
 {
-    if (*err) {
-        elmprintf(LOGWARN, (*err)->message);
-        g_error_free(*err);
-        return 1;
+    int length = snprintf(buf, size, "%s\037%s", group, key);
+
+    if ((length < 0) || ((size_t)length >= size)) {
+        elmprintf(LOGERR, "%s '%s' in group '%s'.",
+                  "Config key name is too long", key, group);
+        return -1;
     }
 
     return 0;
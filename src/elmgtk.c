@@ -15,15 +15,56 @@
 
 /* Includes */
 #include "elmgtk.h"
+#include "elmbackground.h"
 #include "elmconf.h"
 #include "elmdef.h"
 #include "elmstr.h"
 #include <stdlib.h>
+#include <string.h>
 #include <strings.h>
 #include <unistd.h>
 #include <gdk/gdk.h>
 #include <gtk/gtk.h>
 
+/* Typedefs */
+typedef struct
+{
+    GtkWidget  *widget;
+    char       *group;
+    char       *xkey;
+    char       *ykey;
+} ElmGtkConfSize;
+
+typedef struct
+{
+    cairo_surface_t *surface;
+    cairo_surface_t *background;
+    int              x;
+    int              y;
+    int              width;
+    int              height;
+    int              radius;
+} ElmGtkBackdrop;
+
+/* Private functions */
+static void     elm_gtk_conf_size_changed(const char *group, void *data);
+static void     elm_gtk_conf_size_destroy(GtkWidget *widget, gpointer data);
+static gboolean elm_gtk_draw_background(GtkWidget *widget, cairo_t *cr,
+                                        gpointer data);
+static char *   elm_gtk_get_theme(guint *count);
+static gint     elm_gtk_compare_names(gconstpointer a, gconstpointer b);
+static void     elm_gtk_theme_conf_changed(const char *group, void *data);
+static void     elm_gtk_backdrop_free(gpointer data);
+static void     elm_gtk_backdrop_clear(GtkWidget *widget, gpointer data);
+
+/* Private variables */
+static GtkCssProvider *Theme          = NULL;
+static const char     *ThemeConf[][3] =
+{
+    {"Manager",     "Images", "Background"},
+    {"PowerButton", "Images", "Power"}
+};
+
 /* ************************************************************************** */
 /* Add widget to container */
 int elm_gtk_add_widget(GtkWidget **container, GtkWidget *widget)
@@ -38,67 +79,51 @@ int elm_gtk_add_widget(GtkWidget **container, GtkWidget *widget)
 }
 
 /* ************************************************************************** */
-/* Add a CSS rule defined in a configuration file */
-int elm_gtk_add_css_from_conf(GtkWidget **widget, char *selector, char *group,
-                              char *key)
+/* Add a style class to a widget. Its rules come from the theme. */
+int elm_gtk_add_class(GtkWidget **widget, const char *name)
 {
-    /* Determine css rule */
-    char *value = elm_conf_read(group, key);
-    char *line  = elm_gtk_get_css_decl_bg(value);
-    char *rule  = elm_gtk_get_css_rule(selector, line);
-
-    if (!value || !line || !rule) {
+    if (!widget || !name) {
         return -1;
     }
 
-    /* Load css rule */
     GtkStyleContext *context = gtk_widget_get_style_context(*widget);
-    GtkCssProvider  *css     = gtk_css_provider_new();
-    GError          *err     = NULL;
 
-    gtk_css_provider_load_from_data(GTK_CSS_PROVIDER(css), rule, -1, &err);
-
-    if (elm_is_key_err(&err)) {
-        return -2;
-    }
-
-    /* Add rule to widget */
-    gtk_style_context_add_class(context, selector);
-    gtk_style_context_add_provider(context, GTK_STYLE_PROVIDER(css),
-                                   GTK_STYLE_PROVIDER_PRIORITY_APPLICATION);
-    g_object_unref(css);
+    gtk_style_context_add_class(context, name);
 
     return 0;
 }
 
 /* ************************************************************************** */
-/* Add CSS rules defined in a file */
-int elm_gtk_add_css_from_file(GtkWidget **widget, const char *selector,
-                              const char *file)
+/* Load the stylesheets of every app into a single provider for the screen, so
+ * that they are parsed once instead of once per widget. Images from the config
+ * file are added as rules of their own, and are reloaded when they change. */
+int elm_gtk_load_theme(void)
 {
-    if (access(file, F_OK)) {
-        return -1;
+    GError *err   = NULL;
+    guint   count = 0;
+    char   *theme = elm_gtk_get_theme(&count);
+    gint64  start;
+
+    if (!Theme) {
+        Theme = gtk_css_provider_new();
+
+        gtk_style_context_add_provider_for_screen(gdk_screen_get_default(),
+                                                  GTK_STYLE_PROVIDER(Theme),
+                                                  GTK_STYLE_PROVIDER_PRIORITY_USER);
+        elm_conf_subscribe("Images", elm_gtk_theme_conf_changed, NULL);
     }
 
-    /* Load css rule */
-    GtkStyleContext *context = gtk_widget_get_style_context(*widget);
-    GtkCssProvider  *css     = gtk_css_provider_new();
-    GError          *err     = NULL;
+    start = g_get_monotonic_time();
 
-    gtk_css_provider_load_from_path(css, file, &err);
+    gtk_css_provider_load_from_data(Theme, theme, -1, &err);
+    g_free(theme);
 
     if (elm_is_key_err(&err)) {
-        return -2;
-    }
-
-    /* Add rule to widget */
-    if (selector) {
-        gtk_style_context_add_class(context, selector);
+        return -1;
     }
 
-    gtk_style_context_add_provider(context, GTK_STYLE_PROVIDER(css), 
-                                   GTK_STYLE_PROVIDER_PRIORITY_USER);
-    g_object_unref(css);
+    elmprintf(LOGINFO, "Loaded %u stylesheet(s) into one provider in %.2f ms.",
+              count, (g_get_monotonic_time()-start) / 1000.0);
 
     return 0;
 }
@@ -145,6 +170,7 @@ int elm_gtk_set_window_size(GtkWidget **window, int width, int height)
     }
 
     gtk_window_set_default_size(GTK_WINDOW(*window), width, height);
+    gtk_window_resize(GTK_WINDOW(*window), width, height);
 
     return 0;
 }
@@ -161,6 +187,29 @@ int elm_gtk_set_window_transparent(GtkWidget **window)
     return 0;
 }
 
+/* ************************************************************************** */
+/* Paint a surface as the window background, centered. Replaces a previously
+ * set surface. */
+int elm_gtk_set_window_background(GtkWidget **window, cairo_surface_t *surface)
+{
+    if (!window || !surface) {
+        return -1;
+    }
+
+    if (!g_object_get_data(G_OBJECT(*window), "elm-background")) {
+        gtk_widget_set_app_paintable(*window, TRUE);
+        g_signal_connect(*window, "draw", G_CALLBACK(elm_gtk_draw_background),
+                         NULL);
+    }
+
+    g_object_set_data_full(G_OBJECT(*window), "elm-background",
+                           cairo_surface_reference(surface),
+                           (GDestroyNotify)cairo_surface_destroy);
+    gtk_widget_queue_draw(*window);
+
+    return 0;
+}
+
 /* ************************************************************************** */
 /* Set size of widget */
 int elm_gtk_set_widget_size(GtkWidget **widget, int width, int height)
@@ -175,10 +224,22 @@ int elm_gtk_set_widget_size(GtkWidget **widget, int width, int height)
 }
 
 /* ************************************************************************** */
-/* Set size of widget from config file */
+/* Set size of widget from config file. The size is applied again whenever the
+ * config group changes. */
 int elm_gtk_set_widget_size_from_conf(GtkWidget **widget, const char *group,
                                       const char *xkey, const char *ykey)
 {
+    ElmGtkConfSize *size = g_new0(ElmGtkConfSize, 1);
+
+    size->widget = *widget;
+    size->group  = g_strdup(group);
+    size->xkey   = g_strdup(xkey);
+    size->ykey   = g_strdup(ykey);
+
+    elm_conf_subscribe(group, elm_gtk_conf_size_changed, size);
+    g_signal_connect(*widget, "destroy", G_CALLBACK(elm_gtk_conf_size_destroy),
+                     size);
+
     int width  = elm_conf_read_int(group, xkey);
     int height = elm_conf_read_int(group, ykey);
 
@@ -205,7 +266,7 @@ char * elm_gtk_get_css_decl(char *name, char *args)
 
 /* ************************************************************************** */
 /* Return a background image declaration line for a CSS rule */
-char * elm_gtk_get_css_decl_bg(char *path)
+char * elm_gtk_get_css_decl_bg(const char *path)
 {
     if (!path) {
         return NULL;
@@ -248,3 +309,216 @@ GtkWidget * elm_gtk_get_window(GtkWidget **widget)
 
     return NULL;
 }
+
+/* ************************************************************************** */
+/* Return the part of the window background that lies under a widget, blurred.
+ * Widgets paint it under their own translucent colors, which looks like frosted
+ * glass with no compositor. It is only blurred again once the widget moves or
+ * resizes, or the background changes. */
+cairo_surface_t * elm_gtk_get_backdrop(GtkWidget *widget, int radius)
+{
+    GtkWidget       *window     = gtk_widget_get_toplevel(widget);
+    cairo_surface_t *background = g_object_get_data(G_OBJECT(window),
+                                                    "elm-background");
+    ElmGtkBackdrop  *backdrop   = g_object_get_data(G_OBJECT(widget),
+                                                    "elm-backdrop");
+    int              width      = gtk_widget_get_allocated_width(widget);
+    int              height     = gtk_widget_get_allocated_height(widget);
+    int              x;
+    int              y;
+    cairo_t         *cr;
+    gint64           start;
+
+    if (!background
+        || !gtk_widget_translate_coordinates(widget, window, 0, 0, &x, &y))
+    {
+        return NULL;
+    }
+
+    /* The background is painted centered in the window */
+    x -= (gtk_widget_get_allocated_width(window)
+          - cairo_image_surface_get_width(background)) / 2;
+    y -= (gtk_widget_get_allocated_height(window)
+          - cairo_image_surface_get_height(background)) / 2;
+
+    if (backdrop && (backdrop->background == background) && (backdrop->x == x)
+        && (backdrop->y == y) && (backdrop->width == width)
+        && (backdrop->height == height) && (backdrop->radius == radius))
+    {
+        return backdrop->surface;
+    }
+
+    start    = g_get_monotonic_time();
+    backdrop = g_new0(ElmGtkBackdrop, 1);
+
+    backdrop->surface    = cairo_image_surface_create(CAIRO_FORMAT_ARGB32,
+                                                      width, height);
+    backdrop->background = cairo_surface_reference(background);
+    backdrop->x          = x;
+    backdrop->y          = y;
+    backdrop->width      = width;
+    backdrop->height     = height;
+    backdrop->radius     = radius;
+
+    cr = cairo_create(backdrop->surface);
+
+    cairo_set_source_surface(cr, background, -x, -y);
+    cairo_paint(cr);
+    cairo_destroy(cr);
+    elm_background_blur(backdrop->surface, radius);
+
+    g_object_set_data_full(G_OBJECT(widget), "elm-backdrop", backdrop,
+                           elm_gtk_backdrop_free);
+    elmprintf(LOGINFO, "Blurred %dx%d backdrop in %.2f ms.", width, height,
+              (g_get_monotonic_time()-start) / 1000.0);
+
+    return backdrop->surface;
+}
+
+/* ************************************************************************** */
+/* Drop the backdrops of a widget and all of its children. They are blurred
+ * again the next time they are drawn. */
+void elm_gtk_clear_backdrops(GtkWidget *widget)
+{
+    elm_gtk_backdrop_clear(widget, NULL);
+}
+
+/* ************************************************************************** */
+/* Apply the size of a widget after its config group changed */
+void elm_gtk_conf_size_changed(const char *group, void *data)
+{
+    ElmGtkConfSize *size   = data;
+    int             width  = elm_conf_read_int(size->group, size->xkey);
+    int             height = elm_conf_read_int(size->group, size->ykey);
+
+    if ((width < 0) || (height < 0)) {
+        return;
+    }
+
+    elm_gtk_set_widget_size(&size->widget, width, height);
+}
+
+/* ************************************************************************** */
+/* Stop following the config size of a widget that is destroyed */
+void elm_gtk_conf_size_destroy(GtkWidget *widget, gpointer data)
+{
+    ElmGtkConfSize *size = data;
+
+    elm_conf_unsubscribe(size->group, elm_gtk_conf_size_changed, size);
+    g_free(size->group);
+    g_free(size->xkey);
+    g_free(size->ykey);
+    g_free(size);
+}
+
+/* ************************************************************************** */
+/* Paint the background surface of a window. The children are drawn on top of
+ * it afterwards. */
+gboolean elm_gtk_draw_background(GtkWidget *widget, cairo_t *cr, gpointer data)
+{
+    cairo_surface_t *surface = g_object_get_data(G_OBJECT(widget),
+                                                 "elm-background");
+    int              width   = gtk_widget_get_allocated_width(widget);
+    int              height  = gtk_widget_get_allocated_height(widget);
+    int              x;
+    int              y;
+
+    if (!surface) {
+        return FALSE;
+    }
+
+    x = (width  - cairo_image_surface_get_width(surface))  / 2;
+    y = (height - cairo_image_surface_get_height(surface)) / 2;
+
+    cairo_set_source_surface(cr, surface, x, y);
+    cairo_paint(cr);
+
+    return FALSE;
+}
+
+/* ************************************************************************** */
+/* Return the theme data. Stylesheets are imported in name order, followed by
+ * the rules built from the config file. */
+char * elm_gtk_get_theme(guint *count)
+{
+    GString    *theme = g_string_new(NULL);
+    GPtrArray  *files = g_ptr_array_new_with_free_func(g_free);
+    GDir       *dir   = g_dir_open(ELM_CSS_DIR, 0, NULL);
+    const char *name;
+    char       *line;
+    char       *rule;
+    guint       i;
+
+    if (dir) {
+        while ((name=g_dir_read_name(dir))) {
+            if (g_str_has_suffix(name, ".css")) {
+                g_ptr_array_add(files, g_strdup(name));
+            }
+        }
+
+        g_dir_close(dir);
+    }
+
+    g_ptr_array_sort(files, elm_gtk_compare_names);
+
+    for (i=0; i < files->len; i++) {
+        g_string_append_printf(theme, "@import url('%s/%s');\n", ELM_CSS_DIR,
+                               (char*)g_ptr_array_index(files, i));
+    }
+
+    for (i=0; i < sizeof(ThemeConf)/sizeof(ThemeConf[0]); i++) {
+        line = elm_gtk_get_css_decl_bg(elm_conf_read(ThemeConf[i][1],
+                                                     ThemeConf[i][2]));
+        rule = elm_gtk_get_css_rule((char*)ThemeConf[i][0], line);
+
+        if (rule) {
+            g_string_append(theme, rule);
+        }
+
+        free(line);
+        free(rule);
+    }
+
+    *count = files->len;
+
+    g_ptr_array_free(files, TRUE);
+
+    return g_string_free(theme, FALSE);
+}
+
+/* ************************************************************************** */
+/* Compare two file names, for sorting */
+gint elm_gtk_compare_names(gconstpointer a, gconstpointer b)
+{
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+/* ************************************************************************** */
+/* Free the backdrop of a widget */
+void elm_gtk_backdrop_free(gpointer data)
+{
+    ElmGtkBackdrop *backdrop = data;
+
+    cairo_surface_destroy(backdrop->surface);
+    cairo_surface_destroy(backdrop->background);
+    g_free(backdrop);
+}
+
+/* ************************************************************************** */
+/* Drop the backdrop of a widget, and recurse into its children */
+void elm_gtk_backdrop_clear(GtkWidget *widget, gpointer data)
+{
+    g_object_set_data(G_OBJECT(widget), "elm-backdrop", NULL);
+
+    if (GTK_IS_CONTAINER(widget)) {
+        gtk_container_forall(GTK_CONTAINER(widget), elm_gtk_backdrop_clear,
+                             NULL);
+    }
+}
+
+/* ************************************************************************** */
+/* Reload the theme after the images in the config file changed */
+void elm_gtk_theme_conf_changed(const char *group, void *data)
+{
+    elm_gtk_load_theme();
+}
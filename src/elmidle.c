@@ -0,0 +1,335 @@
+/* *****************************************************************************
+ * 
+ * Name:    elmidle.c
+ * Author:  Gabriel Gonzalez
+ * Email:   gabeg@bu.edu
+ * License: The MIT License (MIT)
+ * 
+ * Description: Put the greeter to sleep when nobody is using it.
+ *              
+ * Notes: The X server keeps an IDLETIME counter, the milliseconds since the
+ *        last input, as part of the SYNC extension. Rather than polling it, an
+ *        alarm is set on the counter and the X server sends an event once it
+ *        goes past the timeout. The same alarm is then set to go off when the
+ *        counter drops back down, which is the next key press or pointer
+ *        motion. The greeter does not wake up at all in between.
+ * 
+ *        Both alarms compare rather than wait for a transition, so input that
+ *        comes in before the alarm is set again still wakes the greeter.
+ * 
+ *        The number of times the main thread woke up and the resident memory
+ *        are logged when the greeter leaves each state.
+ * 
+ * *****************************************************************************
+ */
+
+/* Includes */
+#include "elmidle.h"
+#include "elmconf.h"
+#include "elmdef.h"
+#include "elmio.h"
+#include <glib.h>
+#include <stdio.h>
+#include <string.h>
+#include <X11/Xlib.h>
+#include <X11/extensions/dpms.h>
+#include <X11/extensions/sync.h>
+#include <gdk/gdk.h>
+#include <gdk/gdkx.h>
+
+/* Private functions */
+static int             elm_idle_arm(void);
+static void            elm_idle_set_state(int idle);
+static int             elm_idle_get_timeout(void);
+static int             elm_idle_use_dpms(void);
+static void            elm_idle_get_stats(long *wakeups, long *rss);
+static GdkFilterReturn elm_idle_event(GdkXEvent *xevent, GdkEvent *event,
+                                      gpointer data);
+static void            elm_idle_conf_changed(const char *group, void *data);
+
+/* Private variables */
+static Display        *IdleDisplay   = NULL;
+static XSyncCounter    IdleCounter   = None;
+static XSyncAlarm      IdleAlarm     = None;
+static int             IdleEventBase = 0;
+static int             IdleTimeout   = 0;
+static int             Idle          = 0;
+static int             Enabled       = 0;
+static ElmIdleChanged  IdleCallback  = NULL;
+static void           *IdleData      = NULL;
+static gint64          StateStart    = 0;
+static long            StateWakeups  = 0;
+
+/* ************************************************************************** */
+/* Watch for the greeter going idle. The callback is told each time it goes
+ * idle or wakes up, once enabled. */
+int elm_idle_init(ElmIdleChanged callback, void *data)
+{
+    elmprintf(LOGINFO, "Preparing to watch for idle time.");
+
+    XSyncSystemCounter *counters;
+    int                 errorbase;
+    int                 major;
+    int                 minor;
+    int                 n;
+    int                 i;
+
+    IdleDisplay  = gdk_x11_display_get_xdisplay(gdk_display_get_default());
+    IdleCallback = callback;
+    IdleData     = data;
+
+    if (!XSyncQueryExtension(IdleDisplay, &IdleEventBase, &errorbase)
+        || !XSyncInitialize(IdleDisplay, &major, &minor))
+    {
+        elmprintf(LOGWARN, "X server does not support the SYNC extension.");
+        return -1;
+    }
+
+    counters = XSyncListSystemCounters(IdleDisplay, &n);
+
+    for (i=0; i < n; i++) {
+        if (strcmp(counters[i].name, "IDLETIME") == 0) {
+            IdleCounter = counters[i].counter;
+            break;
+        }
+    }
+
+    if (counters) {
+        XSyncFreeSystemCounterList(counters);
+    }
+
+    if (IdleCounter == None) {
+        elmprintf(LOGWARN, "X server does not have an idle time counter.");
+        return -2;
+    }
+
+    IdleTimeout = elm_idle_get_timeout();
+
+    gdk_window_add_filter(NULL, elm_idle_event, NULL);
+    elm_conf_subscribe("Main", elm_idle_conf_changed, NULL);
+    elm_idle_get_stats(&StateWakeups, NULL);
+
+    StateStart = g_get_monotonic_time();
+
+    return 0;
+}
+
+/* ************************************************************************** */
+/* Watch for idle time only while the greeter is shown. Otherwise, the screen
+ * belongs to the session. */
+void elm_idle_set_enabled(int flag)
+{
+    if (IdleCounter == None) {
+        return;
+    }
+
+    Enabled = flag;
+
+    if (!Enabled && Idle) {
+        elm_idle_set_state(0);
+    }
+
+    elm_idle_arm();
+}
+
+/* ************************************************************************** */
+/* Check if the greeter is idle */
+int elm_idle_is_idle(void)
+{
+    return Idle;
+}
+
+/* ************************************************************************** */
+/* Set the alarm for going idle, or for waking up once idle. The alarm is
+ * removed when there is nothing to watch for. */
+int elm_idle_arm(void)
+{
+    XSyncAlarmAttributes attr;
+    unsigned long        flags = XSyncCACounter | XSyncCAValueType
+                                 | XSyncCAValue | XSyncCATestType
+                                 | XSyncCADelta | XSyncCAEvents;
+
+    if (!Enabled || (IdleTimeout <= 0)) {
+        if (IdleAlarm != None) {
+            XSyncDestroyAlarm(IdleDisplay, IdleAlarm);
+            XFlush(IdleDisplay);
+        }
+
+        IdleAlarm = None;
+
+        return 1;
+    }
+
+    memset(&attr, 0, sizeof(attr));
+
+    attr.trigger.counter    = IdleCounter;
+    attr.trigger.value_type = XSyncAbsolute;
+    attr.events             = True;
+
+    /* Fires once the idle time reaches the timeout, or once input resets it */
+    if (Idle) {
+        attr.trigger.test_type = XSyncNegativeComparison;
+        XSyncIntToValue(&attr.trigger.wait_value, IdleTimeout*1000 - 1);
+    }
+    else {
+        attr.trigger.test_type = XSyncPositiveComparison;
+        XSyncIntToValue(&attr.trigger.wait_value, IdleTimeout*1000);
+    }
+
+    XSyncIntToValue(&attr.delta, 0);
+
+    if (IdleAlarm == None) {
+        IdleAlarm = XSyncCreateAlarm(IdleDisplay, flags, &attr);
+    }
+    else {
+        XSyncChangeAlarm(IdleDisplay, IdleAlarm, flags, &attr);
+    }
+
+    XFlush(IdleDisplay);
+
+    return 0;
+}
+
+/* ************************************************************************** */
+/* Go idle or wake up. The screen is turned back on first, so that waking up
+ * is seen right away. */
+void elm_idle_set_state(int idle)
+{
+    gint64 now = g_get_monotonic_time();
+    double sec = (now-StateStart) / (double)G_USEC_PER_SEC;
+    long   wakeups;
+    long   rss;
+
+    if (idle == Idle) {
+        return;
+    }
+
+    elm_idle_get_stats(&wakeups, &rss);
+    elmprintf(LOGINFO, "Greeter was %s for %.1f s: %.2f wakeups/s, %ld kB.",
+              (Idle) ? "idle" : "active", sec,
+              (sec > 0) ? (wakeups-StateWakeups) / sec : 0.0, rss);
+
+    Idle = idle;
+
+    if (!Idle && elm_idle_use_dpms()) {
+        DPMSForceLevel(IdleDisplay, DPMSModeOn);
+    }
+
+    if (IdleCallback) {
+        IdleCallback(Idle, IdleData);
+    }
+
+    if (Idle && elm_idle_use_dpms()) {
+        DPMSForceLevel(IdleDisplay, DPMSModeOff);
+    }
+
+    XFlush(IdleDisplay);
+    elm_idle_get_stats(&StateWakeups, &rss);
+    elmprintf(LOGINFO, "Greeter is %s, %ld kB.", (Idle) ? "idle" : "active",
+              rss);
+
+    StateStart = g_get_monotonic_time();
+}
+
+/* ************************************************************************** */
+/* Return the seconds without input before the greeter goes idle. Zero turns
+ * idling off. */
+int elm_idle_get_timeout(void)
+{
+    int sec = elm_conf_read_int("Main", "IdleTimeout");
+
+    if (sec < 0) {
+        sec = 300;
+    }
+
+    return sec;
+}
+
+/* ************************************************************************** */
+/* Check if the screen should be blanked while idle */
+int elm_idle_use_dpms(void)
+{
+    int dummy;
+
+    if (elm_conf_read("Main", "IdleBlank")
+        && (elm_conf_read_bool("Main", "IdleBlank") <= 0))
+    {
+        return 0;
+    }
+
+    return DPMSQueryExtension(IdleDisplay, &dummy, &dummy)
+        && DPMSCapable(IdleDisplay);
+}
+
+/* ************************************************************************** */
+/* Read the number of times the main thread went to sleep and woke up, and the
+ * resident memory in kB */
+void elm_idle_get_stats(long *wakeups, long *rss)
+{
+    FILE *stream = fopen("/proc/self/status", "r");
+    char  line[ELM_MAX_LINE_SIZE];
+
+    if (wakeups) {
+        *wakeups = 0;
+    }
+
+    if (rss) {
+        *rss = 0;
+    }
+
+    if (!stream) {
+        return;
+    }
+
+    while (fgets(line, sizeof(line), stream)) {
+        if (rss) {
+            sscanf(line, "VmRSS: %ld", rss);
+        }
+
+        if (wakeups) {
+            sscanf(line, "voluntary_ctxt_switches: %ld", wakeups);
+        }
+    }
+
+    fclose(stream);
+}
+
+/* ************************************************************************** */
+/* Look for the idle alarm among the events of the display */
+GdkFilterReturn elm_idle_event(GdkXEvent *xevent, GdkEvent *event,
+                               gpointer data)
+{
+    XSyncAlarmNotifyEvent *ev = xevent;
+
+    if ((ev->type != IdleEventBase+XSyncAlarmNotify)
+        || (IdleAlarm == None) || (ev->alarm != IdleAlarm))
+    {
+        return GDK_FILTER_CONTINUE;
+    }
+
+    if (Enabled) {
+        elm_idle_set_state(!Idle);
+        elm_idle_arm();
+    }
+
+    return GDK_FILTER_REMOVE;
+}
+
+/* ************************************************************************** */
+/* Apply a new idle timeout */
+void elm_idle_conf_changed(const char *group, void *data)
+{
+    int timeout = elm_idle_get_timeout();
+
+    if (timeout == IdleTimeout) {
+        return;
+    }
+
+    IdleTimeout = timeout;
+
+    if ((IdleTimeout <= 0) && Idle) {
+        elm_idle_set_state(0);
+    }
+
+    elm_idle_arm();
+}
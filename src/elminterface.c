@@ -25,10 +25,10 @@
 ElmApp * login_interface(void)
 {
     static ElmApp apps[] = {
-        {display_datetime,      ELM_GRAV_BOTTOM_LEFT,  110,  175},
-        {display_login,         ELM_GRAV_CENTER,      -100, -120},
-        {display_power_buttons, ELM_GRAV_TOP_RIGHT,    45,   10},
-        {0,                     ELM_GRAV_NONE,         0,    0}
+        {display_datetime,      ELM_GRAV_BOTTOM_LEFT,  110,  175, reset_datetime},
+        {display_login,         ELM_GRAV_CENTER,      -100, -120, reset_login},
+        {display_power_buttons, ELM_GRAV_TOP_RIGHT,    45,   10,  NULL},
+        {0,                     ELM_GRAV_NONE,         0,    0,   NULL}
     };
 
     return apps;
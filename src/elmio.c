@@ -7,7 +7,33 @@
  * 
  * Description: ELM input/output utilities.
  *              
- * Notes: None.
+ * Notes: Messages below the print level are discarded by elmprintf() before
+ *        any of their arguments are evaluated. Debug messages are not compiled
+ *        in at all when building with NDEBUG.
+ * 
+ *        Messages are formatted by the calling thread, into its own stack
+ *        buffers, and pushed onto a lock-free ring. A dedicated writer thread
+ *        drains the ring and does all of the blocking I/O, so printing never
+ *        waits on a lock or a disk. When the ring is full the message is
+ *        dropped and counted instead.
+ * 
+ *        The ring is a bounded multi-producer, single-consumer queue. Each slot
+ *        carries a sequence number: a producer claims a slot by advancing the
+ *        head with a compare-and-swap, fills it, then publishes it by bumping
+ *        the slot sequence. The writer consumes slots in order and hands them
+ *        back by bumping the sequence one lap ahead.
+ * 
+ *        The log file is opened once, in append mode, and written through a
+ *        buffer that only ever holds whole lines. The buffer is written out
+ *        each time the ring has been drained, and at exit. The file is
+ *        reopened after a SIGHUP or when it has been rotated away.
+ * 
+ *        A forked child has no writer thread, so it writes its messages
+ *        directly.
+ * 
+ *        Log messages go to the log file, to the journal, or to both. Journal
+ *        entries carry the source location of the message and the current
+ *        phase, user, and session pid as fields.
  * 
  * *****************************************************************************
  */
@@ -16,157 +42,842 @@
 #include "elmio.h"
 #include "elmdef.h"
 #include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
 #include <stdarg.h>
+#include <stdatomic.h>
+#include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <time.h>
+#include <unistd.h>
+#include <syslog.h>
+#include <sys/eventfd.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <systemd/sd-journal.h>
+
+/* Typedefs */
+typedef struct
+{
+    const char *phase;
+    pid_t       pid;
+    char        user[ELM_MAX_CRED_SIZE];
+} ElmIoContext;
+
+typedef struct
+{
+    atomic_size_t  sequence;
+    ElmPrint       mode;
+    const char    *file;
+    int            line;
+    const char    *func;
+    ElmIoContext   context;
+    size_t         offset;
+    size_t         length;
+    char           text[ELM_MAX_LOG_LINE_SIZE];
+} ElmIoRecord;
 
 /* Private functions */
-static void   elm_io_info(char *preamble, va_list ap);
-static void   elm_io_warn(char *preamble, va_list ap);
-static void   elm_io_err(char *preamble, va_list ap);
-static void   elm_io_log(char *preamble, va_list ap);
-static char * elm_io_get_preamble(ElmPrint mode, const char *vafmt);
-static char * elm_io_get_time(void);
+static void   elm_io_start(void);
+static int    elm_io_push(const ElmIoRecord *header, const char *preamble,
+                          va_list ap);
+static void   elm_io_direct(ElmIoRecord *record, const char *preamble,
+                            va_list ap);
+static void   elm_io_format(ElmIoRecord *record, const char *preamble,
+                            va_list ap);
+static void * elm_io_writer(void *data);
+static int    elm_io_drain(void);
+static void   elm_io_drain_dropped(void);
+static void   elm_io_wake(void);
+static void   elm_io_stop(void);
+static void   elm_io_fork_child(void);
+static void   elm_io_write(const ElmIoRecord *record);
+static void   elm_io_journal(const ElmIoRecord *record);
+static void   elm_io_get_context(ElmIoContext *context);
+static void   elm_io_set_context(const char *phase, const char *user, pid_t pid);
+static void   elm_io_write_fd(int fd, const char *text, size_t length);
+static int    elm_io_log_open(void);
+static void   elm_io_log_flush(void);
+static int    elm_io_log_is_rotated(void);
+static size_t elm_io_get_preamble(ElmPrint mode, const char *vafmt, char *buf,
+                                  size_t size);
+static void   elm_io_get_time(char *buf, size_t size);
 static int    elm_io_is_mode_info(ElmPrint mode);
 static int    elm_io_is_mode_warn(ElmPrint mode);
 static int    elm_io_is_mode_err(ElmPrint mode);
+static int    elm_io_is_mode_debug(ElmPrint mode);
 static int    elm_io_is_mode_log(ElmPrint mode);
 static int    elm_io_is_mode_errno(ElmPrint mode);
-static char * elm_io_mode_to_string(ElmPrint mode);
+static const char * elm_io_mode_to_string(ElmPrint mode);
 
 /* Private variables */
 static int      Verbose      = 0;
+static ElmLevel BaseLevel    = ELM_LEVEL_INFO;
+static ElmLevel Level        = ELM_LEVEL_INFO;
 static uint32_t InfoMask     = 0x3;
 static uint32_t WarnMask     = 0xc;
 static uint32_t ErrorMask    = 0x30;
-static uint32_t LogThreshold = 0x40;
+static uint32_t DebugMask    = 0x3000;
 static uint32_t LogIMask     = 0xc0;
 static uint32_t LogWMask     = 0x300;
 static uint32_t LogEMask     = 0xc00;
+static uint32_t LogDMask     = 0xc000;
+static int      Backend      = ELM_LOG_FILE;
+
+static ElmIoRecord           Ring[ELM_LOG_RING_SIZE];
+static atomic_size_t         Head      = 0;
+static size_t                Tail      = 0;
+static atomic_uint           Dropped   = 0;
+static unsigned int          Reported  = 0;
+static atomic_int            Sleeping  = 0;
+static atomic_int            Stopping  = 0;
+static int                   Direct    = 0;
+static int                   WakeFd    = -1;
+static pthread_t             Writer;
+static pthread_once_t        Once      = PTHREAD_ONCE_INIT;
+
+static int                   LogFd     = -1;
+static int                   LogFailed = 0;
+static dev_t                 LogDev    = 0;
+static ino_t                 LogIno    = 0;
+static char                  LogBuf[ELM_MAX_LOG_BUF_SIZE];
+static size_t                LogLength = 0;
+static volatile sig_atomic_t LogReopen = 0;
+
+static ElmIoContext          Context;
+static const ElmIoContext    NoContext   = {0};
+static atomic_uint           ContextSeq  = 0;
+static pthread_mutex_t       ContextLock = PTHREAD_MUTEX_INITIALIZER;
 
 /* ************************************************************************** */
-/* Print wrapper */
-void elmprintf(ElmPrint mode, const char *vafmt, ...)
+/* Print wrapper. Called through elmprintf(), which has already checked that
+ * the level of the message is enabled. */
+void elm_io_printf(ElmPrint mode, const char *file, int line,
+                   const char *func, const char *vafmt, ...)
 {
-    /* Call appropriate printing function */
-    char    *preamble = elm_io_get_preamble(mode, vafmt);
-    va_list  ap;
-    va_list  aq;
+    ElmIoRecord record;
+    char        preamble[ELM_MAX_MSG_SIZE];
+    int         errnum = errno;
+    va_list     ap;
+
+    pthread_once(&Once, elm_io_start);
+
+    record.mode = mode;
+    record.file = file;
+    record.line = line;
+    record.func = func;
+
+    if (Backend & ELM_LOG_JOURNAL) {
+        elm_io_get_context(&record.context);
+    }
+    else {
+        record.context = NoContext;
+    }
+
+    /* Build the format string, then restore errno for its '%m' */
+    record.offset = elm_io_get_preamble(mode, vafmt, preamble,
+                                        sizeof(preamble));
+
+    errno = errnum;
 
     va_start(ap, vafmt);
-    va_copy(aq, ap);
 
-    /* Print to stdout/stderr */
-    if (elm_io_is_mode_info(mode)) {
-        elm_io_info(preamble, ap);
+    if (Direct) {
+        elm_io_direct(&record, preamble, ap);
     }
-    else if (elm_io_is_mode_warn(mode)) {
-        elm_io_warn(preamble, ap);
+    else {
+        elm_io_push(&record, preamble, ap);
     }
-    else if (elm_io_is_mode_err(mode)) {
-        elm_io_err(preamble, ap);
+
+    va_end(ap);
+
+    errno = errnum;
+}
+
+/* ************************************************************************** */
+/* Check if messages of the given level are printed */
+int elm_io_is_enabled(ElmLevel level)
+{
+    return (level >= Level);
+}
+
+/* ************************************************************************** */
+/* Set verbosity. Each count lowers the print level by one. */
+void elm_io_set_verbose(int count)
+{
+    Verbose = count;
+    Level   = (BaseLevel > Verbose) ? (BaseLevel - Verbose) : ELM_LEVEL_DEBUG;
+}
+
+/* ************************************************************************** */
+/* Set the print level that verbosity is counted down from */
+void elm_io_set_level(ElmLevel level)
+{
+    BaseLevel = level;
+
+    elm_io_set_verbose(Verbose);
+}
+
+/* ************************************************************************** */
+/* Convert a level name to a level. Unknown names are the default level. */
+ElmLevel elm_io_level_from_string(const char *string)
+{
+    if (!string) {
+        return ELM_LEVEL_INFO;
+    }
+    else if (strcasecmp(string, "debug") == 0) {
+        return ELM_LEVEL_DEBUG;
+    }
+    else if (strcasecmp(string, "warn") == 0) {
+        return ELM_LEVEL_WARN;
+    }
+    else if (strcasecmp(string, "error") == 0) {
+        return ELM_LEVEL_ERROR;
     }
     else {
+        return ELM_LEVEL_INFO;
     }
+}
 
-    /* Print to log */
-    if (elm_io_is_mode_log(mode)) {
-        elm_io_log(preamble, aq);
+/* ************************************************************************** */
+/* Select where log messages are written */
+void elm_io_set_backend(int backend)
+{
+    Backend = backend;
+}
+
+/* ************************************************************************** */
+/* Return where log messages are written */
+int elm_io_get_backend(void)
+{
+    return Backend;
+}
+
+/* ************************************************************************** */
+/* Convert a backend name to a backend. Unknown names are the log file. */
+int elm_io_backend_from_string(const char *string)
+{
+    if (!string) {
+        return ELM_LOG_FILE;
+    }
+    else if (strcasecmp(string, "journal") == 0) {
+        return ELM_LOG_JOURNAL;
+    }
+    else if (strcasecmp(string, "both") == 0) {
+        return (ELM_LOG_FILE | ELM_LOG_JOURNAL);
+    }
+    else {
+        return ELM_LOG_FILE;
     }
+}
 
-    va_end(aq);
-    va_end(ap);
+/* ************************************************************************** */
+/* Set the phase that the login manager is in. The string must outlive the
+ * program, as records only keep a pointer to it. */
+void elm_io_set_phase(const char *phase)
+{
+    elm_io_set_context(phase, NULL, -1);
+}
+
+/* ************************************************************************** */
+/* Set the user that is logging in, or NULL once there is none */
+void elm_io_set_user(const char *user)
+{
+    elm_io_set_context(NULL, (user) ? user : "", -1);
 }
 
 /* ************************************************************************** */
-/* Print informational messages to stdout */
-void elm_io_info(char *preamble, va_list ap)
+/* Set the pid of the running user session, or 0 once there is none */
+void elm_io_set_session_pid(pid_t pid)
 {
-    vfprintf(stdout, preamble, ap);
+    elm_io_set_context(NULL, NULL, pid);
 }
 
 /* ************************************************************************** */
-/* Print warning messages to stdout */
-void elm_io_warn(char *preamble, va_list ap)
+/* Reopen the log file before the next write. This only sets a flag, so it is
+ * safe to call from a signal handler. */
+void elm_io_reopen(void)
 {
-    vfprintf(stdout, preamble, ap);
+    LogReopen = 1;
 }
 
 /* ************************************************************************** */
-/* Print error messages to stderr */
-void elm_io_err(char *preamble, va_list ap)
+/* Return the number of messages dropped because the ring was full */
+unsigned int elm_io_get_dropped(void)
 {
-    vfprintf(stderr, preamble, ap);
+    return atomic_load(&Dropped);
 }
 
 /* ************************************************************************** */
-/* Print messages for logging to log */
-void elm_io_log(char *preamble, va_list ap)
+/* Prepare the ring and start the writer thread. Messages are written directly
+ * if the thread cannot be started. */
+void elm_io_start(void)
 {
-    FILE *stream = fopen(ELM_LOG, "a+");
-    vfprintf(stream, preamble, ap);
-    fclose(stream);
+    size_t i;
+
+    for (i=0; i < ELM_LOG_RING_SIZE; i++) {
+        atomic_init(&Ring[i].sequence, i);
+    }
+
+    pthread_atfork(NULL, NULL, elm_io_fork_child);
+    atexit(elm_io_stop);
+
+    if ((WakeFd=eventfd(0, EFD_CLOEXEC)) < 0) {
+        Direct = 1;
+        return;
+    }
+
+    if (pthread_create(&Writer, NULL, elm_io_writer, NULL) != 0) {
+        close(WakeFd);
+        WakeFd = -1;
+        Direct = 1;
+    }
+}
+
+/* ************************************************************************** */
+/* Format a message into a free slot of the ring and publish it to the writer
+ * thread */
+int elm_io_push(const ElmIoRecord *header, const char *preamble, va_list ap)
+{
+    ElmIoRecord *slot;
+    size_t       pos = atomic_load_explicit(&Head, memory_order_relaxed);
+    size_t       seq;
+    intptr_t     diff;
+
+    /* Claim a slot */
+    while (1)
+    {
+        slot = &Ring[pos % ELM_LOG_RING_SIZE];
+        seq  = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        diff = (intptr_t)seq - (intptr_t)pos;
+
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&Head, &pos, pos+1,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed))
+            {
+                break;
+            }
+        }
+        else if (diff < 0) {
+            atomic_fetch_add_explicit(&Dropped, 1, memory_order_relaxed);
+            return -1;
+        }
+        else {
+            pos = atomic_load_explicit(&Head, memory_order_relaxed);
+        }
+    }
+
+    /* Fill and publish the slot */
+    slot->mode    = header->mode;
+    slot->file    = header->file;
+    slot->line    = header->line;
+    slot->func    = header->func;
+    slot->context = header->context;
+    slot->offset  = header->offset;
+
+    elm_io_format(slot, preamble, ap);
+    atomic_store_explicit(&slot->sequence, pos+1, memory_order_release);
+    elm_io_wake();
+
+    return 0;
 }
 
 /* ************************************************************************** */
-/* Set verbose flag */
-void elm_io_set_verbose(int flag)
+/* Format and write a message on the calling thread */
+void elm_io_direct(ElmIoRecord *record, const char *preamble, va_list ap)
 {
-    Verbose = flag;
+    elm_io_format(record, preamble, ap);
+    elm_io_write(record);
+    elm_io_log_flush();
 }
 
 /* ************************************************************************** */
-/* Return the preamble of the print statement */
-char * elm_io_get_preamble(ElmPrint mode, const char *vafmt)
+/* Format the text of a record. Text that does not fit is cut short, but still
+ * ends in a newline. */
+void elm_io_format(ElmIoRecord *record, const char *preamble, va_list ap)
 {
-    static char preamble[ELM_MAX_MSG_SIZE];
-    int         available = sizeof(preamble);
-    int         length;
+    int length = vsnprintf(record->text, sizeof(record->text), preamble, ap);
+
+    if (length < 0) {
+        length = 0;
+    }
+    else if ((size_t)length >= sizeof(record->text)) {
+        length                 = sizeof(record->text)-1;
+        record->text[length-1] = '\n';
+    }
+
+    record->length = length;
+
+    if (record->offset > record->length) {
+        record->offset = record->length;
+    }
+}
+
+/* ************************************************************************** */
+/* Drain the ring until asked to stop. The thread sleeps on an eventfd when
+ * there is nothing to write. */
+void * elm_io_writer(void *data)
+{
+    sigset_t set;
+    uint64_t count;
+    int      stopping;
+
+    /* Signals are handled by the main thread */
+    sigfillset(&set);
+    pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+    while (1)
+    {
+        stopping = atomic_load(&Stopping);
+
+        while (elm_io_drain() > 0) {}
+
+        elm_io_drain_dropped();
+        elm_io_log_flush();
+
+        if (stopping) {
+            break;
+        }
 
-    /* Default preamble (excluding trailing newline) */
-    snprintf(preamble, available, "[%s] %s %s",
-             elm_io_get_time(), elm_io_mode_to_string(mode), vafmt);
+        /* Announce that the writer is going to sleep, then look again so that a
+         * message published in between is not missed */
+        atomic_store(&Sleeping, 1);
+        atomic_thread_fence(memory_order_seq_cst);
 
-    length     = strlen(preamble)+1;
-    available -= (length+1);
+        if (elm_io_drain() > 0) {
+            atomic_store(&Sleeping, 0);
+            continue;
+        }
 
-    /* Add errno message to string */
-    if (elm_io_is_mode_errno(mode)) {
-        char   *errmsg = strerror(errno);
-        size_t  errlen = strlen(errmsg)+4;
+        while ((read(WakeFd, &count, sizeof(count)) < 0) && (errno == EINTR)) {}
 
-        if (available >= errlen) {
-            strncat(preamble, ": ", 2);
-            strncat(preamble, errmsg, errlen-1);
-            strncat(preamble, ".", 1);
+        atomic_store(&Sleeping, 0);
+    }
 
-            available -= errlen;
+    return NULL;
+}
+
+/* ************************************************************************** */
+/* Write out the published messages in the ring. Return how many were
+ * written. */
+int elm_io_drain(void)
+{
+    ElmIoRecord *slot;
+    size_t       seq;
+    int          count = 0;
+
+    while (1)
+    {
+        slot = &Ring[Tail % ELM_LOG_RING_SIZE];
+        seq  = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+
+        if (seq != Tail+1) {
+            break;
         }
+
+        elm_io_write(slot);
+        atomic_store_explicit(&slot->sequence, Tail+ELM_LOG_RING_SIZE,
+                              memory_order_release);
+
+        Tail++;
+        count++;
+    }
+
+    return count;
+}
+
+/* ************************************************************************** */
+/* Report messages that were dropped since the last report */
+void elm_io_drain_dropped(void)
+{
+    unsigned int dropped = atomic_load(&Dropped);
+    ElmIoRecord  record  = {0};
+    char         preamble[ELM_MAX_MSG_SIZE];
+    int          length;
+
+    if (dropped == Reported) {
+        return;
     }
 
-    /* Add newline */
-    if (available > 0) {
-        strncat(preamble, "\n", 1);
+    record.mode   = LOGWARN;
+    record.file   = __FILE__;
+    record.line   = __LINE__;
+    record.func   = __func__;
+    record.offset = elm_io_get_preamble(LOGWARN,
+                                        "%u log message(s) dropped: ring is full.",
+                                        preamble, sizeof(preamble));
+
+    length   = snprintf(record.text, sizeof(record.text), preamble,
+                        dropped-Reported);
+    Reported = dropped;
+
+    if (length > 0) {
+        record.length = ((size_t)length < sizeof(record.text))
+                        ? (size_t)length : sizeof(record.text)-1;
+
+        elm_io_write(&record);
     }
+}
 
-    return preamble;
+/* ************************************************************************** */
+/* Wake the writer thread, if it is asleep */
+void elm_io_wake(void)
+{
+    uint64_t one = 1;
+
+    atomic_thread_fence(memory_order_seq_cst);
+
+    if (atomic_load(&Sleeping)) {
+        if (write(WakeFd, &one, sizeof(one)) < 0) {
+        }
+    }
 }
 
 /* ************************************************************************** */
-/* Return current time string */
-char * elm_io_get_time(void)
+/* Stop the writer thread once everything in the ring has been written */
+void elm_io_stop(void)
 {
-    static const char *fmt     = "%Y-%m-%d %I:%M:%S %p";
-    time_t             now     = time(0);
-    struct tm         *tstruct = localtime(&now);
-    static char        buf[128];
+    uint64_t one = 1;
+
+    if (Direct) {
+        elm_io_log_flush();
+        return;
+    }
+
+    if (pthread_equal(pthread_self(), Writer)) {
+        return;
+    }
+
+    atomic_store(&Stopping, 1);
+
+    if (write(WakeFd, &one, sizeof(one)) < 0) {
+    }
 
-    memset(&buf, 0, sizeof(buf));
-    strftime(buf, sizeof(buf), fmt, tstruct);
+    pthread_join(Writer, NULL);
 
-    return buf;
+    Direct = 1;
+}
+
+/* ************************************************************************** */
+/* The writer thread does not exist in a forked child. Switch the child to
+ * direct writes and drop the parent's buffered output, which the parent still
+ * writes itself. */
+void elm_io_fork_child(void)
+{
+    Direct    = 1;
+    LogLength = 0;
+}
+
+/* ************************************************************************** */
+/* Write a message to stdout/stderr, append it to the log buffer, and send it
+ * to the journal */
+void elm_io_write(const ElmIoRecord *record)
+{
+    ElmPrint    mode   = record->mode;
+    const char *text   = record->text;
+    size_t      length = record->length;
+
+    /* Print to stdout/stderr */
+    if (elm_io_is_mode_info(mode) || elm_io_is_mode_warn(mode)
+        || elm_io_is_mode_debug(mode))
+    {
+        fwrite(text, 1, length, stdout);
+    }
+    else if (elm_io_is_mode_err(mode)) {
+        fwrite(text, 1, length, stderr);
+    }
+    else {
+    }
+
+    /* Print to log */
+    if (!elm_io_is_mode_log(mode)) {
+        return;
+    }
+
+    if (Backend & ELM_LOG_JOURNAL) {
+        elm_io_journal(record);
+    }
+
+    if (!(Backend & ELM_LOG_FILE)) {
+        return;
+    }
+
+    if ((LogLength + length) > sizeof(LogBuf)) {
+        elm_io_log_flush();
+    }
+
+    memcpy(LogBuf+LogLength, text, length);
+    LogLength += length;
+}
+
+/* ************************************************************************** */
+/* Send a message to the journal, with its source location and login manager
+ * context as fields. The journal stamps the time itself, so the message is
+ * sent without its preamble. */
+void elm_io_journal(const ElmIoRecord *record)
+{
+    const ElmIoContext *context = &record->context;
+    struct iovec        iov[9];
+    char                message[ELM_MAX_LOG_LINE_SIZE+16];
+    char                fields[8][ELM_MAX_PATH_SIZE];
+    size_t              length  = record->length - record->offset;
+    int                 count   = 0;
+    int                 priority;
+    int                 i;
+
+    /* Trailing newline */
+    if ((length > 0) && (record->text[record->offset+length-1] == '\n')) {
+        length--;
+    }
+
+    switch (ELM_IO_LEVEL(record->mode))
+    {
+    case ELM_LEVEL_DEBUG:
+        priority = LOG_DEBUG;
+        break;
+    case ELM_LEVEL_INFO:
+        priority = LOG_INFO;
+        break;
+    case ELM_LEVEL_WARN:
+        priority = LOG_WARNING;
+        break;
+    default:
+        priority = LOG_ERR;
+        break;
+    }
+
+    snprintf(message, sizeof(message), "MESSAGE=%.*s",
+             (int)length, record->text+record->offset);
+
+    snprintf(fields[count++], sizeof(fields[0]), "PRIORITY=%d", priority);
+    snprintf(fields[count++], sizeof(fields[0]), "SYSLOG_IDENTIFIER=%s", PROGRAM);
+    snprintf(fields[count++], sizeof(fields[0]), "CODE_FILE=%s", record->file);
+    snprintf(fields[count++], sizeof(fields[0]), "CODE_LINE=%d", record->line);
+    snprintf(fields[count++], sizeof(fields[0]), "CODE_FUNC=%s", record->func);
+
+    /* Context fields are only sent when they are known */
+    if (context->phase) {
+        snprintf(fields[count++], sizeof(fields[0]), "ELM_PHASE=%s",
+                 context->phase);
+    }
+
+    if (context->user[0]) {
+        snprintf(fields[count++], sizeof(fields[0]), "ELM_USER=%s",
+                 context->user);
+    }
+
+    if (context->pid > 0) {
+        snprintf(fields[count++], sizeof(fields[0]), "ELM_SESSION_PID=%d",
+                 context->pid);
+    }
+
+    iov[0].iov_base = message;
+    iov[0].iov_len  = strlen(message);
+
+    for (i=0; i < count; i++) {
+        iov[i+1].iov_base = fields[i];
+        iov[i+1].iov_len  = strlen(fields[i]);
+    }
+
+    sd_journal_sendv(iov, count+1);
+}
+
+/* ************************************************************************** */
+/* Copy the login manager context. The context is guarded by a sequence count
+ * that is odd while it is being changed, so a reader never waits on a writer,
+ * it only retries. */
+void elm_io_get_context(ElmIoContext *context)
+{
+    unsigned int seq;
+
+    while (1)
+    {
+        seq = atomic_load_explicit(&ContextSeq, memory_order_acquire);
+
+        if (seq & 1) {
+            continue;
+        }
+
+        memcpy(context, &Context, sizeof(*context));
+        atomic_thread_fence(memory_order_acquire);
+
+        if (atomic_load_explicit(&ContextSeq, memory_order_relaxed) == seq) {
+            break;
+        }
+    }
+}
+
+/* ************************************************************************** */
+/* Change the login manager context. Fields that are NULL, or a negative pid,
+ * are left as they are. */
+void elm_io_set_context(const char *phase, const char *user, pid_t pid)
+{
+    pthread_mutex_lock(&ContextLock);
+    atomic_fetch_add_explicit(&ContextSeq, 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    if (phase) {
+        Context.phase = phase;
+    }
+
+    if (user) {
+        snprintf(Context.user, sizeof(Context.user), "%s", user);
+    }
+
+    if (pid >= 0) {
+        Context.pid = pid;
+    }
+
+    atomic_fetch_add_explicit(&ContextSeq, 1, memory_order_release);
+    pthread_mutex_unlock(&ContextLock);
+}
+
+/* ************************************************************************** */
+/* Write a buffer completely to a file descriptor */
+void elm_io_write_fd(int fd, const char *text, size_t length)
+{
+    size_t  written = 0;
+    ssize_t nbytes;
+
+    while (written < length)
+    {
+        if ((nbytes=write(fd, text+written, length-written)) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            break;
+        }
+
+        written += nbytes;
+    }
+}
+
+/* ************************************************************************** */
+/* Open the log file, replacing a previously opened one */
+int elm_io_log_open(void)
+{
+    struct stat info;
+    int         fd;
+
+    LogReopen = 0;
+
+    if ((fd=open(ELM_LOG, (O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC), 0644)) < 0)
+    {
+        LogFailed = 1;
+        return -1;
+    }
+
+    if (LogFd >= 0) {
+        close(LogFd);
+    }
+
+    LogFd     = fd;
+    LogFailed = 0;
+
+    if (fstat(LogFd, &info) == 0) {
+        LogDev = info.st_dev;
+        LogIno = info.st_ino;
+    }
+
+    return 0;
+}
+
+/* ************************************************************************** */
+/* Write buffered messages to stdout and to the log file */
+void elm_io_log_flush(void)
+{
+    fflush(stdout);
+
+    if (!LogLength) {
+        return;
+    }
+
+    /* Open the log file on first use, after a SIGHUP, or when it was rotated
+     * since the last write. A file that failed to open is only retried after a
+     * SIGHUP. */
+    if (LogReopen
+        || ((LogFd < 0) && !LogFailed)
+        || ((LogFd >= 0) && elm_io_log_is_rotated()))
+    {
+        elm_io_log_open();
+    }
+
+    if (LogFd >= 0) {
+        elm_io_write_fd(LogFd, LogBuf, LogLength);
+    }
+
+    LogLength = 0;
+}
+
+/* ************************************************************************** */
+/* Check if the open log file is no longer the one at the log path */
+int elm_io_log_is_rotated(void)
+{
+    struct stat info;
+
+    if (stat(ELM_LOG, &info) < 0) {
+        return 1;
+    }
+
+    return ((info.st_dev != LogDev) || (info.st_ino != LogIno));
+}
+
+/* ************************************************************************** */
+/* Write the format string of a message, with its preamble, into a buffer.
+ * Return where the message itself starts. */
+size_t elm_io_get_preamble(ElmPrint mode, const char *vafmt, char *buf,
+                           size_t size)
+{
+    char        timestamp[64];
+    const char *string = elm_io_mode_to_string(mode);
+    const char *errmsg = (elm_io_is_mode_errno(mode)) ? ": %m." : "";
+    int         offset;
+
+    elm_io_get_time(timestamp, sizeof(timestamp));
+
+    offset = snprintf(buf, size, "[%s] %s ", timestamp, string);
+
+    snprintf(buf+offset, size-offset, "%s%s\n", vafmt, errmsg);
+
+    return offset;
+}
+
+/* ************************************************************************** */
+/* Write the current time string into a buffer. Each thread keeps the string
+ * until the wall clock second it shows is over, which is measured on the
+ * monotonic clock so that only one clock is read per message. */
+void elm_io_get_time(char *buf, size_t size)
+{
+    static const char      *fmt = "%Y-%m-%d %I:%M:%S %p";
+    static __thread char    cache[64];
+    static __thread int64_t expires = 0;
+    struct timespec         mono;
+    struct timespec         real;
+    struct tm               tstruct;
+    int64_t                 now;
+
+    clock_gettime(CLOCK_MONOTONIC, &mono);
+
+    now = ((int64_t)mono.tv_sec * 1000000000) + mono.tv_nsec;
+
+    if (now >= expires) {
+        clock_gettime(CLOCK_REALTIME, &real);
+        localtime_r(&real.tv_sec, &tstruct);
+
+        if (!strftime(cache, sizeof(cache), fmt, &tstruct)) {
+            cache[0] = '\0';
+        }
+
+        expires = now + (1000000000 - real.tv_nsec);
+    }
+
+    snprintf(buf, size, "%s", cache);
 }
 
 /* ************************************************************************** */
@@ -190,11 +901,19 @@ int elm_io_is_mode_err(ElmPrint mode)
     return ((mode & ErrorMask) || (mode & LogEMask));
 }
 
+/* ************************************************************************** */
+/* Check if DEBUG mode */
+int elm_io_is_mode_debug(ElmPrint mode)
+{
+    return ((mode & DebugMask) || (mode & LogDMask));
+}
+
 /* ************************************************************************** */
 /* Check if LOG mode */
 int elm_io_is_mode_log(ElmPrint mode)
 {
-    return (mode > LogThreshold);
+    return ((mode & LogIMask) || (mode & LogWMask) || (mode & LogEMask)
+            || (mode & LogDMask));
 }
 
 /* ************************************************************************** */
@@ -206,32 +925,28 @@ int elm_io_is_mode_errno(ElmPrint mode)
             || (mode == ERRNO)    \
             || (mode == LOGINFNO)  \
             || (mode == LOGWARNO) \
-            || (mode == LOGERRNO));
+            || (mode == LOGERRNO) \
+            || (mode == DEBUGNO)  \
+            || (mode == LOGDBGNO));
 }
 
 /* ************************************************************************** */
 /* Convert print mode to string */
-char * elm_io_mode_to_string(ElmPrint mode)
+const char * elm_io_mode_to_string(ElmPrint mode)
 {
-    static char str[10];
-
-    memset(str, 0, sizeof(str));
-
     if (elm_io_is_mode_info(mode)) {
-        strncpy(str, "INFO ", 6);
+        return "INFO ";
     }
     else if (elm_io_is_mode_warn(mode)) {
-        strncpy(str, "WARN ", 6);
+        return "WARN ";
     }
     else if (elm_io_is_mode_err(mode)) {
-        strncpy(str, "ERROR", 6);
+        return "ERROR";
+    }
+    else if (elm_io_is_mode_debug(mode)) {
+        return "DEBUG";
     }
     else {
         return "";
     }
-
-    size_t len = strlen(str);
-    str[(len >= 10) ? 9 : len] = '\0';
-
-    return str;
 }
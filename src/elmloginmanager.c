@@ -14,12 +14,21 @@
 
 /* Includes */
 #include "elmloginmanager.h"
+#include "elmbackground.h"
+#include "elmclock.h"
+#include "elmconf.h"
 #include "elmdef.h"
 #include "elmgtk.h"
+#include "elmidle.h"
 #include "elminterface.h"
 #include "elmio.h"
+#include "elmplugin.h"
+#include "elmpreload.h"
 #include "elmsession.h"
+#include "elmsupervisor.h"
+#include "elmtrace.h"
 #include "elmx.h"
+#include <malloc.h>
 #include <pthread.h>
 #include <signal.h>
 #include <stdlib.h>
@@ -37,18 +46,39 @@ static void * elm_login_manager_login_session(void *data);
 static int    elm_login_manager_preview_login(void);
 static int    elm_login_manager_build_window(void);
 static int    elm_login_manager_build_apps(void);
+static void   elm_login_manager_add_app(const ElmApp *app, void *data);
+static void   elm_login_manager_get_position(const ElmApp *app, int width,
+                                             int height, int *x, int *y);
+static void   elm_login_manager_idle_changed(int idle, void *data);
+static void   elm_login_manager_screen_changed(int width, int height,
+                                               void *data);
 static int    elm_login_manager_setup_dir(void);
 static int    elm_login_manager_setup_xserver(void);
 static int    elm_login_manager_setup_signal_catcher(void);
-static void   elm_login_manager_signal_catcher(int sig, siginfo_t *info,
-                                               void *context);
+static void   elm_login_manager_signal_catcher(const struct signalfd_siginfo *info);
+static void   elm_login_manager_signal_reopen(const struct signalfd_siginfo *info);
+static void   elm_login_manager_session_exited(pid_t pid, int status,
+                                               const struct rusage *usage,
+                                               void *data);
 static int    elm_login_manager_show_apps(void);
 static int    elm_login_manager_hide_apps(void);
+static int    elm_login_manager_reset_apps(void);
+static gboolean elm_login_manager_show_greeter(gpointer data);
+static gboolean elm_login_manager_hide_greeter(gpointer data);
 static void   elm_login_manager_set_preview_mode(int flag);
 static void   elm_login_manager_thread(GtkWidget *widget, gpointer data);
 static int    elm_login_manager_alloc(void);
 static int    elm_login_manager_alloc_apps(size_t s);
 static int    elm_login_manager_exists(char *message);
+static void   elm_login_manager_conf_changed(const char *group, void *data);
+static int    elm_login_manager_set_background(void);
+static void   elm_login_manager_set_logging(const char *group, void *data);
+static gboolean elm_login_manager_load_plugins(GtkWidget *widget, cairo_t *cr,
+                                               gpointer data);
+static gboolean elm_login_manager_first_frame(GtkWidget *widget, cairo_t *cr,
+                                              gpointer data);
+static gboolean elm_login_manager_greeter_ready(GtkWidget *widget, cairo_t *cr,
+                                                gpointer data);
 
 /* Private globals */
 static int               Preview   = 0;
@@ -56,7 +86,12 @@ static ElmLoginManager  *Manager   = NULL;
 static GtkWidget        *Window    = NULL;
 static GtkWidget        *Container = NULL;
 static GtkWidget       **Widgets   = NULL;
+static ElmApp           *Apps      = NULL;
+static size_t            NumApps   = 0;
 static pthread_t         Thread;
+static int64_t           FrameStart = 0;
+static int64_t           GreetStart = 0;
+static int64_t           GreetTrace = 0;
 
 /* ************************************************************************** */
 /* Create Extensible Login Manager base structure */
@@ -83,6 +118,7 @@ ElmLoginManager * elm_login_manager_new(void)
     Manager->setup_signal_catcher = &elm_login_manager_setup_signal_catcher;
     Manager->show_apps            = &elm_login_manager_show_apps;
     Manager->hide_apps            = &elm_login_manager_hide_apps;
+    Manager->reset_apps           = &elm_login_manager_reset_apps;
     Manager->set_preview_mode     = &elm_login_manager_set_preview_mode;
 
     return Manager;
@@ -98,19 +134,37 @@ int elm_login_manager_run(void)
         return ELM_EXIT_MNGR_RUN;
     }
 
+    elm_io_set_phase("startup");
+    elm_login_manager_set_logging("Main", NULL);
+    elm_conf_subscribe("Main", elm_login_manager_set_logging, NULL);
+
     /* Setup */
+    int64_t start = elm_trace_begin();
+
     if (Manager->setup_dir() < 0) {
         return ELM_EXIT_MNGR_DIR;
     }
 
+    elm_trace_end("setup_dir", start);
+    start = elm_trace_begin();
+
     if (Manager->setup_signal_catcher() < 0) {
         return ELM_EXIT_MNGR_SIG_SETUP;
     }
 
+    elm_trace_end("setup_signal_catcher", start);
+
+    /* Load what does not need the display while X starts */
+    elm_preload_start();
+
+    start = elm_trace_begin();
+
     if (Manager->setup_xserver() < 0) {
         return ELM_EXIT_MNGR_X;
     }
 
+    elm_trace_end("setup_xserver", start);
+
     /* Prompt for username/password */
     while (1) {
         if (Manager->login_prompt() < 0)
@@ -121,7 +175,8 @@ int elm_login_manager_run(void)
 }
 
 /* ************************************************************************** */
-/* Display GUI login manager prompt */
+/* Display GUI login manager prompt. The greeter is built the first time only,
+ * it is reset and shown again after each session. */
 int elm_login_manager_login_prompt(void)
 {
     elmprintf(LOGINFO, "Preparing to display login prompt.");
@@ -131,24 +186,51 @@ int elm_login_manager_login_prompt(void)
     }
 
     elmprintf(LOGINFO, "Displaying login prompt.");
+    elm_io_set_phase("greeter");
+
+    if (Window) {
+        gtk_main();
+        return 0;
+    }
+
+    int64_t start = elm_trace_begin();
+
+    FrameStart = start;
 
     gtk_init(0, 0);
+    elm_conf_watch();
+    elm_trace_end("gtk_init", start);
+    start = elm_trace_begin();
+
+    if (elm_gtk_load_theme() < 0) {
+        elmprintf(LOGWARN, "Unable to load theme.");
+    }
+
+    elm_trace_end("theme", start);
+    start = elm_trace_begin();
 
     if (Manager->build_window() < 0) {
         exit(ELM_EXIT_MNGR_BUILD_WIN);
     }
 
+    elm_trace_end("build_window", start);
+    start = elm_trace_begin();
+
     if (Manager->build_apps() < 0) {
         exit(ELM_EXIT_MNGR_BUILD_APP);
     }
 
+    elm_trace_end("build_apps", start);
+
+    elm_conf_log_stats();
     gtk_main();
 
     return 0;
 }
 
 /* ************************************************************************** */
-/* Run login session */
+/* Run login session. The session is left to run once started, logging out
+ * happens from the main loop when it exits. */
 void * elm_login_manager_login_session(void *data)
 {
     elmprintf(LOGINFO, "Preparing to run user session.");
@@ -164,31 +246,59 @@ void * elm_login_manager_login_session(void *data)
         exit(ELM_EXIT_SESS_NEW);
     }
 
+    elm_io_set_phase("auth");
+
+    int64_t start = elm_trace_begin();
+
     if (session->auth() < 0) {
-        /* This does not work, causes SIGSEGV for some reason */
-        /* Manager->hide_apps(); */
-        /* sleep(2); */
-        /* Manager->show_apps(); */
+        elm_trace_end("auth", start);
+        elm_io_set_phase("greeter");
+
         return NULL;
     }
 
+    elm_trace_end("auth", start);
+
     if (elm_login_manager_preview_login()) {
         exit(ELM_EXIT_MNGR_PREVIEW);
     }
 
-    Manager->hide_apps();
+    /* GTK is only used from the main loop, this is the login thread */
+    g_idle_add(elm_login_manager_hide_greeter, NULL);
+    elm_io_set_phase("session");
+
+    int pid;
 
-    if (session->login() < 0) {
-        Manager->show_apps();
+    if ((pid=session->login()) < 0) {
+        elm_io_set_phase("greeter");
+        g_idle_add(elm_login_manager_show_greeter, NULL);
         return NULL;
     }
 
+    elm_supervisor_watch(pid, "session", elm_login_manager_session_exited,
+                         session);
+
+    return NULL;
+}
+
+/* ************************************************************************** */
+/* Logout once the user session exited, and show the greeter again */
+void elm_login_manager_session_exited(pid_t pid, int status,
+                                      const struct rusage *usage, void *data)
+{
+    ElmSession *session = data;
+
+    elm_io_set_session_pid(0);
+    elm_io_set_phase("logout");
+
     if (session->logout() < 0) {
     }
 
-    Manager->show_apps();
+    GreetStart = g_get_monotonic_time();
+    GreetTrace = elm_trace_begin();
 
-    return NULL;
+    elm_io_set_phase("greeter");
+    elm_login_manager_show_greeter(NULL);
 }
 
 /* ************************************************************************** */
@@ -218,8 +328,20 @@ int elm_login_manager_build_window(void)
 
     elm_x_screen_dimensions(&width, &height);
     elm_gtk_set_window_size(&Window, width, height);
-    elm_gtk_add_css_from_conf(&Window, "Manager", "Images", "Background");
+    elm_login_manager_set_background();
     elm_gtk_add_widget(&Window, Container);
+    elm_conf_subscribe("Images", elm_login_manager_conf_changed, NULL);
+    elm_x_set_screen_callback(elm_login_manager_screen_changed, NULL);
+    elm_idle_init(elm_login_manager_idle_changed, NULL);
+    elm_idle_set_enabled(1);
+
+    if (elm_trace_is_enabled()) {
+        g_signal_connect_after(Window, "draw",
+                               G_CALLBACK(elm_login_manager_first_frame), NULL);
+    }
+
+    g_signal_connect_after(Window, "draw",
+                           G_CALLBACK(elm_login_manager_load_plugins), NULL);
 
     gtk_widget_show(Container);
     gtk_widget_show_all(Window);
@@ -228,64 +350,159 @@ int elm_login_manager_build_window(void)
 }
 
 /* ************************************************************************** */
-/* Build login manager applications */
+/* Build login manager applications. The built-in apps come first, followed by
+ * the plugins that are not lazy. */
 int elm_login_manager_build_apps(void)
 {
     elmprintf(LOGINFO, "Building login manager apps.");
 
-    ElmApp       *apps;
-    ElmGravity    gravity;
-    int           width;
-    int           height;
-    int           x;
-    int           y;
-    size_t        i;
+    ElmApp *apps;
+    size_t  i;
 
-    elm_x_screen_dimensions(&width, &height);
+    elm_preload_wait();
 
-    /* Iterate over each app, display it, and add it to login manager window */
     for (apps=login_interface(), i=0; apps[i].display; i++)
     {
-        elmprintf(LOGINFO, "Adding app '%d' to login manager.", i);
+        elm_login_manager_add_app(&apps[i], NULL);
+    }
 
-        /* Allocate application */
-        if (elm_login_manager_alloc_apps(i+1) < 0) {
-            exit(ELM_EXIT_MNGR_APP);
-        }
+    elm_plugin_add_apps(elm_login_manager_add_app, NULL);
 
-        /* Append widget to list */
-        Widgets[i] = apps[i].display(elm_login_manager_thread);
-
-        /* Add widget to container */
-        gravity = apps[i].gravity;
-        x       = apps[i].x;
-        y       = apps[i].y;
-
-        switch (gravity) {
-        case ELM_GRAV_TOP_LEFT:
-            break;
-        case ELM_GRAV_TOP_RIGHT:
-            x = width - x;
-            break;
-        case ELM_GRAV_CENTER:
-            x = width/2  + x;
-            y = height/2 + y;
-            break;
-        case ELM_GRAV_BOTTOM_LEFT:
-            y = height - y;
-            break;
-        case ELM_GRAV_BOTTOM_RIGHT:
-            x = width  - x;
-            y = height - y;
-            break;
-        default:
-            break;
-        }
+    return 0;
+}
 
-        gtk_fixed_put(GTK_FIXED(Container), Widgets[i], x, y);
+/* ************************************************************************** */
+/* Display an app and add it to the login manager window */
+void elm_login_manager_add_app(const ElmApp *app, void *data)
+{
+    size_t     n = NumApps;
+    GtkWidget *widget;
+    int        width;
+    int        height;
+    int        x;
+    int        y;
+    char       name[ELM_MAX_MSG_SIZE];
+    int64_t    start;
+
+    elmprintf(LOGDEBUG, "Adding app '%zu' to login manager.", n);
+
+    /* Allocate application */
+    if ((elm_login_manager_alloc_apps(n+1) < 0)
+        || !(Apps=realloc(Apps, (n+2) * sizeof(*Apps))))
+    {
+        exit(ELM_EXIT_MNGR_APP);
     }
 
-    return 0;
+    memset(&Apps[n+1], 0, sizeof(*Apps));
+
+    /* Display the app */
+    start = elm_trace_begin();
+
+    if (!(widget=app->display(elm_login_manager_thread))) {
+        elmprintf(LOGWARN, "Unable to display app '%zu'.", n);
+        memset(&Apps[n], 0, sizeof(*Apps));
+        Widgets[n] = NULL;
+        return;
+    }
+
+    snprintf(name, sizeof(name), "display app %zu", n);
+    elm_trace_end(name, start);
+
+    Apps[n]    = *app;
+    Widgets[n] = widget;
+    NumApps++;
+
+    /* Add widget to container */
+    elm_x_screen_dimensions(&width, &height);
+    elm_login_manager_get_position(app, width, height, &x, &y);
+    gtk_fixed_put(GTK_FIXED(Container), widget, x, y);
+
+    /* An app added once the greeter is up, such as a lazy plugin, shows up now */
+    if (gtk_widget_get_visible(Window)) {
+        gtk_widget_show(widget);
+    }
+}
+
+/* ************************************************************************** */
+/* Return where an app goes on a screen, from its gravity and offset */
+void elm_login_manager_get_position(const ElmApp *app, int width, int height,
+                                    int *x, int *y)
+{
+    *x = app->x;
+    *y = app->y;
+
+    switch (app->gravity) {
+    case ELM_GRAV_TOP_LEFT:
+        break;
+    case ELM_GRAV_TOP_RIGHT:
+        *x = width - *x;
+        break;
+    case ELM_GRAV_CENTER:
+        *x = width/2  + *x;
+        *y = height/2 + *y;
+        break;
+    case ELM_GRAV_BOTTOM_LEFT:
+        *y = height - *y;
+        break;
+    case ELM_GRAV_BOTTOM_RIGHT:
+        *x = width  - *x;
+        *y = height - *y;
+        break;
+    default:
+        break;
+    }
+}
+
+/* ************************************************************************** */
+/* Quiet the greeter down while nobody is using it. The clock stops, and the
+ * surfaces that are only needed for drawing are dropped. The background is
+ * swapped for its mapping in the cache, which the kernel can page out. Waking
+ * up redraws the window, which blurs the backdrops again. */
+void elm_login_manager_idle_changed(int idle, void *data)
+{
+    const char      *path = elm_conf_read("Images", "Background");
+    cairo_surface_t *surface;
+    int              width;
+    int              height;
+
+    elm_clock_pause(idle);
+
+    if (!idle) {
+        gtk_widget_queue_draw(Window);
+        return;
+    }
+
+    elm_gtk_clear_backdrops(Window);
+    elm_x_screen_dimensions(&width, &height);
+
+    if ((surface=elm_background_load(path, width, height))) {
+        elm_gtk_set_window_background(&Window, surface);
+        cairo_surface_destroy(surface);
+    }
+
+    malloc_trim(0);
+}
+
+/* ************************************************************************** */
+/* Fit the window to a new screen size, and move the apps that were already
+ * built to their place on it */
+void elm_login_manager_screen_changed(int width, int height, void *data)
+{
+    int    x;
+    int    y;
+    size_t i;
+
+    if (!Window) {
+        return;
+    }
+
+    elm_gtk_set_window_size(&Window, width, height);
+    elm_login_manager_set_background();
+
+    for (i=0; Apps && Apps[i].display && Widgets[i]; i++) {
+        elm_login_manager_get_position(&Apps[i], width, height, &x, &y);
+        gtk_fixed_move(GTK_FIXED(Container), Widgets[i], x, y);
+    }
 }
 
 /* ************************************************************************** */
@@ -311,6 +528,7 @@ int elm_login_manager_setup_dir(void)
 int elm_login_manager_setup_xserver(void)
 {
     elmprintf(LOGINFO, "Setting up X server.");
+    elm_io_set_phase("xserver");
 
     if (!elm_login_manager_exists("setup X server")) {
         return 1;
@@ -320,19 +538,24 @@ int elm_login_manager_setup_xserver(void)
         return -1;
     }
 
-    if (elm_x_set_transparency(1) < 0) {
+    /* Translucent apps are blended over the background by GTK, in the one
+     * window of the greeter, so a compositor is only started if asked for */
+    int     compositor = (elm_conf_read("Main", "Compositor")
+                          && (elm_conf_read_bool("Main", "Compositor") > 0));
+    int64_t start      = elm_trace_begin();
+
+    if (elm_x_set_transparency(compositor) < 0) {
         return 2;
     }
 
-    if (elm_x_set_cursor() < 0) {
-        return -3;
-    }
+    elm_trace_end("xcompmgr", start);
 
     return 0;
 }
 
 /* ************************************************************************** */
-/* Setup signal catcher */
+/* Setup signal catcher. Signals are handled from the main loop, which makes
+ * it safe to log from the handlers. */
 int elm_login_manager_setup_signal_catcher(void)
 {
     elmprintf(LOGINFO, "Setting up signal catcher.");
@@ -341,20 +564,20 @@ int elm_login_manager_setup_signal_catcher(void)
         return -1;
     }
 
-    struct sigaction act;
     struct sigaction ign;
 
-    act.sa_flags     = SA_SIGINFO;
-    act.sa_sigaction = &elm_login_manager_signal_catcher;
-    ign.sa_flags     = SA_SIGINFO;
-    ign.sa_handler   = SIG_IGN;
-
-    sigaction(SIGQUIT, &act, NULL);
-    /* sigaction(SIGTERM, &act, NULL); */
-    sigaction(SIGKILL, &act, NULL);
-    sigaction(SIGINT,  &act, NULL);
-    sigaction(SIGHUP,  &act, NULL);
-    sigaction(SIGPIPE, &act, NULL);
+    ign.sa_flags   = SA_SIGINFO;
+    ign.sa_handler = SIG_IGN;
+
+    if (elm_supervisor_init() < 0) {
+        return -2;
+    }
+
+    elm_supervisor_catch(SIGQUIT, &elm_login_manager_signal_catcher);
+    /* elm_supervisor_catch(SIGTERM, &elm_login_manager_signal_catcher); */
+    elm_supervisor_catch(SIGINT,  &elm_login_manager_signal_catcher);
+    elm_supervisor_catch(SIGHUP,  &elm_login_manager_signal_reopen);
+    elm_supervisor_catch(SIGPIPE, &elm_login_manager_signal_catcher);
     sigaction(SIGTTIN, &ign, NULL);
     sigaction(SIGTTOU, &ign, NULL);
     sigaction(SIGUSR1, &ign, NULL);
@@ -365,38 +588,28 @@ int elm_login_manager_setup_signal_catcher(void)
 /* ************************************************************************** */
 /* Catch signals */
 /* To-do: Clean this up. */
-void elm_login_manager_signal_catcher(int sig, siginfo_t *info, void *context)
+void elm_login_manager_signal_catcher(const struct signalfd_siginfo *info)
 {
     if (!elm_login_manager_exists("catch signals")) {
         exit(ELM_EXIT_MNGR_SIG);
     }
 
-    elmprintf(LOGWARN, "Unexpected signal: %d.", sig);
-    elmprintf(LOGWARN, "signo:  %d.", info->si_signo);
-    elmprintf(LOGWARN, "code:   %d.", info->si_code);
-    elmprintf(LOGWARN, "errno:  %d.", info->si_errno);
-    elmprintf(LOGWARN, "pid:    %ld.", info->si_pid);
-    elmprintf(LOGWARN, "uid:    %ld.", info->si_uid);
-    elmprintf(LOGWARN, "status: %d.", info->si_status);
-
-    /* /\* Might not need this *\/ */
-    /* int   signo = info->si_signo; */
-    /* pid_t pid   = info->si_pid; */
-
-    /* if ((signo == SIGTERM) && (pid == 1)) { */
-    /*     elmprintf(LOGWARN, "Ignoring signal '%d' from PID '%lu'.", signo, pid); */
-
-    /*     struct sigaction act; */
-    /*     act.sa_flags     = SA_SIGINFO; */
-    /*     act.sa_sigaction = &elm_login_manager_signal_catcher; */
-    /*     sigaction(signo, &act, NULL); */
-
-    /*     return; */
-    /* } */
+    elmprintf(LOGWARN, "Unexpected signal: %u.", info->ssi_signo);
+    elmprintf(LOGWARN, "code:   %d.", info->ssi_code);
+    elmprintf(LOGWARN, "errno:  %d.", info->ssi_errno);
+    elmprintf(LOGWARN, "pid:    %u.", info->ssi_pid);
+    elmprintf(LOGWARN, "uid:    %u.", info->ssi_uid);
+    elmprintf(LOGWARN, "status: %d.", info->ssi_status);
 
-	exit(ELM_EXIT_MNGR_SIG);
+    exit(ELM_EXIT_MNGR_SIG);
 }
 
+/* ************************************************************************** */
+/* Reopen the log file (after it was rotated) */
+void elm_login_manager_signal_reopen(const struct signalfd_siginfo *info)
+{
+    elm_io_reopen();
+}
 
 /* ************************************************************************** */
 /* Show widgets */
@@ -407,12 +620,12 @@ int elm_login_manager_show_apps(void)
 
     size_t i;
     for (i=0; Widgets[i]; i++) {
-        elmprintf(LOGINFO, "Showing widget %d: %p.", i, Widgets[i]);
+        elmprintf(LOGDEBUG, "Showing widget %d: %p.", i, Widgets[i]);
         gtk_widget_show(Widgets[i]);
     }
-    elmprintf(LOGINFO, "Showing Container: %p.", Container);
+    elmprintf(LOGDEBUG, "Showing Container: %p.", Container);
     gtk_widget_show(Container);
-    elmprintf(LOGINFO, "Showing Window: %p.", Window);
+    elmprintf(LOGDEBUG, "Showing Window: %p.", Window);
     gtk_widget_show(Window);
 
     return 0;
@@ -426,17 +639,65 @@ int elm_login_manager_hide_apps(void)
 
     size_t i;
     for (i=0; Widgets[i]; i++) {
-        elmprintf(LOGINFO, "Hiding widget %d: %p.", i, Widgets[i]);
+        elmprintf(LOGDEBUG, "Hiding widget %d: %p.", i, Widgets[i]);
         gtk_widget_hide(Widgets[i]);
     }
-    elmprintf(LOGINFO, "Hiding Container: %p.", Container);
+    elmprintf(LOGDEBUG, "Hiding Container: %p.", Container);
     gtk_widget_hide(Container);
-    elmprintf(LOGINFO, "Hiding Window: %p.", Window);
+    elmprintf(LOGDEBUG, "Hiding Window: %p.", Window);
     gtk_widget_hide(Window);
 
     return 0;
 }
 
+/* ************************************************************************** */
+/* Reset the state of the apps, before showing them again */
+int elm_login_manager_reset_apps(void)
+{
+    elmprintf(LOGINFO, "Resetting login manager apps.");
+
+    size_t i;
+
+    if (!Apps) {
+        return -1;
+    }
+
+    for (i=0; Apps[i].display; i++) {
+        if (Apps[i].reset) {
+            Apps[i].reset();
+        }
+    }
+
+    return 0;
+}
+
+/* ************************************************************************** */
+/* Reset and show the greeter from the main loop */
+gboolean elm_login_manager_show_greeter(gpointer data)
+{
+    Manager->reset_apps();
+    Manager->show_apps();
+    elm_idle_set_enabled(1);
+
+    if (GreetStart) {
+        g_signal_connect_after(Window, "draw",
+                               G_CALLBACK(elm_login_manager_greeter_ready),
+                               NULL);
+    }
+
+    return G_SOURCE_REMOVE;
+}
+
+/* ************************************************************************** */
+/* Hide the greeter from the main loop */
+gboolean elm_login_manager_hide_greeter(gpointer data)
+{
+    elm_idle_set_enabled(0);
+    Manager->hide_apps();
+
+    return G_SOURCE_REMOVE;
+}
+
 /* ************************************************************************** */
 /* Set preview mode flag */
 void elm_login_manager_set_preview_mode(int flag)
@@ -511,3 +772,103 @@ int elm_login_manager_exists(char *message)
 
     return 1;
 }
+
+/* ************************************************************************** */
+/* Apply a new background image */
+void elm_login_manager_conf_changed(const char *group, void *data)
+{
+    elm_login_manager_set_background();
+}
+
+/* ************************************************************************** */
+/* Set the background image of the login manager window. The image is painted
+ * from the background cache, or else scaled from the preloaded image, and the
+ * theme is the fallback when the image cannot be loaded at all. */
+int elm_login_manager_set_background(void)
+{
+    const char      *path    = elm_conf_read("Images", "Background");
+    cairo_surface_t *surface = NULL;
+    GdkPixbuf       *pixbuf  = NULL;
+    int              width;
+    int              height;
+
+    elm_x_screen_dimensions(&width, &height);
+
+    if (!(surface=elm_background_load(path, width, height))) {
+        if (!(pixbuf=elm_preload_get_pixbuf(path)) && path) {
+            pixbuf = gdk_pixbuf_new_from_file(path, NULL);
+        }
+
+        surface = elm_background_new(pixbuf, path, width, height);
+
+        if (pixbuf) {
+            g_object_unref(pixbuf);
+        }
+    }
+
+    if (!surface) {
+        return elm_gtk_add_class(&Window, "Manager");
+    }
+
+    elm_gtk_set_window_background(&Window, surface);
+    cairo_surface_destroy(surface);
+
+    return 0;
+}
+
+/* ************************************************************************** */
+/* Set the print level and log backend from the config file */
+void elm_login_manager_set_logging(const char *group, void *data)
+{
+    const char *level   = elm_conf_read(group, "LogLevel");
+    const char *backend = elm_conf_read(group, "LogBackend");
+
+    elm_io_set_level(elm_io_level_from_string(level));
+    elm_io_set_backend(elm_io_backend_from_string(backend));
+}
+
+/* ************************************************************************** */
+/* Load the lazy plugins once the first frame of the login manager window is
+ * drawn, so that they do not hold up the greeter */
+gboolean elm_login_manager_load_plugins(GtkWidget *widget, cairo_t *cr,
+                                        gpointer data)
+{
+    g_signal_handlers_disconnect_by_func(widget,
+                                         G_CALLBACK(elm_login_manager_load_plugins),
+                                         data);
+    elm_plugin_load_lazy(elm_login_manager_add_app, NULL);
+
+    return FALSE;
+}
+
+/* ************************************************************************** */
+/* Trace the time until the first frame of the login manager window is drawn */
+gboolean elm_login_manager_first_frame(GtkWidget *widget, cairo_t *cr,
+                                       gpointer data)
+{
+    elm_trace_end("first_frame", FrameStart);
+    elmprintf(LOGINFO, "First frame drawn after %lu X requests.",
+              elm_x_get_requests());
+    g_signal_handlers_disconnect_by_func(widget,
+                                         G_CALLBACK(elm_login_manager_first_frame),
+                                         data);
+
+    return FALSE;
+}
+
+/* ************************************************************************** */
+/* Log the time from logout until the greeter was drawn again */
+gboolean elm_login_manager_greeter_ready(GtkWidget *widget, cairo_t *cr,
+                                         gpointer data)
+{
+    elmprintf(LOGINFO, "Greeter ready %.1f ms after logout.",
+              (g_get_monotonic_time()-GreetStart) / 1000.0);
+    elm_trace_end("greeter_ready", GreetTrace);
+    g_signal_handlers_disconnect_by_func(widget,
+                                         G_CALLBACK(elm_login_manager_greeter_ready),
+                                         data);
+
+    GreetStart = 0;
+
+    return FALSE;
+}
@@ -18,9 +18,11 @@
 #include "elmdef.h"
 #include "elmio.h"
 #include "elmsession.h"
-#include "elmstd.h"
+#include "elmspawn.h"
+#include "elmtrace.h"
 #include "elmx.h"
 #include <errno.h>
+#include <glib.h>
 #include <grp.h>
 #include <pwd.h>
 #include <stdio.h>
@@ -44,13 +46,15 @@
 /* Private functions */
 static        int      elm_pam_exec_login(void);
 static        int      elm_pam_session_open(void);
-static        int      elm_pam_session_setup(struct passwd *pw);
+static        int      elm_pam_session_setup(struct passwd *pw,
+                                             ElmSpawnAttr *attr);
 static        int      elm_pam_session_setup_files(uid_t uid, gid_t gid);
-static        int      elm_pam_session_setup_id(uid_t uid, gid_t gid);
-static        int      elm_pam_session_env(struct passwd *pw);
+static        int      elm_pam_session_setup_id(uid_t uid, gid_t gid,
+                                                ElmSpawnAttr *attr);
+static        char **  elm_pam_session_env(struct passwd *pw);
 static        int      elm_pam_session_end(void);
 static        int      elm_pam_wtmp_write(void);
-static        int      elm_pam_utmp_write(void);
+static        int      elm_pam_utmp_write(pid_t pid);
 static        int      elm_pam_utmp_clear(void);
 static        int      elm_pam_conversation(int num,
                                             const struct pam_message **messages,
@@ -84,6 +88,7 @@ int elm_pam_auth(void)
     int              status;
 
     /* Start pam */
+    elm_io_set_user(PamInfo->username);
     elmprintf(LOGINFO, "%s '%s'.",
               "Starting PAM transaction for user", PamInfo->username);
 
@@ -123,13 +128,19 @@ int elm_pam_auth(void)
     /* Authenticate pam user */
     elmprintf(LOGINFO, "Authenticating username and password.");
 
+    int64_t start = elm_trace_begin();
+
     PamResult = pam_authenticate(PamHandle, 0);
 
+    elm_trace_end("pam_authenticate", start);
+
     if (!elm_pam_success("authenticate user")) {
         status = -5;
         goto cleanup;
     }
 
+    start = elm_trace_begin();
+
     /* Check if user account is valid */
     PamResult = pam_acct_mgmt(PamHandle, 0);
 
@@ -146,6 +157,8 @@ int elm_pam_auth(void)
         goto cleanup;
     }
 
+    elm_trace_end("pam_acct_mgmt_setcred", start);
+
     return 0;
 
 cleanup:
@@ -155,21 +168,27 @@ cleanup:
 }
 
 /* ************************************************************************** */
-/* Login and start the user session */
+/* Login and start the user session. Return the PID of the session. */
 /* Could clear ElmSession password field and just pass in that struct? */
 int elm_pam_login(void)
 {
     elmprintf(LOGINFO, "Preparing to login and start user session.");
 
+    int64_t start = elm_trace_begin();
+
     if (elm_pam_session_open() < 0) {
         return -1;
     }
 
+    elm_trace_end("pam_open_session", start);
+
     return elm_pam_exec_login();
 }
 
 /* ************************************************************************** */
-/* Execute login command */
+/* Execute login command. Return the PID of the session, which the caller
+ * watches to know when to logout. The session is set up by the greeter, before
+ * it is spawned, so nothing is left to do in the child but exec. */
 int elm_pam_exec_login(void)
 {
     struct passwd *pw;
@@ -179,54 +198,51 @@ int elm_pam_exec_login(void)
     }
 
     /* Run command */
-    char  *cmd    = elm_pam_get_login_cmd();
-    char  *argv[] = {pw->pw_shell, "-c", cmd, NULL};
-    pid_t  pid;
+    char         *cmd    = elm_pam_get_login_cmd();
+    char         *argv[] = {pw->pw_shell, "-c", cmd, NULL};
+    ElmSpawnAttr  attr;
+    pid_t         pid    = -1;
 
-    switch ((pid=fork()))
-    {
-    case 0:
-        if (elm_pam_session_setup(pw) < 0) {
-            return -2;
-        }
+    int64_t start = elm_trace_begin();
 
-        elm_std_execvp(argv[0], argv);
-        exit(ELM_EXIT_PAM_LOGIN);
-    case -1:
-        elmprintf(LOGERRNO, "%s '%s'", "Error during fork to start", argv[0]);
-        exit(ELM_EXIT_PAM_LOGIN);
-    default:
-        break;
-    }
+    elm_spawn_attr_init(&attr, argv);
 
-    /* Wait for session to end */
-    elmprintf(LOGINFO, "Waiting for login session to end (pid=%d).", pid);
+    if (elm_pam_session_setup(pw, &attr) < 0) {
+        goto cleanup;
+    }
 
-    int status;
+    elm_trace_end("session_setup", start);
+    start = elm_trace_begin();
 
-    if (waitpid(pid, &status, 0) == -1) {
-        elmprintf(LOGERRNO, "Error while waiting for pid  errored");
-        elm_pam_logout();
-        return -3;
+    if ((pid=elm_spawn(&attr)) < 0) {
+        goto cleanup;
     }
 
-    /* Check reason for session ending */
-    if (WIFEXITED(status)) {
-        elmprintf(LOGERR, "Exited with status '%d'.", WEXITSTATUS(status));
-    }
-    else if (WIFSIGNALED(status)) {
-        elmprintf(LOGERR, "Killed by signal '%d'.", WTERMSIG(status));
-    }
-    else if (WIFSTOPPED(status)) {
-        elmprintf(LOGERR, "Stopped by signal '%d'.", WSTOPSIG(status));
+    elm_trace_end("session_spawn", start);
+
+    /* The session is already running, so a missing login record is not worth
+     * tearing it down for */
+    if (elm_pam_utmp_write(pid) < 0) {
+        elmprintf(LOGERR, "Session (pid=%d) has no utmp login record.", pid);
     }
-    else if (WIFCONTINUED(status)) {
-        elmprintf(LOGERR, "Resumed by delivery of SIGCONT.");
+
+    if (elm_pam_wtmp_write() < 0) {
+        elmprintf(LOGERR, "Session (pid=%d) has no wtmp login record.", pid);
     }
-    else {
+
+    elm_io_set_session_pid(pid);
+    elmprintf(LOGINFO, "Started login session (pid=%d).", pid);
+
+cleanup:
+    g_strfreev((char**)attr.envp);
+    free((gid_t*)attr.groups);
+
+    if (pid < 0) {
+        elm_pam_session_end();
+        return -2;
     }
 
-    return 0;
+    return pid;
 }
 
 /* ************************************************************************** */
@@ -268,40 +284,30 @@ int elm_pam_session_open(void)
 }
 
 /* ************************************************************************** */
-/* Setup pam login session */
-int elm_pam_session_setup(struct passwd *pw)
+/* Setup pam login session, and how the session is spawned */
+int elm_pam_session_setup(struct passwd *pw, ElmSpawnAttr *attr)
 {
     elmprintf(LOGINFO, "Setting up user login with PAM.");
 
-    if (chdir(pw->pw_dir) < 0) {
-        elmprintf(LOGERRNO, "Unable to change directory");
+    attr->cwd   = pw->pw_dir;
+    attr->flags = ELM_SPAWN_SETSID;
+
+    if (elm_pam_session_setup_files(pw->pw_uid, pw->pw_gid) < 0) {
         return -1;
     }
 
-    if (elm_pam_utmp_write() < 0) {
+    if (elm_pam_session_setup_id(pw->pw_uid, pw->pw_gid, attr) < 0) {
         return -2;
     }
 
-    if (elm_pam_wtmp_write() < 0) {
+    if (!(attr->envp=elm_pam_session_env(pw))) {
         return -3;
     }
 
-    if (elm_pam_session_setup_files(pw->pw_uid, pw->pw_gid) < 0) {
+    if (elm_x_load_user_preferences(attr) < 0) {
         return -4;
     }
 
-    if (elm_pam_session_setup_id(pw->pw_uid, pw->pw_gid) < 0) {
-        return -5;
-    }
-
-    if (elm_pam_session_env(pw) < 0) {
-        return -6;
-    }
-
-    if (elm_x_load_user_preferences() < 0) {
-        return -7;
-    }
-
     return 0;
 }
 
@@ -326,87 +332,95 @@ int elm_pam_session_setup_files(uid_t uid, gid_t gid)
     }
 
  
-    /* ELM log */
-    if (access(ELM_LOG, F_OK) == 0) {
-        chown(ELM_LOG, uid, gid);
-    }
-    else {
-        elmprintf(LOGWARN, "%s: %s.",
-                  "Unable to chown ELM log", "File does not exist.");
+    /* ELM log. There is none when only the journal is used. */
+    if (elm_io_get_backend() & ELM_LOG_FILE) {
+        if (access(ELM_LOG, F_OK) == 0) {
+            chown(ELM_LOG, uid, gid);
+        }
+        else {
+            elmprintf(LOGWARN, "%s: %s.",
+                      "Unable to chown ELM log", "File does not exist.");
+        }
     }
 
     return 0;
 }
 
 /* ************************************************************************** */
-/* Setup user's ID for session login */
-int elm_pam_session_setup_id(uid_t uid, gid_t gid)
+/* Setup user's ID for session login. The groups are looked up here, the
+ * session switches to them when it is spawned. */
+int elm_pam_session_setup_id(uid_t uid, gid_t gid, ElmSpawnAttr *attr)
 {
-    if (initgroups(PamInfo->username, gid) < 0) {
-        elmprintf(LOGERRNO, "Error setting initgroups");
+    gid_t *groups  = NULL;
+    int    ngroups = 0;
+
+    getgrouplist(PamInfo->username, gid, NULL, &ngroups);
+
+    if (!(groups=calloc(ngroups, sizeof(gid_t)))) {
+        elmprintf(LOGERRNO, "Unable to allocate groups");
         return -1;
     }
 
-    if (setgid(gid) < 0) {
-        elmprintf(LOGERRNO, "Error setting GID");
+    if (getgrouplist(PamInfo->username, gid, groups, &ngroups) < 0) {
+        elmprintf(LOGERR, "Error getting groups of user '%s'.",
+                  PamInfo->username);
+        free(groups);
         return -2;
     }
 
-    if (setuid(uid) < 0) {
-        elmprintf(LOGERRNO, "Error setting UID");
-        return -3;
-    }
+    attr->uid     = uid;
+    attr->gid     = gid;
+    attr->groups  = groups;
+    attr->ngroups = ngroups;
 
     return 0;
 }
 
 /* ************************************************************************** */
-/* Set environment variables for USER */
-int elm_pam_session_env(struct passwd *pw)
+/* Return the environment of the session, which is that of the greeter with the
+ * variables of USER on top */
+char ** elm_pam_session_env(struct passwd *pw)
 {
     elmprintf(LOGINFO, "%s", "Initializing environment variables.");
 
+    char **env = g_get_environ();
+
     /* Default environment variables */
-    elm_std_setenv("HOME", pw->pw_dir);
-    elm_std_setenv("PWD", pw->pw_dir);
-    elm_std_setenv("SHELL", pw->pw_shell);
-    elm_std_setenv("USER", pw->pw_name);
-    elm_std_setenv("LOGNAME", pw->pw_name);
+    env = g_environ_setenv(env, "HOME",    pw->pw_dir,   TRUE);
+    env = g_environ_setenv(env, "PWD",     pw->pw_dir,   TRUE);
+    env = g_environ_setenv(env, "SHELL",   pw->pw_shell, TRUE);
+    env = g_environ_setenv(env, "USER",    pw->pw_name,  TRUE);
+    env = g_environ_setenv(env, "LOGNAME", pw->pw_name,  TRUE);
 
     /* Missing environment variables that are set by pam */
     char **envvars = pam_getenvlist(PamHandle);
-    char *name;
-    char *value;
-    char *c;
-    int   i;
-
-    for (i=0; envvars[i] && (i < 30); i++) {
-        if (!(c=strchr(envvars[i], '='))) {
-            continue;
-        }
-
-        *c    = 0;
-        name  = envvars[i];
-        value = c+1;
+    char  *c;
+    int    i;
 
-        if (!getenv(name)) {
-            if (elm_std_setenv(name, value) < 0) {
-                continue;
-            }
+    for (i=0; envvars && envvars[i]; i++) {
+        if ((i < 30) && (c=strchr(envvars[i], '='))) {
+            *c  = 0;
+            env = g_environ_setenv(env, envvars[i], c+1, FALSE);
         }
+
+        free(envvars[i]);
     }
 
+    free(envvars);
+
     /* Add additional missing environment variables */
-    char *home = getenv("HOME");
-    char *ttyn = getenv("TTYN");
-    char  cachehome[ELM_MAX_PATH_SIZE];
-    char  confighome[ELM_MAX_PATH_SIZE];
-    char  datahome[ELM_MAX_PATH_SIZE];
-    char  runtimedir[ELM_MAX_PATH_SIZE];
+    const char *home = g_environ_getenv(env, "HOME");
+    char       *ttyn = getenv("TTYN");
+    char        cachehome[ELM_MAX_PATH_SIZE];
+    char        confighome[ELM_MAX_PATH_SIZE];
+    char        datahome[ELM_MAX_PATH_SIZE];
+    char        runtimedir[ELM_MAX_PATH_SIZE];
 
     snprintf(cachehome,  sizeof(cachehome),  "%s/.cache",       home);
     snprintf(confighome, sizeof(confighome), "%s/.config",      home);
     snprintf(datahome,   sizeof(datahome),   "%s/.local/share", home);
+    snprintf(runtimedir, sizeof(runtimedir), "/run/user/%lu",
+             (unsigned long)pw->pw_uid);
 
     char *xdgvars[][2] = {
         {"XDG_CACHE_HOME",  cachehome},
@@ -421,16 +435,15 @@ int elm_pam_session_env(struct passwd *pw)
     };
 
     for (i=0; xdgvars[i][0]; i++) {
-        if (!getenv(xdgvars[i][0])) {
-            if (elm_std_setenv(xdgvars[i][0], xdgvars[i][1])) {
-            }
+        if (xdgvars[i][1]) {
+            env = g_environ_setenv(env, xdgvars[i][0], xdgvars[i][1], FALSE);
         }
     }
 
-     elm_std_setenv("XDG_SESSION_CLASS", "user");
-     elm_std_setenv("XDG_SESSION_TYPE", "x11");
+    env = g_environ_setenv(env, "XDG_SESSION_CLASS", "user", TRUE);
+    env = g_environ_setenv(env, "XDG_SESSION_TYPE",  "x11",  TRUE);
 
-    return 0;
+    return env;
 }
 
 /* ************************************************************************** */
@@ -464,6 +477,7 @@ int elm_pam_session_end(void)
     }
 
     PamInfo = NULL;
+    elm_io_set_user(NULL);
 
     return status;
 }
@@ -482,7 +496,7 @@ int elm_pam_wtmp_write(void)
 
 /* ************************************************************************** */
 /* Manage utmp login record */
-int elm_pam_utmp_write(void)
+int elm_pam_utmp_write(pid_t pid)
 {
     elmprintf(LOGINFO, "Writing utmp login record.");
 
@@ -490,7 +504,7 @@ int elm_pam_utmp_write(void)
 
     /* Define utmp struct */
     PamUtmp.ut_type = USER_PROCESS;
-    PamUtmp.ut_pid  = getpid();
+    PamUtmp.ut_pid  = pid;
     PamUtmp.ut_addr = 0;
     strncpy(PamUtmp.ut_line, getenv("TTY"),     sizeof(PamUtmp.ut_line)-1);
     strncpy(PamUtmp.ut_id,   getenv("TTYN"),    sizeof(PamUtmp.ut_id)-1);
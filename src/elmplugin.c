@@ -0,0 +1,347 @@
+/* *****************************************************************************
+ * 
+ * Name:    elmplugin.c
+ * Author:  Gabriel Gonzalez
+ * Email:   gabeg@bu.edu
+ * License: The MIT License (MIT)
+ * 
+ * Description: Load apps from shared objects.
+ *              
+ * Notes: Each group in the config file named 'Plugin:<name>' declares a
+ *        plugin. It is loaded from 'Path', or else from '<name>.so' in the
+ *        plugin directory, and placed with 'Gravity', 'XPos', and 'YPos', the
+ *        same as the built-in apps.
+ * 
+ *        Plugins are loaded with their prepare function on worker threads, and
+ *        only displayed from the main loop. The plugins that are not lazy are
+ *        loaded with the other preloaded resources while X starts. Lazy ones
+ *        are not even opened until the greeter has drawn its first frame, so
+ *        they do not add to the time it takes to show up.
+ * 
+ *        A plugin whose descriptor is missing, or was built for another ABI
+ *        version, is closed and skipped.
+ * 
+ * *****************************************************************************
+ */
+
+/* Includes */
+#include "elmplugin.h"
+#include "elmconf.h"
+#include "elmdef.h"
+#include "elmio.h"
+#include "elmtrace.h"
+#include <dlfcn.h>
+#include <errno.h>
+#include <glib.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Defines */
+#define ELM_PLUGIN_GROUP "Plugin:"
+
+/* Typedefs */
+typedef struct
+{
+    char               *name;
+    char               *path;
+    int                 lazy;
+    void               *handle;
+    const ElmAppPlugin *desc;
+    ElmApp              app;
+} ElmPlugin;
+
+/* Private functions */
+static int         elm_plugin_scan(void);
+static ElmPlugin * elm_plugin_new(const char *group);
+static int         elm_plugin_open(ElmPlugin *plugin);
+static void *      elm_plugin_load_thread(void *data);
+static gboolean    elm_plugin_ready(gpointer data);
+static ElmGravity  elm_plugin_get_gravity(const char *group);
+static int         elm_plugin_get_pos(const char *group, const char *key);
+
+/* Private variables */
+static GSList         *Plugins       = NULL;
+static int             Scanned       = 0;
+static ElmPluginReady  ReadyCallback = NULL;
+static void           *ReadyData     = NULL;
+
+/* ************************************************************************** */
+/* Find the plugins in the config file, and load the ones that are not lazy.
+ * Blocks, so it is meant for a worker thread. */
+int elm_plugin_load(void)
+{
+    ElmPlugin *plugin;
+    GSList    *node;
+    int        status = 0;
+
+    if (elm_plugin_scan() < 0) {
+        return -1;
+    }
+
+    for (node=Plugins; node; node=node->next)
+    {
+        plugin = node->data;
+
+        if (!plugin->lazy && (elm_plugin_open(plugin) < 0)) {
+            status = -2;
+        }
+    }
+
+    return status;
+}
+
+/* ************************************************************************** */
+/* Call a function with each app from the plugins that were loaded up front */
+int elm_plugin_add_apps(ElmPluginReady callback, void *data)
+{
+    ElmPlugin *plugin;
+    GSList    *node;
+    int        count = 0;
+
+    for (node=Plugins; node; node=node->next)
+    {
+        plugin = node->data;
+
+        if (!plugin->lazy && plugin->desc) {
+            callback(&plugin->app, data);
+            count++;
+        }
+    }
+
+    return count;
+}
+
+/* ************************************************************************** */
+/* Load the lazy plugins on a worker thread. Each is handed to a function from
+ * the main loop, once it is ready. */
+int elm_plugin_load_lazy(ElmPluginReady callback, void *data)
+{
+    pthread_t thread;
+    GSList   *node;
+
+    for (node=Plugins; node; node=node->next)
+    {
+        if (((ElmPlugin*)node->data)->lazy) {
+            break;
+        }
+    }
+
+    if (!node) {
+        return 1;
+    }
+
+    ReadyCallback = callback;
+    ReadyData     = data;
+
+    if (pthread_create(&thread, NULL, elm_plugin_load_thread, NULL) != 0) {
+        elmprintf(LOGERR, "Unable to start plugin loader.");
+        return -1;
+    }
+
+    pthread_detach(thread);
+
+    return 0;
+}
+
+/* ************************************************************************** */
+/* Build the list of plugins from the config file, once */
+int elm_plugin_scan(void)
+{
+    ElmPlugin  *plugin;
+    char      **groups;
+    size_t      i;
+
+    if (Scanned) {
+        return 0;
+    }
+
+    Scanned = 1;
+
+    if (!(groups=elm_conf_get_groups())) {
+        return -1;
+    }
+
+    for (i=0; groups[i]; i++)
+    {
+        if (!g_str_has_prefix(groups[i], ELM_PLUGIN_GROUP)) {
+            continue;
+        }
+
+        if ((plugin=elm_plugin_new(groups[i]))) {
+            Plugins = g_slist_append(Plugins, plugin);
+        }
+    }
+
+    g_strfreev(groups);
+
+    return 0;
+}
+
+/* ************************************************************************** */
+/* Create a plugin from its group in the config file */
+ElmPlugin * elm_plugin_new(const char *group)
+{
+    const char *name = group + strlen(ELM_PLUGIN_GROUP);
+    const char *path = elm_conf_read(group, "Path");
+    ElmPlugin  *plugin;
+
+    if (!name[0]) {
+        elmprintf(LOGWARN, "Ignoring plugin group '%s': No name.", group);
+        return NULL;
+    }
+
+    plugin = g_new0(ElmPlugin, 1);
+
+    plugin->name        = g_strdup(name);
+    plugin->path        = (path && path[0])
+                          ? g_strdup(path)
+                          : g_strdup_printf("%s/%s.so", ELM_PLUGIN_DIR, name);
+    plugin->lazy        = (elm_conf_read(group, "Lazy")
+                           && (elm_conf_read_bool(group, "Lazy") > 0));
+    plugin->app.gravity = elm_plugin_get_gravity(group);
+    plugin->app.x       = elm_plugin_get_pos(group, "XPos");
+    plugin->app.y       = elm_plugin_get_pos(group, "YPos");
+
+    return plugin;
+}
+
+/* ************************************************************************** */
+/* Open a plugin, check its descriptor, and prepare it */
+int elm_plugin_open(ElmPlugin *plugin)
+{
+    int64_t             start = elm_trace_begin();
+    const ElmAppPlugin *desc;
+    char                name[ELM_MAX_MSG_SIZE];
+
+    if (!(plugin->handle=dlopen(plugin->path, RTLD_NOW | RTLD_LOCAL))) {
+        elmprintf(LOGERR, "Unable to load plugin '%s': %s.", plugin->name,
+                  dlerror());
+        return -1;
+    }
+
+    desc = dlsym(plugin->handle, ELM_APP_PLUGIN_SYMBOL);
+
+    if (!desc || (desc->abi != ELM_APP_ABI_VERSION) || !desc->display) {
+        elmprintf(LOGERR, "%s '%s': %s (ABI %u, expected %u).",
+                  "Unable to use plugin", plugin->name,
+                  "Invalid descriptor", (desc) ? desc->abi : 0,
+                  ELM_APP_ABI_VERSION);
+        goto cleanup;
+    }
+
+    if (desc->prepare && (desc->prepare() < 0)) {
+        elmprintf(LOGERR, "Unable to prepare plugin '%s'.", plugin->name);
+        goto cleanup;
+    }
+
+    plugin->desc        = desc;
+    plugin->app.display = desc->display;
+    plugin->app.reset   = desc->reset;
+
+    snprintf(name, sizeof(name), "plugin %s", plugin->name);
+    elm_trace_end(name, start);
+    elmprintf(LOGINFO, "Loaded plugin '%s' from '%s'.", plugin->name,
+              plugin->path);
+
+    return 0;
+
+cleanup:
+    dlclose(plugin->handle);
+
+    plugin->handle = NULL;
+
+    return -2;
+}
+
+/* ************************************************************************** */
+/* Load the lazy plugins. Runs on its own thread. */
+void * elm_plugin_load_thread(void *data)
+{
+    ElmPlugin *plugin;
+    GSList    *node;
+
+    for (node=Plugins; node; node=node->next)
+    {
+        plugin = node->data;
+
+        if (plugin->lazy && !plugin->handle && (elm_plugin_open(plugin) == 0)) {
+            g_idle_add(elm_plugin_ready, plugin);
+        }
+    }
+
+    return NULL;
+}
+
+/* ************************************************************************** */
+/* Hand a lazy plugin over to be displayed, from the main loop */
+gboolean elm_plugin_ready(gpointer data)
+{
+    ElmPlugin *plugin = data;
+
+    if (ReadyCallback) {
+        ReadyCallback(&plugin->app, ReadyData);
+    }
+
+    return G_SOURCE_REMOVE;
+}
+
+/* ************************************************************************** */
+/* Return the gravity of a plugin from the config file */
+ElmGravity elm_plugin_get_gravity(const char *group)
+{
+    static const struct
+    {
+        const char *name;
+        ElmGravity  gravity;
+    } gravities[] = {
+        { "top left",     ELM_GRAV_TOP_LEFT     },
+        { "top right",    ELM_GRAV_TOP_RIGHT    },
+        { "center",       ELM_GRAV_CENTER       },
+        { "bottom left",  ELM_GRAV_BOTTOM_LEFT  },
+        { "bottom right", ELM_GRAV_BOTTOM_RIGHT },
+        { NULL,           ELM_GRAV_NONE         }
+    };
+
+    const char *value = elm_conf_read(group, "Gravity");
+    size_t      i;
+
+    for (i=0; value && gravities[i].name; i++)
+    {
+        if (g_ascii_strcasecmp(value, gravities[i].name) == 0) {
+            return gravities[i].gravity;
+        }
+    }
+
+    return ELM_GRAV_TOP_LEFT;
+}
+
+/* ************************************************************************** */
+/* Return the offset of a plugin from the config file, or 0 if it is missing.
+ * Offsets can be negative, so the value is parsed here rather than with
+ * elm_conf_read_int(), whose errors are negative too. */
+int elm_plugin_get_pos(const char *group, const char *key)
+{
+    const char *value = elm_conf_read(group, key);
+    char       *end;
+    long        pos;
+
+    if (!value) {
+        return 0;
+    }
+
+    errno = 0;
+    pos   = strtol(value, &end, 10);
+
+    if ((end == value) || *end || (errno != 0) || (pos < INT_MIN)
+        || (pos > INT_MAX))
+    {
+        elmprintf(LOGWARN, "Ignoring invalid '%s' in group '%s': '%s'.", key,
+                  group, value);
+        return 0;
+    }
+
+    return pos;
+}
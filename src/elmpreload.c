@@ -0,0 +1,214 @@
+/* *****************************************************************************
+ * 
+ * Name:    elmpreload.c
+ * Author:  Gabriel Gonzalez
+ * Email:   gabeg@bu.edu
+ * License: The MIT License (MIT)
+ * 
+ * Description: Preload display-independent resources while X starts.
+ *              
+ * Notes: Nothing here needs the display, so it runs on worker threads while
+ *        Xorg starts up. The config file is parsed, the images named in the
+ *        [Images] group are decoded, the xsession catalogue is loaded, and
+ *        the plugins that are not lazy are loaded.
+ *        A background that is already in the background cache is not decoded.
+ *        The greeter waits for the workers before it is built and then uses
+ *        the results, so startup takes about as long as the slower of X and
+ *        the preload, instead of both.
+ * 
+ *        Results are only read after the workers have been joined, so they
+ *        need no locking. Anything that was not preloaded is loaded by the
+ *        caller as before.
+ * 
+ * *****************************************************************************
+ */
+
+/* Includes */
+#include "elmpreload.h"
+#include "elmbackground.h"
+#include "elmconf.h"
+#include "elmdef.h"
+#include "elmio.h"
+#include "elmplugin.h"
+#include "elmtrace.h"
+#include "elmxsession.h"
+#include <pthread.h>
+#include <string.h>
+
+/* Typedefs */
+typedef struct
+{
+    const char *key;
+    char       *path;
+    GdkPixbuf  *pixbuf;
+} ElmPreloadImage;
+
+/* Private functions */
+static void * elm_preload_images(void *data);
+static void * elm_preload_xsessions(void *data);
+static void * elm_preload_plugins(void *data);
+
+/* Private variables */
+static ElmPreloadImage Images[] = {
+    { "Background", NULL, NULL },
+    { "Username",   NULL, NULL },
+    { "Password",   NULL, NULL },
+    { NULL,         NULL, NULL }
+};
+
+static void * (*Jobs[])(void*) = {
+    elm_preload_images,
+    elm_preload_xsessions,
+    elm_preload_plugins,
+    NULL
+};
+
+static pthread_t Workers[sizeof(Jobs)/sizeof(*Jobs)];
+static int       Started[sizeof(Jobs)/sizeof(*Jobs)] = {0};
+static int       Running = 0;
+
+/* ************************************************************************** */
+/* Start the preload workers. A job whose thread cannot be started is run right
+ * away instead. */
+int elm_preload_start(void)
+{
+    elmprintf(LOGINFO, "Preloading resources.");
+
+    size_t i;
+
+    for (i=0; Jobs[i]; i++)
+    {
+        if (pthread_create(&Workers[i], NULL, Jobs[i], NULL) == 0) {
+            Started[i] = 1;
+            continue;
+        }
+
+        elmprintf(LOGWARN, "Unable to start preload worker '%lu'.", i);
+        Jobs[i](NULL);
+    }
+
+    Running = 1;
+
+    return 0;
+}
+
+/* ************************************************************************** */
+/* Wait for the preload workers to finish */
+void elm_preload_wait(void)
+{
+    if (!Running) {
+        return;
+    }
+
+    int64_t start = elm_trace_begin();
+    size_t  i;
+
+    for (i=0; Jobs[i]; i++)
+    {
+        if (Started[i]) {
+            pthread_join(Workers[i], NULL);
+            Started[i] = 0;
+        }
+    }
+
+    Running = 0;
+
+    elm_trace_end("preload_wait", start);
+}
+
+/* ************************************************************************** */
+/* Return a new reference to a preloaded image, or NULL if the image at this
+ * path was not preloaded */
+GdkPixbuf * elm_preload_get_pixbuf(const char *path)
+{
+    size_t i;
+
+    if (!path) {
+        return NULL;
+    }
+
+    elm_preload_wait();
+
+    for (i=0; Images[i].key; i++)
+    {
+        if (Images[i].pixbuf && (strcmp(Images[i].path, path) == 0)) {
+            return g_object_ref(Images[i].pixbuf);
+        }
+    }
+
+    return NULL;
+}
+
+/* ************************************************************************** */
+/* Parse the config file and decode the images it names */
+void * elm_preload_images(void *data)
+{
+    int64_t     start = elm_trace_begin();
+    const char *path;
+    GError     *err;
+    size_t      i;
+    int         width;
+    int         height;
+
+    elm_conf_load();
+
+    /* X is not up yet, so only a screen size from the config file is known */
+    width  = elm_conf_read_int("Main", "ScreenWidth");
+    height = elm_conf_read_int("Main", "ScreenHeight");
+
+    for (i=0; Images[i].key; i++)
+    {
+        if (!(path=elm_conf_read("Images", Images[i].key)) || !path[0]) {
+            continue;
+        }
+
+        /* A cached background is painted without decoding the image */
+        if ((strcmp(Images[i].key, "Background") == 0)
+            && elm_background_is_cached(path, width, height))
+        {
+            continue;
+        }
+
+        err = NULL;
+
+        g_clear_object(&Images[i].pixbuf);
+        g_free(Images[i].path);
+
+        Images[i].path   = g_strdup(path);
+        Images[i].pixbuf = gdk_pixbuf_new_from_file(path, &err);
+
+        if (err) {
+            elmprintf(LOGWARN, "Unable to preload image '%s': %s.",
+                      path, err->message);
+            g_error_free(err);
+        }
+    }
+
+    elm_trace_end("preload_images", start);
+
+    return NULL;
+}
+
+/* ************************************************************************** */
+/* Load the catalogue of installed xsessions */
+void * elm_preload_xsessions(void *data)
+{
+    int64_t start = elm_trace_begin();
+
+    elm_xsession_load();
+    elm_trace_end("preload_xsessions", start);
+
+    return NULL;
+}
+
+/* ************************************************************************** */
+/* Load and prepare the plugins that are not lazy */
+void * elm_preload_plugins(void *data)
+{
+    int64_t start = elm_trace_begin();
+
+    elm_plugin_load();
+    elm_trace_end("preload_plugins", start);
+
+    return NULL;
+}
@@ -108,20 +108,23 @@ int elm_session_auth(void)
 }
 
 /* ************************************************************************** */
-/* Login to user session */
+/* Login to user session. Return the PID of the session, it is over when that
+ * process exits. */
 int elm_session_login(void)
 {
     elmprintf(LOGINFO, "Preparing to login to user session.");
 
+    int pid;
+
     if (!elm_session_exists("login to user session")) {
         return -1;
     }
 
-    if (elm_pam_login() < 0) {
+    if ((pid=elm_pam_login()) < 0) {
         return -2;
     }
 
-    return 0;
+    return pid;
 }
 
 /* ************************************************************************** */
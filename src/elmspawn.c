@@ -0,0 +1,285 @@
+/* *****************************************************************************
+ * 
+ * Name:    elmspawn.c
+ * Author:  Gabriel Gonzalez
+ * Email:   gabeg@bu.edu
+ * License: The MIT License (MIT)
+ * 
+ * Description: Launch helper programs without copying the greeter.
+ *              
+ * Notes: A fork() copies the page tables of the whole greeter, GTK included,
+ *        only for the child to throw them away at exec. Programs that run
+ *        with the identity of the greeter are started with posix_spawn(),
+ *        which does not copy anything. Programs that need a new identity,
+ *        directory, or session are started with vfork(), where the child
+ *        borrows the memory of the greeter until it runs exec.
+ * 
+ *        The vfork() child shares memory with the greeter, so it only makes
+ *        system calls. Everything else, finding the program and building its
+ *        environment included, is done by the caller beforehand. The IDs are
+ *        changed with raw system calls, because the libc wrappers would try to
+ *        change the IDs of every thread of the greeter as well.
+ * 
+ * *****************************************************************************
+ */
+
+/* Includes */
+#include "elmspawn.h"
+#include "elmdef.h"
+#include "elmio.h"
+#include "elmsupervisor.h"
+#include <errno.h>
+#include <glib.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+
+/* Defines */
+/* On i386 and 32-bit ARM the plain calls take 16-bit IDs */
+#ifdef SYS_setgroups32
+#define ELM_SYS_SETGROUPS SYS_setgroups32
+#else
+#define ELM_SYS_SETGROUPS SYS_setgroups
+#endif
+
+#ifdef SYS_setresgid32
+#define ELM_SYS_SETRESGID SYS_setresgid32
+#else
+#define ELM_SYS_SETRESGID SYS_setresgid
+#endif
+
+#ifdef SYS_setresuid32
+#define ELM_SYS_SETRESUID SYS_setresuid32
+#else
+#define ELM_SYS_SETRESUID SYS_setresuid
+#endif
+
+/* Private functions */
+static pid_t elm_spawn_posix(const ElmSpawnAttr *attr, const char *path,
+                             char *const envp[], const sigset_t *mask);
+static pid_t elm_spawn_vfork(const ElmSpawnAttr *attr, const char *path,
+                             char *const envp[], const sigset_t *mask);
+static int   elm_spawn_find(const char *file, char *const envp[], char *path,
+                            size_t size);
+static long  elm_spawn_get_rss(void);
+
+/* Private variables */
+extern char **environ;
+
+/* ************************************************************************** */
+/* Fill in the attributes to run a program as the greeter does */
+void elm_spawn_attr_init(ElmSpawnAttr *attr, char *const argv[])
+{
+    memset(attr, 0, sizeof(*attr));
+
+    attr->argv = argv;
+    attr->uid  = ELM_SPAWN_NO_ID;
+    attr->gid  = ELM_SPAWN_NO_ID;
+}
+
+/* ************************************************************************** */
+/* Start a program. Return its PID, once it has been replaced by the program,
+ * or a negative number if it could not be run. */
+pid_t elm_spawn(const ElmSpawnAttr *attr)
+{
+    char *const *envp  = (attr->envp) ? attr->envp : environ;
+    char         path[ELM_MAX_PATH_SIZE];
+    sigset_t     mask;
+    gint64       start = g_get_monotonic_time();
+    pid_t        pid;
+
+    if (elm_spawn_find(attr->argv[0], envp, path, sizeof(path)) < 0) {
+        elmprintf(LOGERR, "Unable to find '%s'.", attr->argv[0]);
+        return -1;
+    }
+
+    elm_supervisor_get_signals(&mask);
+
+    if (attr->cwd || attr->groups || (attr->uid != ELM_SPAWN_NO_ID)
+        || (attr->gid != ELM_SPAWN_NO_ID) || (attr->flags & ELM_SPAWN_SETSID))
+    {
+        pid = elm_spawn_vfork(attr, path, envp, &mask);
+    }
+    else {
+        pid = elm_spawn_posix(attr, path, envp, &mask);
+    }
+
+    if (pid < 0) {
+        return -2;
+    }
+
+    elmprintf(LOGINFO, "Running '%s' (pid=%d), spawned in %.2f ms from %ld kB.",
+              path, pid, (g_get_monotonic_time()-start) / 1000.0,
+              elm_spawn_get_rss());
+
+    return pid;
+}
+
+/* ************************************************************************** */
+/* Start a program with the identity of the greeter */
+pid_t elm_spawn_posix(const ElmSpawnAttr *attr, const char *path,
+                      char *const envp[], const sigset_t *mask)
+{
+    posix_spawnattr_t spawnattr;
+    short             flags = POSIX_SPAWN_SETSIGMASK;
+    pid_t             pid;
+    int               err;
+
+    if (attr->flags & ELM_SPAWN_SETPGID) {
+        flags |= POSIX_SPAWN_SETPGROUP;
+    }
+
+    posix_spawnattr_init(&spawnattr);
+    posix_spawnattr_setflags(&spawnattr, flags);
+    posix_spawnattr_setsigmask(&spawnattr, mask);
+    posix_spawnattr_setpgroup(&spawnattr, 0);
+
+    err = posix_spawn(&pid, path, NULL, &spawnattr, attr->argv, envp);
+
+    posix_spawnattr_destroy(&spawnattr);
+
+    if (err) {
+        errno = err;
+        elmprintf(LOGERRNO, "%s '%s'", "Error trying to run", path);
+        return -1;
+    }
+
+    return pid;
+}
+
+/* ************************************************************************** */
+/* Start a program with a new identity, directory, or session. The child writes
+ * the errno of a failed step where the greeter can read it. */
+pid_t elm_spawn_vfork(const ElmSpawnAttr *attr, const char *path,
+                      char *const envp[], const sigset_t *mask)
+{
+    volatile int err = 0;
+    pid_t        pid;
+
+    switch ((pid=vfork()))
+    {
+    case 0:
+        sigprocmask(SIG_SETMASK, mask, NULL);
+
+        if ((attr->flags & ELM_SPAWN_SETSID) && (setsid() < 0)) {
+            goto failed;
+        }
+
+        if ((attr->flags & ELM_SPAWN_SETPGID) && (setpgid(0, 0) < 0)) {
+            goto failed;
+        }
+
+        if (attr->groups
+            && (syscall(ELM_SYS_SETGROUPS, attr->ngroups,
+                        attr->groups) < 0))
+        {
+            goto failed;
+        }
+
+        if ((attr->gid != ELM_SPAWN_NO_ID)
+            && (syscall(ELM_SYS_SETRESGID, attr->gid, attr->gid,
+                        attr->gid) < 0))
+        {
+            goto failed;
+        }
+
+        if ((attr->uid != ELM_SPAWN_NO_ID)
+            && (syscall(ELM_SYS_SETRESUID, attr->uid, attr->uid,
+                        attr->uid) < 0))
+        {
+            goto failed;
+        }
+
+        if (attr->cwd && (chdir(attr->cwd) < 0)) {
+            goto failed;
+        }
+
+        execve(path, attr->argv, envp);
+
+    failed:
+        err = errno;
+        _exit(127);
+    case -1:
+        elmprintf(LOGERRNO, "%s '%s'", "Error during vfork to start", path);
+        return -1;
+    default:
+        break;
+    }
+
+    /* The child has already run exec or exited by now */
+    if (err) {
+        waitpid(pid, NULL, 0);
+
+        errno = err;
+        elmprintf(LOGERRNO, "%s '%s'", "Error trying to run", path);
+        return -2;
+    }
+
+    return pid;
+}
+
+/* ************************************************************************** */
+/* Find a program in the PATH of the environment it runs with */
+int elm_spawn_find(const char *file, char *const envp[], char *path,
+                   size_t size)
+{
+    const char *dirs = NULL;
+    const char *end;
+    int         i;
+
+    if (strchr(file, '/')) {
+        snprintf(path, size, "%s", file);
+        return 0;
+    }
+
+    for (i=0; envp[i]; i++) {
+        if (strncmp(envp[i], "PATH=", 5) == 0) {
+            dirs = envp[i]+5;
+            break;
+        }
+    }
+
+    if (!dirs) {
+        dirs = "/usr/local/bin:/usr/bin:/bin";
+    }
+
+    for ( ; *dirs; dirs=(*end) ? end+1 : end) {
+        if (!(end=strchr(dirs, ':'))) {
+            end = dirs+strlen(dirs);
+        }
+
+        snprintf(path, size, "%.*s/%s", (int)(end-dirs), dirs, file);
+
+        if (access(path, X_OK) == 0) {
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+/* ************************************************************************** */
+/* Return the resident memory of the greeter, in kB */
+long elm_spawn_get_rss(void)
+{
+    FILE *stream = fopen("/proc/self/statm", "r");
+    long  size   = 0;
+    long  rss    = 0;
+
+    if (!stream) {
+        return -1;
+    }
+
+    if (fscanf(stream, "%ld %ld", &size, &rss) != 2) {
+        rss = -1;
+    }
+
+    fclose(stream);
+
+    return (rss < 0) ? rss : rss * (sysconf(_SC_PAGESIZE) / 1024);
+}
@@ -33,7 +33,7 @@ int elm_std_execvp(char *file, char *const argv[])
 /* Set environment variables */
 int elm_std_setenv(char *name, char *value)
 {
-    elmprintf(LOGINFO, "Setting environment variable: '%s=%s'.", name, value);
+    elmprintf(LOGDEBUG, "Setting environment variable: '%s=%s'.", name, value);
 
     if (setenv(name, value, 1) < 0) {
         elmprintf(LOGERRNO, "%s '%s=%s'",
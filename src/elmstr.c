@@ -7,7 +7,12 @@
  * 
  * Description: Useful string functions.
  *              
- * Notes: None.
+ * Notes: Desktop entries are parsed in place, in a single pass over the
+ *        [Desktop Entry] group. Files that fit on the stack are read, which
+ *        measured faster than mapping them, and larger ones are mapped.
+ *        Values are only copied out, unescaped, once the best ones have been
+ *        found. Keys match exactly, so 'TryExec' is not mistaken for 'Exec',
+ *        nor 'GenericName' for 'Name'.
  * 
  * -----------------------------------------------------------------------------
  */
@@ -17,10 +22,23 @@
 #include "elmdef.h"
 #include "elmio.h"
 #include <ctype.h>
+#include <fcntl.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <string.h>
 #include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/* Private functions */
+static int    elm_str_parse_desktop_entry(const char *data, size_t size,
+                                          const char *locale,
+                                          ElmStrDesktopEntry *entry);
+static int    elm_str_match_locale(const char *key, size_t length,
+                                   const char *locale);
+static int    elm_str_is_true(const char *value, size_t length);
+static char * elm_str_unescape(const char *value, size_t length);
+static void   elm_str_strip_field_codes(char *exec);
 
 /* -------------------------------------------------------------------------- */
 /* Copy string */
@@ -108,59 +126,385 @@ char * elm_str_readline(char *file)
 }
 
 /* -------------------------------------------------------------------------- */
-/* Return the first line that matches the specified substring */
-char * elm_str_findline(char *file, char *substring)
+/* Strip trailing newline */
+char * elm_str_strip(char *string)
 {
-    FILE *fhandle = NULL;
-    char *read    = NULL;
+    size_t  size = strlen(string);
+    char   *end;
 
-    /* Make sure file can be read */
-    if (access(file, R_OK)) {
-        return NULL;
+    if (!size) {
+        return string;
     }
 
-    if (!(fhandle=fopen(file, "r"))) {
-        return NULL;
+    for (end=string+size-1; (end >= string) && isspace(*end); end--) {}
+
+    *(end+1) = '\0';
+
+    for ( ; *string && isspace(*string); string++) {}
+
+    return string;
+}
+
+/* -------------------------------------------------------------------------- */
+/* Read the [Desktop Entry] group of a desktop file. The name is localized for
+ * a locale such as 'fr_CA.UTF-8@euro', or NULL for none. The field codes are
+ * removed from the command. TryExec is not looked up here; the caller does
+ * that whenever its answer may have changed. Return 0, or a negative number
+ * if the file cannot be read or lacks a name or command. */
+int elm_str_read_desktop_entry(const char *file, const char *locale,
+                               ElmStrDesktopEntry *entry)
+{
+    struct stat  info;
+    char         buf[ELM_MAX_DESKTOP_SIZE];
+    void        *data   = MAP_FAILED;
+    size_t       size   = 0;
+    ssize_t      nbytes = 1;
+    int          fd;
+    int          status;
+
+    memset(entry, 0, sizeof(*entry));
+
+    if ((fd=open(file, (O_RDONLY | O_CLOEXEC))) < 0) {
+        return -1;
     }
 
-    /* Read file */
-    char  line[ELM_MAX_PATH_SIZE] = {0};
-    char *strip;
+    if ((fstat(fd, &info) < 0) || (info.st_size <= 0)) {
+        close(fd);
+        return -2;
+    }
 
-    while (fgets(line, sizeof(line), fhandle)) {
-        strip = elm_str_strip(line);
+    /* Small files are cheaper to read than to map */
+    if ((size_t)info.st_size <= sizeof(buf)) {
+        while ((size < sizeof(buf))
+               && ((nbytes=read(fd, buf+size, sizeof(buf)-size)) > 0))
+        {
+            size += nbytes;
+        }
+    }
+    else {
+        size = info.st_size;
+        data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
 
-        /* Match found */
-        if (strstr(strip, substring)) {
-            if (!(read=elm_str_copy(strip))) {
-                elmprintf(LOGERR, "Unable to read line '%s'", strip);
+    close(fd);
+
+    if ((nbytes < 0) || ((size > sizeof(buf)) && (data == MAP_FAILED))) {
+        elmprintf(LOGERRNO, "%s '%s'", "Unable to read desktop file", file);
+        return -3;
+    }
+
+    if (data == MAP_FAILED) {
+        status = elm_str_parse_desktop_entry(buf, size, locale, entry);
+    }
+    else {
+        status = elm_str_parse_desktop_entry(data, size, locale, entry);
+        munmap(data, size);
+    }
+
+    if (status < 0) {
+        elm_str_free_desktop_entry(entry);
+        return -4;
+    }
+
+    return 0;
+}
+
+/* -------------------------------------------------------------------------- */
+/* Free the strings of a desktop entry */
+void elm_str_free_desktop_entry(ElmStrDesktopEntry *entry)
+{
+    free(entry->name);
+    free(entry->exec);
+    free(entry->tryexec);
+
+    entry->name    = NULL;
+    entry->exec    = NULL;
+    entry->tryexec = NULL;
+}
+
+/* -------------------------------------------------------------------------- */
+/* Check if a program can be run. A full path takes a single faccessat(), a
+ * name is looked for in the PATH. */
+int elm_str_is_executable(const char *file)
+{
+    const char *dirs = getenv("PATH");
+    const char *end;
+    char        path[ELM_MAX_PATH_SIZE];
+
+    if (strchr(file, '/')) {
+        return (faccessat(AT_FDCWD, file, X_OK, AT_EACCESS) == 0);
+    }
+
+    if (!dirs) {
+        dirs = "/usr/local/bin:/usr/bin:/bin";
+    }
+
+    for ( ; *dirs; dirs=(*end) ? end+1 : end) {
+        if (!(end=strchr(dirs, ':'))) {
+            end = dirs+strlen(dirs);
+        }
+
+        snprintf(path, sizeof(path), "%.*s/%s", (int)(end-dirs), dirs, file);
+
+        if (faccessat(AT_FDCWD, path, X_OK, AT_EACCESS) == 0) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/* -------------------------------------------------------------------------- */
+/* Parse the [Desktop Entry] group of a desktop file. Values are kept as
+ * pointers into the data until the end. */
+int elm_str_parse_desktop_entry(const char *data, size_t size,
+                                const char *locale, ElmStrDesktopEntry *entry)
+{
+    static const char  group[] = "[Desktop Entry]";
+    const char        *end     = data+size;
+    const char        *line;
+    const char        *eol;
+    const char        *key;
+    const char        *keyend;
+    const char        *value;
+    const char        *name    = NULL;
+    const char        *exec    = NULL;
+    const char        *tryexec = NULL;
+    size_t             namelen = 0;
+    size_t             execlen = 0;
+    size_t             trylen  = 0;
+    size_t             length;
+    int                rank    = -1;
+    int                r;
+    int                ingroup = 0;
+
+    for (line=data; line < end; line=eol+1)
+    {
+        if (!(eol=memchr(line, '\n', end-line))) {
+            eol = end;
+        }
+
+        for ( ; (line < eol) && isspace((unsigned char)*line); line++) {}
+
+        if ((line == eol) || (*line == '#')) {
+            continue;
+        }
+
+        /* Group header. The desktop entry group comes first, so the next
+         * group ends the parse. */
+        if (*line == '[') {
+            if (ingroup) {
+                break;
             }
 
+            ingroup = ((size_t)(eol-line) >= sizeof(group)-1)
+                && (memcmp(line, group, sizeof(group)-1) == 0);
+            continue;
+        }
+
+        if (!ingroup || !(value=memchr(line, '=', eol-line))) {
+            continue;
+        }
+
+        /* Split 'Key[locale] = value' */
+        key = line;
+
+        for (keyend=value; (keyend > key) && isspace((unsigned char)keyend[-1]);
+             keyend--) {}
+
+        for (value++; (value < eol) && isspace((unsigned char)*value);
+             value++) {}
+
+        for (length=eol-value;
+             length && isspace((unsigned char)value[length-1]); length--) {}
+
+        if (((keyend-key) == 4) && (memcmp(key, "Exec", 4) == 0)) {
+            exec    = value;
+            execlen = length;
+        }
+        else if (((keyend-key) == 7) && (memcmp(key, "TryExec", 7) == 0)) {
+            tryexec = value;
+            trylen  = length;
+        }
+        else if (((keyend-key) == 6) && (memcmp(key, "Hidden", 6) == 0)) {
+            entry->hidden |= elm_str_is_true(value, length);
+        }
+        else if (((keyend-key) == 9) && (memcmp(key, "NoDisplay", 9) == 0)) {
+            entry->hidden |= elm_str_is_true(value, length);
+        }
+        else if (((keyend-key) >= 4) && (memcmp(key, "Name", 4) == 0)) {
+            if ((keyend-key) == 4) {
+                r = 0;
+            }
+            else if ((key[4] == '[') && (keyend[-1] == ']')) {
+                r = elm_str_match_locale(key+5, keyend-key-6, locale);
+            }
+            else {
+                continue;
+            }
+
+            if (r > rank) {
+                rank    = r;
+                name    = value;
+                namelen = length;
+            }
+        }
+    }
+
+    if (!name || !exec || !namelen || !execlen) {
+        return -1;
+    }
+
+    entry->name    = elm_str_unescape(name, namelen);
+    entry->exec    = elm_str_unescape(exec, execlen);
+    entry->tryexec = (tryexec && trylen) ? elm_str_unescape(tryexec, trylen)
+                                         : NULL;
+
+    if (!entry->name || !entry->exec || (tryexec && trylen && !entry->tryexec)) {
+        return -2;
+    }
+
+    elm_str_strip_field_codes(entry->exec);
+
+    return 0;
+}
+
+/* -------------------------------------------------------------------------- */
+/* Return how well the locale of a key matches a locale, from 1 for the
+ * language alone up to 4 for language, country, and modifier. Return -1 if it
+ * does not match. */
+int elm_str_match_locale(const char *key, size_t length, const char *locale)
+{
+    char        lang[ELM_MAX_OPT_SIZE];
+    char        want[ELM_MAX_OPT_SIZE*2];
+    const char *country;
+    const char *modifier;
+    size_t      langlen;
+    size_t      countrylen;
+    int         i;
+
+    if (!locale || !*locale || (strlen(locale) >= sizeof(lang))) {
+        return -1;
+    }
+
+    /* lang_COUNTRY.ENCODING@MODIFIER, without the encoding */
+    langlen    = strcspn(locale, "_.@");
+    country    = (locale[langlen] == '_') ? locale+langlen+1 : NULL;
+    countrylen = (country) ? strcspn(country, ".@") : 0;
+    modifier   = strchr(locale, '@');
+
+    snprintf(lang, sizeof(lang), "%.*s", (int)langlen, locale);
+
+    for (i=4; i > 0; i--)
+    {
+        if (((i == 4) && (!country || !modifier))
+            || ((i == 3) && !country)
+            || ((i == 2) && !modifier))
+        {
+            continue;
+        }
+
+        switch (i) {
+        case 4:
+            snprintf(want, sizeof(want), "%s_%.*s%s", lang, (int)countrylen,
+                     country, modifier);
+            break;
+        case 3:
+            snprintf(want, sizeof(want), "%s_%.*s", lang, (int)countrylen,
+                     country);
             break;
+        case 2:
+            snprintf(want, sizeof(want), "%s%s", lang, modifier);
+            break;
+        default:
+            snprintf(want, sizeof(want), "%s", lang);
+            break;
+        }
+
+        if ((strlen(want) == length) && (memcmp(want, key, length) == 0)) {
+            return i;
         }
     }
 
-    fclose(fhandle);
+    return -1;
+}
 
-    return read;
+/* -------------------------------------------------------------------------- */
+/* Check if a boolean value is true */
+int elm_str_is_true(const char *value, size_t length)
+{
+    return (length == 4) && (memcmp(value, "true", 4) == 0);
 }
 
 /* -------------------------------------------------------------------------- */
-/* Strip trailing newline */
-char * elm_str_strip(char *string)
+/* Copy a value, replacing the escape sequences \s, \n, \t, \r, and \\ */
+char * elm_str_unescape(const char *value, size_t length)
 {
-    size_t  size = strlen(string);
-    char   *end;
+    char   *copy;
+    char   *out;
+    size_t  i;
 
-    if (!size) {
-        return string;
+    if (!(copy=malloc(length+1))) {
+        elmprintf(LOGERRNO, "Unable to allocate memory for desktop entry");
+        return NULL;
     }
 
-    for (end=string+size-1; (end >= string) && isspace(*end); end--) {}
+    for (i=0, out=copy; i < length; i++, out++)
+    {
+        if ((value[i] != '\\') || (i+1 == length)) {
+            *out = value[i];
+            continue;
+        }
 
-    *(end+1) = '\0';
+        switch (value[++i]) {
+        case 's':
+            *out = ' ';
+            break;
+        case 'n':
+            *out = '\n';
+            break;
+        case 't':
+            *out = '\t';
+            break;
+        case 'r':
+            *out = '\r';
+            break;
+        default:
+            *out = value[i];
+            break;
+        }
+    }
 
-    for ( ; *string && isspace(*string); string++) {}
+    *out = '\0';
 
-    return string;
+    return copy;
+}
+
+/* -------------------------------------------------------------------------- */
+/* Remove the field codes from a command, in place. '%%' becomes '%'. */
+void elm_str_strip_field_codes(char *exec)
+{
+    char *in;
+    char *out;
+
+    for (in=exec, out=exec; *in; in++)
+    {
+        if (*in != '%') {
+            *out++ = *in;
+            continue;
+        }
+
+        if (*(in+1) == '%') {
+            *out++ = '%';
+        }
+
+        if (*(in+1)) {
+            in++;
+        }
+    }
+
+    /* Drop the space that was left behind by a trailing field code */
+    for ( ; (out > exec) && isspace((unsigned char)out[-1]); out--) {}
+
+    *out = '\0';
 }
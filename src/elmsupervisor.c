@@ -0,0 +1,469 @@
+/* *****************************************************************************
+ * 
+ * Name:    elmsupervisor.c
+ * Author:  Gabriel Gonzalez
+ * Email:   gabeg@bu.edu
+ * License: The MIT License (MIT)
+ * 
+ * Description: Watch child processes and signals from the main loop.
+ *              
+ * Notes: Each watched child gets a pidfd, which becomes readable the moment
+ *        the child exits, added as a source to the GLib main loop. SIGCHLD
+ *        and the caught signals are blocked and read from a signalfd in the
+ *        main loop as well, so their handlers are free to log or call into
+ *        GTK. On kernels without pidfd support, watched children are reaped
+ *        when SIGCHLD arrives instead.
+ * 
+ *        Only watched children are ever reaped here, a child that someone else
+ *        waits for is left alone.
+ * 
+ * *****************************************************************************
+ */
+
+/* Includes */
+#include "elmsupervisor.h"
+#include "elmdef.h"
+#include "elmio.h"
+#include <errno.h>
+#include <glib.h>
+#include <glib-unix.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+
+/* Typedefs */
+typedef struct
+{
+    pid_t              pid;
+    int                pidfd;
+    guint              source;
+    char               name[ELM_MAX_OPT_SIZE];
+    ElmSupervisorExit  callback;
+    void              *data;
+} ElmSupervisorChild;
+
+/* Private functions */
+static void                 elm_supervisor_add(ElmSupervisorChild *child);
+static ElmSupervisorChild * elm_supervisor_take(pid_t pid);
+static void                 elm_supervisor_reap(ElmSupervisorChild *child);
+static void                 elm_supervisor_reap_all(void);
+static gboolean             elm_supervisor_reap_idle(gpointer data);
+static int                  elm_supervisor_has_exited(pid_t pid);
+static int                  elm_supervisor_wait_signal(pid_t pid, int timeout);
+static void                 elm_supervisor_log(ElmSupervisorChild *child,
+                                               int status,
+                                               const struct rusage *usage);
+static int                  elm_supervisor_pidfd_open(pid_t pid);
+static gboolean             elm_supervisor_pidfd_ready(gint fd,
+                                                       GIOCondition condition,
+                                                       gpointer data);
+static gboolean             elm_supervisor_signal_ready(gint fd,
+                                                        GIOCondition condition,
+                                                        gpointer data);
+
+/* Private variables */
+static GSList              *Children = NULL;
+static pthread_mutex_t      Mutex    = PTHREAD_MUTEX_INITIALIZER;
+static ElmSupervisorSignal  Handlers[NSIG];
+static sigset_t             Mask;
+static sigset_t             OldMask;
+static int                  SignalFd = -1;
+
+/* ************************************************************************** */
+/* Block SIGCHLD and read it from a signalfd in the main loop. Must be called
+ * from the main thread before any other thread is created, so that every
+ * thread inherits the signal mask. */
+int elm_supervisor_init(void)
+{
+    if (SignalFd >= 0) {
+        return 0;
+    }
+
+    sigemptyset(&Mask);
+    sigaddset(&Mask, SIGCHLD);
+
+    if (pthread_sigmask(SIG_BLOCK, &Mask, &OldMask) != 0) {
+        elmprintf(LOGERR, "Unable to block 'SIGCHLD'.");
+        return -1;
+    }
+
+    if ((SignalFd=signalfd(-1, &Mask, SFD_NONBLOCK | SFD_CLOEXEC)) < 0) {
+        elmprintf(LOGERRNO, "Unable to create signal file descriptor");
+        return -2;
+    }
+
+    g_unix_fd_add(SignalFd, G_IO_IN, elm_supervisor_signal_ready, NULL);
+
+    return 0;
+}
+
+/* ************************************************************************** */
+/* Handle a signal from the main loop instead of an asynchronous handler */
+int elm_supervisor_catch(int sig, ElmSupervisorSignal handler)
+{
+    sigset_t set;
+
+    if ((SignalFd < 0) || (sig <= 0) || (sig >= NSIG) || (sig == SIGCHLD)) {
+        return -1;
+    }
+
+    sigemptyset(&set);
+    sigaddset(&set, sig);
+    sigaddset(&Mask, sig);
+
+    Handlers[sig] = handler;
+
+    if (pthread_sigmask(SIG_BLOCK, &set, NULL) != 0) {
+        elmprintf(LOGERR, "Unable to block signal '%d'.", sig);
+        return -2;
+    }
+
+    if (signalfd(SignalFd, &Mask, 0) < 0) {
+        elmprintf(LOGERRNO, "%s '%d'", "Unable to catch signal", sig);
+        return -3;
+    }
+
+    return 0;
+}
+
+/* ************************************************************************** */
+/* Watch a child process. When it exits, it is reaped, its resource usage is
+ * logged and the callback, if any, is run from the main loop. May be called
+ * from any thread. */
+int elm_supervisor_watch(pid_t pid, const char *name,
+                         ElmSupervisorExit callback, void *data)
+{
+    ElmSupervisorChild *child;
+
+    if (pid <= 0) {
+        return -1;
+    }
+
+    child           = g_new0(ElmSupervisorChild, 1);
+    child->pid      = pid;
+    child->pidfd    = elm_supervisor_pidfd_open(pid);
+    child->callback = callback;
+    child->data     = data;
+
+    snprintf(child->name, sizeof(child->name), "%s", name ? name : "child");
+    elm_supervisor_add(child);
+
+    return 0;
+}
+
+/* ************************************************************************** */
+/* Wait for a child to exit and reap it. The timeout is in milliseconds, and
+ * is infinite when negative. A watched child is taken out of the main loop
+ * while waiting, and put back if it does not exit in time. Return 0 when the
+ * child exited. Must be called from the main thread. */
+int elm_supervisor_wait(pid_t pid, int timeout)
+{
+    ElmSupervisorChild *child;
+    struct pollfd       pfd;
+    int                 exited;
+
+    if (pid <= 0) {
+        return -1;
+    }
+
+    if ((child=elm_supervisor_take(pid))) {
+        if (child->source) {
+            g_source_remove(child->source);
+            child->source = 0;
+        }
+    }
+    else {
+        child        = g_new0(ElmSupervisorChild, 1);
+        child->pid   = pid;
+        child->pidfd = elm_supervisor_pidfd_open(pid);
+
+        snprintf(child->name, sizeof(child->name), "%s", "child");
+    }
+
+    /* The pidfd is readable as soon as the child exits */
+    if (child->pidfd >= 0) {
+        pfd.fd     = child->pidfd;
+        pfd.events = POLLIN;
+
+        while (((exited=poll(&pfd, 1, timeout)) < 0) && (errno == EINTR)) {}
+
+        exited = (exited > 0);
+    }
+    else {
+        exited = elm_supervisor_wait_signal(pid, timeout);
+    }
+
+    if (!exited) {
+        elm_supervisor_add(child);
+        return -2;
+    }
+
+    elm_supervisor_reap(child);
+
+    return 0;
+}
+
+/* ************************************************************************** */
+/* Return the signal mask from before the supervisor started, which is the one
+ * a child starts with */
+void elm_supervisor_get_signals(sigset_t *mask)
+{
+    if (SignalFd >= 0) {
+        *mask = OldMask;
+    }
+    else {
+        pthread_sigmask(SIG_SETMASK, NULL, mask);
+    }
+}
+
+/* ************************************************************************** */
+/* Add a child to the watch list and the main loop. The lock is held while the
+ * source is added so that it cannot run before the child is listed. */
+void elm_supervisor_add(ElmSupervisorChild *child)
+{
+    pthread_mutex_lock(&Mutex);
+
+    Children = g_slist_prepend(Children, child);
+
+    if (child->pidfd >= 0) {
+        child->source = g_unix_fd_add(child->pidfd, G_IO_IN,
+                                      elm_supervisor_pidfd_ready, child);
+    }
+
+    pthread_mutex_unlock(&Mutex);
+
+    /* Without a pidfd, the SIGCHLD may already have been read */
+    if (child->pidfd < 0) {
+        g_idle_add(elm_supervisor_reap_idle, NULL);
+    }
+}
+
+/* ************************************************************************** */
+/* Remove a child from the watch list and return it */
+ElmSupervisorChild * elm_supervisor_take(pid_t pid)
+{
+    ElmSupervisorChild *child = NULL;
+    GSList             *node;
+
+    pthread_mutex_lock(&Mutex);
+
+    for (node=Children; node; node=node->next) {
+        if (((ElmSupervisorChild*)node->data)->pid == pid) {
+            child    = node->data;
+            Children = g_slist_delete_link(Children, node);
+            break;
+        }
+    }
+
+    pthread_mutex_unlock(&Mutex);
+
+    return child;
+}
+
+/* ************************************************************************** */
+/* Reap a child that exited, log how it ended and run its callback. The child
+ * is freed. */
+void elm_supervisor_reap(ElmSupervisorChild *child)
+{
+    struct rusage usage  = {0};
+    int           status = 0;
+
+    if (wait4(child->pid, &status, 0, &usage) < 0) {
+        elmprintf(LOGERRNO, "%s '%s' (pid=%d)", "Unable to reap", child->name,
+                  child->pid);
+    }
+    else {
+        elm_supervisor_log(child, status, &usage);
+
+        if (child->callback) {
+            child->callback(child->pid, status, &usage, child->data);
+        }
+    }
+
+    if (child->pidfd >= 0) {
+        close(child->pidfd);
+    }
+
+    g_free(child);
+}
+
+/* ************************************************************************** */
+/* Reap every watched child without a pidfd that exited */
+void elm_supervisor_reap_all(void)
+{
+    ElmSupervisorChild *child;
+    GSList             *exited = NULL;
+    GSList             *node;
+    GSList             *next;
+
+    pthread_mutex_lock(&Mutex);
+
+    for (node=Children; node; node=next) {
+        next  = node->next;
+        child = node->data;
+
+        if ((child->pidfd < 0) && elm_supervisor_has_exited(child->pid)) {
+            Children = g_slist_delete_link(Children, node);
+            exited   = g_slist_prepend(exited, child);
+        }
+    }
+
+    pthread_mutex_unlock(&Mutex);
+
+    for (node=exited; node; node=node->next) {
+        elm_supervisor_reap(node->data);
+    }
+
+    g_slist_free(exited);
+}
+
+/* ************************************************************************** */
+/* Reap the watched children that exited before they were listed */
+gboolean elm_supervisor_reap_idle(gpointer data)
+{
+    elm_supervisor_reap_all();
+
+    return G_SOURCE_REMOVE;
+}
+
+/* ************************************************************************** */
+/* Check if a child exited, without reaping it */
+int elm_supervisor_has_exited(pid_t pid)
+{
+    siginfo_t info;
+
+    info.si_pid = 0;
+
+    if (waitid(P_PID, pid, &info, WEXITED | WNOHANG | WNOWAIT) < 0) {
+        return 0;
+    }
+
+    return (info.si_pid == pid);
+}
+
+/* ************************************************************************** */
+/* Wait for a child to exit by waiting for SIGCHLD, when there is no pidfd.
+ * Return 1 when the child exited. */
+int elm_supervisor_wait_signal(pid_t pid, int timeout)
+{
+    struct timespec  ts;
+    sigset_t         set;
+    gint64           deadline = g_get_monotonic_time() + (gint64)timeout*1000;
+    gint64           remaining;
+
+    sigemptyset(&set);
+    sigaddset(&set, SIGCHLD);
+
+    while (!elm_supervisor_has_exited(pid))
+    {
+        if (timeout < 0) {
+            sigwaitinfo(&set, NULL);
+            continue;
+        }
+
+        if ((remaining=deadline-g_get_monotonic_time()) <= 0) {
+            return 0;
+        }
+
+        ts.tv_sec  = remaining / G_USEC_PER_SEC;
+        ts.tv_nsec = (remaining % G_USEC_PER_SEC) * 1000;
+
+        sigtimedwait(&set, NULL, &ts);
+    }
+
+    return 1;
+}
+
+/* ************************************************************************** */
+/* Log how a child ended and the resources it used */
+void elm_supervisor_log(ElmSupervisorChild *child, int status,
+                        const struct rusage *usage)
+{
+    char   reason[ELM_MAX_MSG_SIZE];
+    double user   = usage->ru_utime.tv_sec + usage->ru_utime.tv_usec/1e6;
+    double system = usage->ru_stime.tv_sec + usage->ru_stime.tv_usec/1e6;
+
+    if (WIFEXITED(status)) {
+        snprintf(reason, sizeof(reason), "exited with status '%d'",
+                 WEXITSTATUS(status));
+    }
+    else if (WIFSIGNALED(status)) {
+        snprintf(reason, sizeof(reason), "was killed by signal '%d'",
+                 WTERMSIG(status));
+    }
+    else {
+        snprintf(reason, sizeof(reason), "ended with status '%d'", status);
+    }
+
+    elmprintf(LOGINFO, "%s (pid=%d) %s (user %.2fs, system %.2fs, max rss %ld kB).",
+              child->name, child->pid, reason, user, system, usage->ru_maxrss);
+}
+
+/* ************************************************************************** */
+/* Return a pidfd for a child, or -1 when the kernel does not support them */
+int elm_supervisor_pidfd_open(pid_t pid)
+{
+#ifdef SYS_pidfd_open
+    int fd = syscall(SYS_pidfd_open, pid, 0);
+
+    if (fd >= 0) {
+        return fd;
+    }
+
+    if (errno != ENOSYS) {
+        elmprintf(LOGERRNO, "%s '%d'", "Unable to open pidfd for pid", pid);
+    }
+#endif
+
+    return -1;
+}
+
+/* ************************************************************************** */
+/* Reap a watched child once its pidfd became readable */
+gboolean elm_supervisor_pidfd_ready(gint fd, GIOCondition condition,
+                                    gpointer data)
+{
+    ElmSupervisorChild *child = data;
+
+    pthread_mutex_lock(&Mutex);
+
+    Children      = g_slist_remove(Children, child);
+    child->source = 0;
+
+    pthread_mutex_unlock(&Mutex);
+
+    elm_supervisor_reap(child);
+
+    return G_SOURCE_REMOVE;
+}
+
+/* ************************************************************************** */
+/* Dispatch the signals read from the signalfd */
+gboolean elm_supervisor_signal_ready(gint fd, GIOCondition condition,
+                                     gpointer data)
+{
+    struct signalfd_siginfo info;
+    int                     reap = 0;
+
+    while (read(fd, &info, sizeof(info)) == sizeof(info))
+    {
+        if (info.ssi_signo == SIGCHLD) {
+            reap = 1;
+        }
+        else if ((info.ssi_signo < NSIG) && Handlers[info.ssi_signo]) {
+            Handlers[info.ssi_signo](&info);
+        }
+    }
+
+    if (reap) {
+        elm_supervisor_reap_all();
+    }
+
+    return G_SOURCE_CONTINUE;
+}
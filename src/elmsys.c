@@ -16,79 +16,49 @@
 #include "elmsys.h"
 #include "elmdef.h"
 #include "elmio.h"
-#include "elmstr.h"
-#include <elmstd.h>
 #include <dirent.h>
 #include <fcntl.h>
 #include <stdarg.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
 #include <sys/types.h>
 
+/* Typedefs */
+typedef struct
+{
+    uint64_t       d_ino;
+    int64_t        d_off;
+    unsigned short d_reclen;
+    unsigned char  d_type;
+    char           d_name[];
+} ElmSysDirent;
+
+/* Private functions */
+static int elm_sys_proc_match(ElmSysProc *proc);
+
 /* ************************************************************************** */
 /* Search for a process that matches the input name and return its PID */
 pid_t elm_sys_pgrep(const char *program)
 {
-    uid_t         uid   = getuid();
-    pid_t         pid   = 0;
-    char         *ptr;
-    char         *end;
-    char         *fpath;
-    char          buffer[ELM_MAX_MSG_SIZE];
-    struct stat   info;
-    int           nbytes;
-    int           fd;
-
-    /* Search for a process that matches the input name */
-    char **proc = elm_sys_get_proc();
-    size_t i;
+    ElmSysProc proc;
+    uid_t      uid = getuid();
+    pid_t      pid;
 
-    for (i=0; proc[i]; i++)
+    /* Root may find the processes of any user */
+    if (elm_sys_proc_open(&proc, "/proc", (uid > 0) ? uid : ELM_SYS_ANY_UID,
+                          program) < 0)
     {
-        /* Focus on freeing memory once pid is set */
-        if (pid > 0) {
-            continue;
-        }
-
-        /* Make sure user spawned process */
-        fpath = elm_str_path("/proc/%s/cmdline", proc[i]);
-
-        if ((stat(fpath, &info) < 0) \
-            || ((info.st_uid != uid) && (uid > 0)) \
-            || (access(fpath, R_OK) < 0))
-        {
-            elm_std_free(&fpath);
-            elm_std_free(&proc[i]);
-            continue;
-        }
-
-        /* Read cmdline file for pid */
-        if (((fd=open(fpath, O_RDONLY)) < 0) \
-            || ((nbytes=read(fd, buffer, sizeof(buffer))) <= 0))
-        {
-            elm_std_free(&fpath);
-            elm_std_free(&proc[i]);
-            continue;
-        }
-
-        /* Set pid if program is found in cmdline */
-        end = buffer + nbytes;
-        for (ptr=buffer; ptr < end; ) {
-            if (strstr(ptr, program)) {
-                pid = strtol(proc[i], 0, 10);
-                break;
-            }
+        return 0;
+    }
 
-            while (*ptr++) {}
-        }
+    pid = elm_sys_proc_next(&proc);
 
-        close(fd);
-        elm_std_free(&fpath);
-        elm_std_free(&proc[i]);
-    }
+    elm_sys_proc_close(&proc);
 
     return pid;
 }
@@ -120,66 +90,152 @@ char * elm_sys_basename(const char *string)
 }
 
 /* ************************************************************************** */
-/* Look to see if name corresponds to a running process. Return PID if it
- * does. */
-char ** elm_sys_get_proc(void)
+/* Start iterating over the processes in a proc directory, normally "/proc".
+ * Only processes owned by the uid, unless it is ELM_SYS_ANY_UID, and with the
+ * match string in one of their cmdline arguments, unless it is NULL, are
+ * returned. */
+int elm_sys_proc_open(ElmSysProc *proc, const char *root, uid_t uid,
+                      const char *match)
 {
-    DIR           *dhandle = opendir("/proc");
-    struct dirent *entry;
-    char          *endptr;
-
-    if (!dhandle) {
-        return NULL;
+    if ((proc->dirfd=open(root, O_RDONLY | O_DIRECTORY | O_CLOEXEC)) < 0) {
+        elmprintf(LOGERRNO, "%s '%s'", "Unable to open directory", root);
+        return -1;
     }
 
-    /* Populate process list with current processes */
-    char   **procs = NULL;
-    size_t   index = 1;
-    size_t   i;
+    proc->offset     = 0;
+    proc->length     = 0;
+    proc->uid        = uid;
+    proc->match      = match;
+    proc->pid        = 0;
+    proc->name[0]    = '\0';
+    proc->cmdline[0] = '\0';
+    proc->cmdlength  = 0;
+
+    return 0;
+}
+
+/* ************************************************************************** */
+/* Return the PID of the next matching process, or 0 when there are no more.
+ * Directory entries are read in batches straight into the iterator. */
+pid_t elm_sys_proc_next(ElmSysProc *proc)
+{
+    ElmSysDirent *entry;
+    char         *end;
+    long          pid;
+    long          nbytes;
 
-    while ((entry=readdir(dhandle)))
+    while (1)
     {
+        /* Read the next batch of directory entries */
+        if (proc->offset >= proc->length) {
+            nbytes = syscall(SYS_getdents64, proc->dirfd, proc->dents,
+                             sizeof(proc->dents));
+
+            if (nbytes <= 0) {
+                if (nbytes < 0) {
+                    elmprintf(LOGERRNO, "Unable to read process directory");
+                }
+
+                return 0;
+            }
+
+            proc->offset = 0;
+            proc->length = nbytes;
+        }
+
+        entry         = (ElmSysDirent*)&proc->dents[proc->offset];
+        proc->offset += entry->d_reclen;
+
         /* Check process conditions */
-        if (entry->d_type != DT_DIR) {
+        if ((entry->d_type != DT_DIR) && (entry->d_type != DT_UNKNOWN)) {
             continue;
         }
 
-        if (!strtol(entry->d_name, &endptr, 10) || (*endptr != '\0')) {
+        pid = strtol(entry->d_name, &end, 10);
+
+        if ((pid <= 0) || (*end != '\0')
+            || (strlen(entry->d_name) >= sizeof(proc->name)))
+        {
             continue;
         }
 
-        /* Allocate memory for process list */
-        if (!procs) {
-            if (!(procs=calloc(1, sizeof *procs))) {
-                elmprintf(LOGERRNO, "Unable to allocate process array");
-                goto cleanup;
-            }
-        }
+        strcpy(proc->name, entry->d_name);
 
-        /* Copy string to process list */
-        if (!(procs[index-1]=elm_str_copy(entry->d_name))) {
-            goto cleanup;
+        if (elm_sys_proc_match(proc)) {
+            proc->pid = pid;
+            return pid;
         }
+    }
+}
 
-        /* Increase size of allocated memory region */
-        if (!(procs=realloc(procs, (index+1) * sizeof *procs))) {
-            elmprintf(LOGERRNO, "Unable to reallocate process array");
-            goto cleanup;
-        }
+/* ************************************************************************** */
+/* Open a file in the directory of the current process */
+int elm_sys_proc_openat(ElmSysProc *proc, const char *file, int flags)
+{
+    char path[ELM_MAX_PATH_SIZE];
+
+    snprintf(path, sizeof(path), "%s/%s", proc->name, file);
+
+    return openat(proc->dirfd, path, flags | O_CLOEXEC);
+}
+
+/* ************************************************************************** */
+/* Stop iterating over processes */
+void elm_sys_proc_close(ElmSysProc *proc)
+{
+    if (proc->dirfd >= 0) {
+        close(proc->dirfd);
+    }
+
+    proc->dirfd = -1;
+}
+
+/* ************************************************************************** */
+/* Check the current process against the uid and cmdline filters. The cmdline
+ * is only read when there is something to match. */
+int elm_sys_proc_match(ElmSysProc *proc)
+{
+    struct stat  info;
+    char        *ptr;
+    char        *end;
+    long         nbytes;
+    int          fd;
+
+    proc->cmdlength = 0;
 
-        procs[index++] = NULL;
+    if ((proc->uid != ELM_SYS_ANY_UID)
+        && ((fstatat(proc->dirfd, proc->name, &info, 0) < 0)
+            || (info.st_uid != proc->uid)))
+    {
+        return 0;
+    }
+
+    if (!proc->match) {
+        return 1;
+    }
+
+    /* Read cmdline file, its arguments are separated by null characters */
+    if ((fd=elm_sys_proc_openat(proc, "cmdline", O_RDONLY)) < 0) {
+        return 0;
     }
 
-    closedir(dhandle);
+    nbytes = read(fd, proc->cmdline, sizeof(proc->cmdline)-1);
 
-    return procs;
+    close(fd);
 
-cleanup:
-    for (i=0; i < index; i++) {
-        elm_std_free(&procs[i]);
+    if (nbytes <= 0) {
+        return 0;
     }
 
-    elm_std_free(&procs);
+    proc->cmdline[nbytes] = '\0';
+    proc->cmdlength       = nbytes;
+    end                   = proc->cmdline + nbytes;
+
+    for (ptr=proc->cmdline; ptr < end; ptr += strlen(ptr)+1) {
+        if (strstr(ptr, proc->match)) {
+            return 1;
+        }
+    }
 
-    return NULL;
+    return 0;
 }
@@ -0,0 +1,163 @@
+/* *****************************************************************************
+ * 
+ * Name:    elmtrace.c
+ * Author:  Gabriel Gonzalez
+ * Email:   gabeg@bu.edu
+ * License: The MIT License (MIT)
+ * 
+ * Description: Startup phase tracer.
+ *              
+ * Notes: Spans are timed on CLOCK_MONOTONIC and written out as they end, in the
+ *        Chrome trace event format, so the file loads in Perfetto or
+ *        chrome://tracing. Each event is appended with a single write(), so a
+ *        forked child can add its own events to the same file, and a trace
+ *        that is cut short by a crash is still readable.
+ * 
+ *        Timestamps are in microseconds since the trace was opened. When
+ *        tracing is disabled, each call is a single check.
+ * 
+ * *****************************************************************************
+ */
+
+/* Includes */
+#include "elmtrace.h"
+#include "elmdef.h"
+#include "elmio.h"
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+/* Private functions */
+static int64_t elm_trace_now(void);
+static void    elm_trace_write(const char *name, char phase, int64_t start,
+                               int64_t duration);
+static void    elm_trace_close(void);
+
+/* Private variables */
+static int     TraceFd    = -1;
+static pid_t   TraceOwner = -1;
+static int64_t TraceStart = 0;
+
+/* ************************************************************************** */
+/* Start writing trace events to a file */
+int elm_trace_open(const char *path)
+{
+    char header[ELM_MAX_LINE_SIZE];
+    int  length;
+
+    if ((TraceFd=open(path, (O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC),
+                      0644)) < 0)
+    {
+        elmprintf(LOGERRNO, "%s '%s'", "Unable to open trace file", path);
+        return -1;
+    }
+
+    TraceOwner = getpid();
+    TraceStart = elm_trace_now();
+
+    length = snprintf(header, sizeof(header),
+                      "[\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,"
+                      "\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                      TraceOwner, TraceOwner, PROGRAM);
+
+    if (write(TraceFd, header, length) < 0) {
+        elmprintf(LOGERRNO, "%s '%s'", "Unable to write trace file", path);
+    }
+
+    atexit(elm_trace_close);
+    elmprintf(LOGINFO, "Writing startup trace to '%s'.", path);
+
+    return 0;
+}
+
+/* ************************************************************************** */
+/* Check if tracing is enabled */
+int elm_trace_is_enabled(void)
+{
+    return (TraceFd >= 0);
+}
+
+/* ************************************************************************** */
+/* Return the start time of a span, to be passed to elm_trace_end() */
+int64_t elm_trace_begin(void)
+{
+    return (TraceFd >= 0) ? elm_trace_now() : 0;
+}
+
+/* ************************************************************************** */
+/* Write a span that started at the given time and ends now */
+void elm_trace_end(const char *name, int64_t start)
+{
+    if (TraceFd < 0) {
+        return;
+    }
+
+    elm_trace_write(name, 'X', start, elm_trace_now()-start);
+}
+
+/* ************************************************************************** */
+/* Write an event that happens now */
+void elm_trace_instant(const char *name)
+{
+    if (TraceFd < 0) {
+        return;
+    }
+
+    elm_trace_write(name, 'i', elm_trace_now(), 0);
+}
+
+/* ************************************************************************** */
+/* Return the current monotonic time in microseconds */
+int64_t elm_trace_now(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return ((int64_t)now.tv_sec * 1000000) + (now.tv_nsec / 1000);
+}
+
+/* ************************************************************************** */
+/* Append an event to the trace file */
+void elm_trace_write(const char *name, char phase, int64_t start,
+                     int64_t duration)
+{
+    char event[ELM_MAX_LINE_SIZE];
+    int  length;
+
+    length = snprintf(event, sizeof(event),
+                      ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"%c\","
+                      "\"ts\":%" PRId64 ",\"dur\":%" PRId64 ","
+                      "\"pid\":%d,\"tid\":%ld,\"s\":\"t\"}",
+                      name, PROGRAM, phase, start-TraceStart, duration,
+                      getpid(), (long)syscall(SYS_gettid));
+
+    if ((length < 0) || ((size_t)length >= sizeof(event))) {
+        return;
+    }
+
+    if (write(TraceFd, event, length) < 0) {
+    }
+}
+
+/* ************************************************************************** */
+/* Close the trace event array. Forked children leave that to the process that
+ * opened the trace. */
+void elm_trace_close(void)
+{
+    if ((TraceFd < 0) || (getpid() != TraceOwner)) {
+        return;
+    }
+
+    if (write(TraceFd, "\n]\n", 3) < 0) {
+    }
+
+    close(TraceFd);
+
+    TraceFd = -1;
+}
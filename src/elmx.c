@@ -17,38 +17,114 @@
 #include "elmconf.h"
 #include "elmdef.h"
 #include "elmio.h"
+#include "elmspawn.h"
 #include "elmstd.h"
 #include "elmstr.h"
+#include "elmsupervisor.h"
 #include "elmsys.h"
+#include "elmtrace.h"
 #include <dirent.h>
+#include <errno.h>
 #include <fcntl.h>
+#include <glib.h>
+#include <glib-unix.h>
 #include <limits.h>
 #include <pty.h>
 #include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <unistd.h>
+#include <linux/vt.h>
 
 /* #include <dbus/dbus.h> */
+#include <sys/ioctl.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <X11/Xauth.h>
+#include <X11/Xatom.h>
 #include <X11/Xlib.h>
+#include <X11/Xresource.h>
 #include <X11/Xutil.h>
 #include <X11/cursorfont.h>
 #include <X11/extensions/Xrandr.h>
+#include <gdk/gdk.h>
+#include <gdk/gdkx.h>
 
 /* Do i need this */
 #include <ctype.h>
 
+/* Typedefs */
+typedef struct
+{
+    GMainLoop *loop;
+    guint      watch;
+    guint      timer;
+    int        display;
+    size_t     length;
+    char       buffer[ELM_MAX_OPT_SIZE];
+} ElmXReady;
+
+typedef struct
+{
+    int        (*load)(const char *path, uid_t uid);
+    const char  *path;
+    uid_t        uid;
+    int          status;
+    int          done;
+    GMutex       lock;
+    GCond        cond;
+} ElmXCall;
+
+typedef struct
+{
+    int          done;
+    gint         refs;
+    GMutex       lock;
+    GCond        cond;
+} ElmXRun;
+
 /* Private functions */
 static int    elm_x_wait(void);
+static int    elm_x_wait_displayfd(int fd);
+static int    elm_x_use_displayfd(void);
+static int    elm_x_get_timeout(void);
 static int    elm_x_init(void);
 static int    elm_x_stop(Display *display);
+static int    elm_x_update_screen(void);
+static int    elm_x_query_screen(int *width, int *height);
+static void   elm_x_set_size(int *width, int *height, int w, int h);
+static GdkFilterReturn elm_x_screen_event(GdkXEvent *xevent, GdkEvent *event,
+                                          gpointer data);
+static gboolean elm_x_screen_changed(gpointer data);
+static void   elm_x_screen_conf_changed(const char *group, void *data);
+static int    elm_x_set_cursor(void);
+static int    elm_x_call(int (*load)(const char *path, uid_t uid),
+                         const char *path, uid_t uid);
+static gboolean elm_x_call_ready(gpointer data);
 static int    elm_x_exec_xorg(void);
 static int    elm_x_exec_xcompmgr(void);
+static int    elm_x_run_as_user(const ElmSpawnAttr *user, char *argv[]);
+static void   elm_x_run_exited(pid_t pid, int status,
+                               const struct rusage *usage, void *data);
+static void   elm_x_run_unref(ElmXRun *run);
+static int    elm_x_load_xresources(const char *path, uid_t uid);
+static int    elm_x_load_xmodmap(const char *path, uid_t uid);
+static int    elm_x_run_xmodmap(char *line);
+static int    elm_x_set_keysym(const char *name, KeySym *syms, int nsyms);
+static int    elm_x_set_modifier(const char *name, KeySym *syms, int nsyms);
+static int    elm_x_set_pointer(char *rhs);
+static char * elm_x_read_user_file(const char *path, uid_t uid);
+static Bool   elm_x_put_resource(XrmDatabase *db, XrmBindingList bindings,
+                                 XrmQuarkList quarks, XrmRepresentation *type,
+                                 XrmValue *value, XPointer data);
+static KeySym elm_x_parse_keysym(const char *name);
+static int    elm_x_parse_keysyms(char *list, KeySym *syms, int size);
+static int    elm_x_get_keycodes(KeySym sym, KeyCode *codes, int size);
+static int    elm_x_comment_cpp_lines(char *data);
+static int    elm_x_use_cpp(void);
 static int    elm_x_set_env(void);
 static int    elm_x_set_display_env(void);
 static int    elm_x_set_tty_env(void);
@@ -61,17 +137,29 @@ static char * elm_x_get_localhost(void);
 static char * elm_x_get_vt(void);
 static char * elm_x_get_random_bytes(size_t size);
 static char * elm_x_get_tty(void);
+static char * elm_x_get_tty_from_vt(void);
 static char * elm_x_get_tty_from_sys(void);
 static char * elm_x_get_tty_from_pts(void);
 static char * elm_x_get_tty_from_proc(void);
 static char * elm_x_get_tty_open_from_proc(int *ignore, size_t size);
-static int    elm_x_get_tty_index_from_proc(char *dir, char *name, char *proc);
+static int    elm_x_get_tty_index_from_proc(int dirfd, const char *name);
 static int    elm_x_is_running(void);
+static gboolean elm_x_displayfd_ready(gint fd, GIOCondition condition,
+                                      gpointer data);
+static gboolean elm_x_displayfd_timeout(gpointer data);
 
 
 /* Private variables */
-static Display *XDisplay = NULL;
-static pid_t    XPid     = -1;
+static Display           *XDisplay        = NULL;
+static pid_t              XPid            = -1;
+static int                XWidth          = 0;
+static int                XHeight         = 0;
+static int                XRREventBase    = 0;
+static int                XRRErrorBase    = 0;
+static guint              XScreenIdle     = 0;
+static ElmXScreenChanged  XScreenCallback = NULL;
+static void              *XScreenData     = NULL;
+static unsigned long      XRoundTrips     = 0;
 
 /* ************************************************************************** */
 /* Start the X server */
@@ -82,23 +170,33 @@ int elm_x_start(void)
 {
     elmprintf(LOGINFO, "Starting X server."); 
 
+    int64_t start;
+
     if (elm_x_is_running()) {
         elmprintf(LOGINFO, "X server already running.");
     }
     else {
+        start = elm_trace_begin();
+
         if (elm_x_set_env() < 0) {
             return -2;
         }
 
+        elm_trace_end("elm_x_set_env", start);
+
         if (elm_x_exec_xorg() < 0) {
             return -3;
         }
     }
 
+    start = elm_trace_begin();
+
     if (elm_x_init() < 0) {
         exit(ELM_EXIT_X_INIT);
     }
 
+    elm_trace_end("elm_x_init", start);
+
     /* DBusError derr; */
     /* dbus_err_init(&derr); */
     /* DBusConnection *dcon = dbus_bus_get(DBUS_BUS_SYSTEM */
@@ -116,13 +214,8 @@ int elm_x_wait(void)
     struct timespec timeout = {0};
     sigset_t        set;
     siginfo_t       info;
-    int             sec;
-
-    if ((sec=elm_conf_read_int("Main", "XTimeout")) < 0) {
-        sec = 30;
-    }
 
-    timeout.tv_sec = sec;
+    timeout.tv_sec = elm_x_get_timeout();
 
     if (sigemptyset(&set) < 0) {
         elmprintf(LOGERRNO, "Unable to empty signal set");
@@ -152,24 +245,138 @@ int elm_x_wait(void)
 }
 
 /* ************************************************************************** */
-/* Initialize X window attributes */
+/* Wait for Xorg to write its display number on the -displayfd pipe, from a
+ * main loop. The pipe closing without a display number means Xorg exited,
+ * which is noticed right away instead of after the timeout. */
+int elm_x_wait_displayfd(int fd)
+{
+    elmprintf(LOGINFO, "Waiting for X to write its display number.");
+
+    ElmXReady ready  = {0};
+    char      display[ELM_MAX_OPT_SIZE];
+    int       status = 0;
+
+    ready.loop    = g_main_loop_new(NULL, FALSE);
+    ready.display = -1;
+    ready.watch   = g_unix_fd_add(fd, G_IO_IN | G_IO_HUP | G_IO_ERR,
+                                  elm_x_displayfd_ready, &ready);
+    ready.timer   = g_timeout_add_seconds(elm_x_get_timeout(),
+                                          elm_x_displayfd_timeout, &ready);
+
+    g_main_loop_run(ready.loop);
+
+    if (ready.watch) {
+        g_source_remove(ready.watch);
+    }
+
+    if (ready.timer) {
+        g_source_remove(ready.timer);
+    }
+
+    g_main_loop_unref(ready.loop);
+    close(fd);
+
+    if (ready.display < 0) {
+        return -1;
+    }
+
+    snprintf(display, sizeof(display), ":%d", ready.display);
+
+    if (elm_std_setenv("DISPLAY", display) < 0) {
+        status = -2;
+    }
+
+    elmprintf(LOGINFO, "X is ready on display '%s'.", display);
+
+    return status;
+}
+
+/* ************************************************************************** */
+/* Check if Xorg reports its display number on a pipe, instead of sending
+ * SIGUSR1. This is on unless turned off in the config file. */
+int elm_x_use_displayfd(void)
+{
+    if (!elm_conf_read("Main", "XDisplayFd")) {
+        return 1;
+    }
+
+    return (elm_conf_read_bool("Main", "XDisplayFd") > 0);
+}
+
+/* ************************************************************************** */
+/* Return the number of seconds to wait for Xorg to start */
+int elm_x_get_timeout(void)
+{
+    int sec;
+
+    if ((sec=elm_conf_read_int("Main", "XTimeout")) < 0) {
+        sec = 30;
+    }
+
+    return sec;
+}
+
+/* ************************************************************************** */
+/* Initialize X window attributes. The display is opened through GDK, and GTK
+ * adopts it as its default display later on, so the greeter makes a single
+ * connection to the X server. */
 int elm_x_init(void)
 {
     elmprintf(LOGINFO, "Preparing to open X server display.");
 
-    char *display = getenv("DISPLAY");
+    char       *display = getenv("DISPLAY");
+    GdkDisplay *gdkdisplay;
+
+    gdk_set_allowed_backends("x11");
 
-    if (!(XDisplay=XOpenDisplay(display))) {
-        elmprintf(LOGERRNO, "%s '%s'", "Unable to open display on", display);
+    if (!(gdkdisplay=gdk_display_open(display))) {
+        elmprintf(LOGERR, "%s '%s'.", "Unable to open display on", display);
         elm_x_stop(XDisplay);
         return -1;
     }
 
+    gdk_display_manager_set_default_display(gdk_display_manager_get(),
+                                            gdkdisplay);
+
+    XDisplay = gdk_x11_display_get_xdisplay(gdkdisplay);
+
     XSetIOErrorHandler(elm_x_stop);
 
+    /* The cursor requests go out with the sync that ends the screen query */
+    if (elm_x_update_screen() < 0) {
+        elmprintf(LOGERR, "Unable to determine screen dimensions.");
+    }
+
+    if (XRRQueryExtension(XDisplay, &XRREventBase, &XRRErrorBase)) {
+        XRRSelectInput(XDisplay, DefaultRootWindow(XDisplay),
+                       RRScreenChangeNotifyMask | RRCrtcChangeNotifyMask);
+        gdk_window_add_filter(NULL, elm_x_screen_event, NULL);
+    }
+
+    elm_conf_subscribe("Main", elm_x_screen_conf_changed, NULL);
+
+    if (elm_x_set_cursor() < 0) {
+        return -2;
+    }
+
+    XSync(XDisplay, False);
+
+    XRoundTrips++;
+
+    elmprintf(LOGINFO, "X server display ready after %lu requests, %lu %s.",
+              elm_x_get_requests(), XRoundTrips, "round trips");
+
     return 0;
 }
 
+/* ************************************************************************** */
+/* Return the number of requests sent to the X server so far, by GTK and the
+ * greeter */
+unsigned long elm_x_get_requests(void)
+{
+    return (XDisplay) ? XNextRequest(XDisplay)-1 : 0;
+}
+
 /* ************************************************************************** */
 /* Stop X server */
 int elm_x_stop(Display *display)
@@ -211,18 +418,12 @@ int elm_x_stop(Display *display)
         }
     }
 
-    /* Wait 10 sec for server to shut down */
+    /* Wait up to 10 sec for server to shut down */
     elmprintf(LOGWARN, "Waiting for X server to shut down.");
 
-    int i;
-    for (i=0; i < 10; i++)
-    {
-        if (waitpid(XPid, 0, WNOHANG) == XPid) {
-            elmprintf(LOGWARN, "X server shutting down.");
-            exit(ELM_EXIT_X_STOP);
-        }
-
-        sleep(1);
+    if (elm_supervisor_wait(XPid, 10000) == 0) {
+        elmprintf(LOGWARN, "X server shutting down.");
+        exit(ELM_EXIT_X_STOP);
     }
 
     /* Send KILL to server */
@@ -249,33 +450,61 @@ int elm_x_exec_xorg(void)
     char *display    = getenv("DISPLAY");
     char *xauthority = getenv("XAUTHORITY");
     char *vt         = getenv("XORGVT");
-    char *argv[]     = {ELM_CMD_XORG, display, "-background", "none",
-                        "-noreset", "-verbose", "3", "-logverbose", "-logfile",
-                        ELM_XLOG, "-auth", xauthority, "-seat", "seat0",
-                        "-nolisten", "tcp", vt, NULL};
+    char  fdstr[ELM_MAX_OPT_SIZE];
+    char *argv[]     = {ELM_CMD_XORG, "-displayfd", fdstr, "-background",
+                        "none", "-noreset", "-verbose", "3", "-logverbose",
+                        "-logfile", ELM_XLOG, "-auth", xauthority, "-seat",
+                        "seat0", "-nolisten", "tcp", vt, NULL};
+    char **args      = argv;
+    int    fds[2]    = {-1, -1};
+
+    /* Without a pipe, the display is chosen up front and Xorg sends SIGUSR1
+     * when it is ready */
+    if (!elm_x_use_displayfd() || (pipe(fds) < 0)) {
+        if (!display && (elm_x_set_display_env() < 0)) {
+            exit(ELM_EXIT_X_ENV_DISPLAY);
+        }
 
-    switch ((XPid=fork()))
-    {
-    case 0:
-        elmprintf(LOGINFO, "Preparing to run X server.");
+        args    = &argv[1];
+        args[0] = ELM_CMD_XORG;
+        args[1] = getenv("DISPLAY");
+        fds[0]  = -1;
+        fds[1]  = -1;
+    }
+    else {
+        fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+        snprintf(fdstr, sizeof(fdstr), "%d", fds[1]);
+    }
 
-        /* signal(SIGTTIN, SIG_IGN); */
-        /* signal(SIGTTOU, SIG_IGN); */
-        /* signal(SIGUSR1, SIG_IGN); */
-        setpgid(0, getpid());
+    ElmSpawnAttr attr;
+    int64_t      start = elm_trace_begin();
 
-        elm_std_execvp(argv[0], argv);
+    elmprintf(LOGINFO, "Preparing to run X server.");
+    elm_spawn_attr_init(&attr, args);
 
+    attr.flags = ELM_SPAWN_SETPGID;
+
+    if ((XPid=elm_spawn(&attr)) < 0) {
         exit(ELM_EXIT_X_EXEC);
-    case -1:
-        elmprintf(LOGERRNO, "%s '%s'", "Error during fork to start", argv[0]);
-        exit(ELM_EXIT_X_EXEC);
-    default:
-        if (elm_x_wait() < 0) {
+    }
+
+    elm_supervisor_watch(XPid, "Xorg", NULL, NULL);
+    elm_trace_end("xorg_spawn", start);
+
+    start = elm_trace_begin();
+
+    if (fds[0] >= 0) {
+        close(fds[1]);
+
+        if (elm_x_wait_displayfd(fds[0]) < 0) {
             exit(ELM_EXIT_X_WAIT);
         }
-        break;
     }
+    else if (elm_x_wait() < 0) {
+        exit(ELM_EXIT_X_WAIT);
+    }
+
+    elm_trace_end("elm_x_wait", start);
 
     return 0;
 }
@@ -284,22 +513,18 @@ int elm_x_exec_xorg(void)
 /* Execute xcompmgr command */
 int elm_x_exec_xcompmgr(void)
 {
-    char  *argv[] = {ELM_CMD_XCOMPMGR, NULL};
-    pid_t  pid;
+    char         *argv[] = {ELM_CMD_XCOMPMGR, NULL};
+    ElmSpawnAttr  attr;
+    pid_t         pid;
 
-    switch ((pid=fork()))
-    {
-    case 0:
-        elm_std_execvp(argv[0], argv);
-        return 1;
-    case -1:
-        elmprintf(LOGERRNO, "%s '%s'", "Error during fork to start", argv[0]);
+    elm_spawn_attr_init(&attr, argv);
+
+    if ((pid=elm_spawn(&attr)) < 0) {
         return 2;
-    default:
-        waitpid(pid, 0, WNOHANG);
-        break;
     }
 
+    elm_supervisor_watch(pid, "xcompmgr", NULL, NULL);
+
     return 0;
 }
 
@@ -326,6 +551,8 @@ int elm_x_set_cursor(void)
     Window window = DefaultRootWindow(XDisplay);
     int    status = XDefineCursor(XDisplay, window, cursor);
 
+    /* Sent with the next sync */
+
     switch (status)
     {
     case BadCursor:
@@ -338,9 +565,6 @@ int elm_x_set_cursor(void)
         break;
     }
 
-    /* Flush events to X server */
-    XFlush(XDisplay);
-
     return 0;
 }
 
@@ -368,41 +592,643 @@ int elm_x_set_transparency(int flag)
 }
 
 /* ************************************************************************** */
-/* Load preferences from Xresources and Xmodmap */
-int elm_x_load_user_preferences(void)
+/* Load preferences from Xresources and Xmodmap. Both are applied over the
+ * connection of the greeter. xrdb only runs, as the user who logs in, for an
+ * Xresources file that needs the C preprocessor, and only if enabled. */
+int elm_x_load_user_preferences(const ElmSpawnAttr *user)
 {
-    char *home = getenv("HOME");
-    char  xresources[ELM_MAX_CRED_SIZE];
-    char  xmodmap[ELM_MAX_CRED_SIZE];
-    char  cmd[ELM_MAX_CMD_SIZE];
+    const char *home = g_environ_getenv((char**)user->envp, "HOME");
+    char        xresources[ELM_MAX_PATH_SIZE];
+    char        xmodmap[ELM_MAX_PATH_SIZE];
+
+    if (!home) {
+        return -1;
+    }
 
     snprintf(xresources, sizeof(xresources), "%s/.Xresources", home);
     snprintf(xmodmap,    sizeof(xmodmap),    "%s/.Xmodmap",    home);
 
+    char *xrdbargs[] = {ELM_CMD_XRDB, "-merge", xresources, NULL};
+
     /* Load .Xresources */
     if (access(xresources, F_OK) == 0) {
-        snprintf(cmd, sizeof(cmd), "%s -merge %s", ELM_CMD_XRDB, xresources);
-        elmprintf(LOGINFO, "Loading Xresources: '%s'.", cmd);
-        system(cmd);
+        elmprintf(LOGINFO, "Loading Xresources: '%s'.", xresources);
+
+        if (elm_x_call(elm_x_load_xresources, xresources, user->uid) > 0) {
+            elmprintf(LOGINFO, "Preprocessing Xresources with '%s'.",
+                      ELM_CMD_XRDB);
+            elm_x_run_as_user(user, xrdbargs);
+        }
     }
 
     /* Load .Xmodmap */
     if (access(xmodmap, F_OK) == 0) {
-        snprintf(cmd, sizeof(cmd), "%s %s", ELM_CMD_XMODMAP, xmodmap);
-        elmprintf(LOGINFO, "Loading Xmodmap: '%s'.", cmd);
-        system(cmd);
+        elmprintf(LOGINFO, "Loading Xmodmap: '%s'.", xmodmap);
+        elm_x_call(elm_x_load_xmodmap, xmodmap, user->uid);
+    }
+
+    return 0;
+}
+
+/* ************************************************************************** */
+/* Merge an Xresources file into the RESOURCE_MANAGER property of the root
+ * window, like 'xrdb -merge' does. Return a positive number if the file has to
+ * go through the C preprocessor instead. */
+int elm_x_load_xresources(const char *path, uid_t uid)
+{
+    XrmQuark       empty[] = {NULLQUARK};
+    XrmDatabase    merged  = NULL;
+    XrmDatabase    db;
+    Window         root    = DefaultRootWindow(XDisplay);
+    Atom           type;
+    int            format;
+    unsigned long  length;
+    unsigned long  after;
+    unsigned char *current = NULL;
+    GString       *string;
+    char          *data;
+
+    if (!(data=elm_x_read_user_file(path, uid))) {
+        return -1;
+    }
+
+    if (elm_x_comment_cpp_lines(data)) {
+        if (elm_x_use_cpp()) {
+            g_free(data);
+            return 1;
+        }
+
+        elmprintf(LOGWARN, "%s '%s', %s.", "Ignoring preprocessor lines in",
+                  path, "set XrdbCpp=true to run them");
+    }
+
+    XrmInitialize();
+
+    db = XrmGetStringDatabase(data);
+
+    g_free(data);
+
+    /* The resources of the file win over those already on the server */
+    if ((XGetWindowProperty(XDisplay, root, XA_RESOURCE_MANAGER, 0, LONG_MAX/4,
+                            False, XA_STRING, &type, &format, &length, &after,
+                            &current) == Success) && current)
+    {
+        merged = XrmGetStringDatabase((char*)current);
+        XFree(current);
+    }
+
+    XrmMergeDatabases(db, &merged);
+
+    string = g_string_new(NULL);
+
+    XrmEnumerateDatabase(merged, empty, empty, XrmEnumAllLevels,
+                         elm_x_put_resource, (XPointer)string);
+    XChangeProperty(XDisplay, root, XA_RESOURCE_MANAGER, XA_STRING, 8,
+                    PropModeReplace, (unsigned char*)string->str,
+                    string->len);
+    XFlush(XDisplay);
+
+    elmprintf(LOGINFO, "Merged Xresources into %lu bytes of resources.",
+              (unsigned long)string->len);
+
+    g_string_free(string, TRUE);
+    XrmDestroyDatabase(merged);
+
+    return 0;
+}
+
+/* ************************************************************************** */
+/* Apply the statements of an Xmodmap file. Keycode, keysym, modifier, and
+ * pointer statements are handled, anything else is skipped. */
+int elm_x_load_xmodmap(const char *path, uid_t uid)
+{
+    char *data;
+    char *line;
+    char *next;
+    int   number;
+
+    if (!(data=elm_x_read_user_file(path, uid))) {
+        return -1;
+    }
+
+    for (line=data, number=1; line; line=next, number++) {
+        if ((next=strchr(line, '\n'))) {
+            *next++ = 0;
+        }
+
+        if (elm_x_run_xmodmap(line) < 0) {
+            elmprintf(LOGWARN, "Skipping line %d of '%s'.", number, path);
+        }
+    }
+
+    XFlush(XDisplay);
+    g_free(data);
+
+    return 0;
+}
+
+/* ************************************************************************** */
+/* Apply one Xmodmap statement */
+int elm_x_run_xmodmap(char *line)
+{
+    char   *save;
+    char   *rhs;
+    char   *cmd;
+    char   *arg;
+    char   *end;
+    KeySym  syms[ELM_MAX_OPT_SIZE];
+    int     nsyms = 0;
+
+    if ((rhs=strchr(line, '='))) {
+        *rhs++ = 0;
+    }
+
+    if (!(cmd=strtok_r(line, " \t", &save)) || (cmd[0] == '!')) {
+        return 0;
+    }
+
+    arg = strtok_r(NULL, " \t", &save);
+
+    if (strcmp(cmd, "pointer") == 0) {
+        return (rhs) ? elm_x_set_pointer(rhs) : -1;
+    }
+
+    if (!arg) {
+        return -1;
+    }
+
+    if (strcmp(cmd, "clear") == 0) {
+        return elm_x_set_modifier(arg, NULL, 0);
+    }
+
+    if (!rhs || ((nsyms=elm_x_parse_keysyms(rhs, syms, ELM_MAX_OPT_SIZE)) < 0)) {
+        return -1;
+    }
+
+    if (strcmp(cmd, "keycode") == 0) {
+        unsigned long code = strtoul(arg, &end, 0);
+
+        if (*end || (code < 8) || (code > 255) || !nsyms) {
+            return -1;
+        }
+
+        XChangeKeyboardMapping(XDisplay, code, nsyms, syms, 1);
+
+        return 0;
+    }
+
+    if (strcmp(cmd, "keysym") == 0) {
+        return elm_x_set_keysym(arg, syms, nsyms);
+    }
+
+    if (strcmp(cmd, "add") == 0) {
+        return elm_x_set_modifier(arg, syms, nsyms);
+    }
+
+    if (strcmp(cmd, "remove") == 0) {
+        return elm_x_set_modifier(arg, syms, -nsyms);
+    }
+
+    return -1;
+}
+
+/* ************************************************************************** */
+/* Bind new keysyms to every key that has the given one */
+int elm_x_set_keysym(const char *name, KeySym *syms, int nsyms)
+{
+    KeySym  sym = elm_x_parse_keysym(name);
+    KeyCode codes[ELM_MAX_OPT_SIZE];
+    int     ncodes;
+    int     i;
+
+    if ((sym == NoSymbol) || !nsyms) {
+        return -1;
+    }
+
+    ncodes = elm_x_get_keycodes(sym, codes, ELM_MAX_OPT_SIZE);
+
+    for (i=0; i < ncodes; i++) {
+        XChangeKeyboardMapping(XDisplay, codes[i], nsyms, syms, 1);
+    }
+
+    return (ncodes > 0) ? 0 : -2;
+}
+
+/* ************************************************************************** */
+/* Change the keys of a modifier. With no keysyms, the modifier is cleared. A
+ * negative count removes the keys instead of adding them. */
+int elm_x_set_modifier(const char *name, KeySym *syms, int nsyms)
+{
+    static const char *names[] = {"shift", "lock", "control", "mod1", "mod2",
+                                  "mod3", "mod4", "mod5"};
+    XModifierKeymap   *map;
+    KeyCode            codes[ELM_MAX_OPT_SIZE];
+    int                ncodes;
+    int                mod;
+    int                i;
+    int                j;
+    int                status;
+
+    for (mod=0; mod < 8; mod++) {
+        if (strcasecmp(name, names[mod]) == 0) {
+            break;
+        }
+    }
+
+    if (mod == 8) {
+        return -1;
+    }
+
+    map = XGetModifierMapping(XDisplay);
+
+    if (!syms) {
+        memset(&map->modifiermap[mod*map->max_keypermod], 0,
+               map->max_keypermod);
+    }
+
+    for (i=0; i < abs(nsyms); i++) {
+        ncodes = elm_x_get_keycodes(syms[i], codes, ELM_MAX_OPT_SIZE);
+
+        for (j=0; j < ncodes; j++) {
+            map = (nsyms > 0) ? XInsertModifiermapEntry(map, codes[j], mod)
+                              : XDeleteModifiermapEntry(map, codes[j], mod);
+        }
+    }
+
+    status = XSetModifierMapping(XDisplay, map);
+
+    XFreeModifiermap(map);
+
+    if (status != MappingSuccess) {
+        elmprintf(LOGWARN, "Unable to change modifier '%s': %s.", name,
+                  (status == MappingBusy) ? "A key is pressed" : "Failed");
+        return -2;
+    }
+
+    return 0;
+}
+
+/* ************************************************************************** */
+/* Change the pointer button mapping. Buttons that are not listed keep their
+ * own number. */
+int elm_x_set_pointer(char *rhs)
+{
+    unsigned char  map[256];
+    char          *save;
+    char          *arg;
+    char          *end;
+    int            nbuttons = XGetPointerMapping(XDisplay, map, sizeof(map));
+    int            i;
+
+    for (i=0; i < nbuttons; i++) {
+        map[i] = i+1;
+    }
+
+    arg = strtok_r(rhs, " \t", &save);
+
+    if (arg && (strcmp(arg, "default") == 0)) {
+        arg = NULL;
+    }
+
+    for (i=0; arg && (i < nbuttons); i++, arg=strtok_r(NULL, " \t", &save)) {
+        map[i] = strtoul(arg, &end, 0);
+
+        if (*end) {
+            return -1;
+        }
+    }
+
+    if (XSetPointerMapping(XDisplay, map, nbuttons) != MappingSuccess) {
+        elmprintf(LOGWARN, "Unable to change pointer mapping.");
+        return -2;
+    }
+
+    return 0;
+}
+
+/* ************************************************************************** */
+/* Return the contents of a file of the user who logs in. The greeter runs as
+ * root, so a file the user does not own, or a link, is refused. */
+char * elm_x_read_user_file(const char *path, uid_t uid)
+{
+    struct stat  info;
+    char        *data;
+    ssize_t      length;
+    int          fd;
+
+    if ((fd=open(path, O_RDONLY | O_NOFOLLOW | O_CLOEXEC)) < 0) {
+        elmprintf(LOGERRNO, "Unable to open '%s'", path);
+        return NULL;
+    }
+
+    if ((fstat(fd, &info) < 0) || !S_ISREG(info.st_mode)
+        || ((uid != ELM_SPAWN_NO_ID) && (info.st_uid != uid))
+        || (info.st_size > ELM_MAX_PREFS_SIZE))
+    {
+        elmprintf(LOGWARN, "Refusing to read '%s'.", path);
+        close(fd);
+        return NULL;
+    }
+
+    data   = g_malloc(info.st_size+1);
+    length = read(fd, data, info.st_size);
+
+    close(fd);
+
+    if (length < 0) {
+        elmprintf(LOGERRNO, "Unable to read '%s'", path);
+        g_free(data);
+        return NULL;
+    }
+
+    data[length] = 0;
+
+    return data;
+}
+
+/* ************************************************************************** */
+/* Write a resource of a database as a line of the RESOURCE_MANAGER property.
+ * Characters that Xrm would strip or split on are escaped. */
+Bool elm_x_put_resource(XrmDatabase *db, XrmBindingList bindings,
+                        XrmQuarkList quarks, XrmRepresentation *type,
+                        XrmValue *value, XPointer data)
+{
+    GString *string = (GString*) data;
+    char    *c;
+    int      i;
+
+    for (i=0; quarks[i] != NULLQUARK; i++) {
+        if (bindings[i] == XrmBindLoosely) {
+            g_string_append_c(string, '*');
+        }
+        else if (i) {
+            g_string_append_c(string, '.');
+        }
+
+        g_string_append(string, XrmQuarkToString(quarks[i]));
+    }
+
+    g_string_append(string, ":\t");
+
+    for (c=value->addr; *c; c++) {
+        if ((c == value->addr) && ((*c == ' ') || (*c == '\t'))) {
+            g_string_append_c(string, '\\');
+            g_string_append_c(string, *c);
+        }
+        else if (*c == '\\') {
+            g_string_append(string, "\\\\");
+        }
+        else if (*c == '\n') {
+            g_string_append(string, "\\n");
+        }
+        else {
+            g_string_append_c(string, *c);
+        }
+    }
+
+    g_string_append_c(string, '\n');
+
+    return False;
+}
+
+/* ************************************************************************** */
+/* Return a keysym from its name or number */
+KeySym elm_x_parse_keysym(const char *name)
+{
+    KeySym  sym;
+    char   *end;
+
+    if ((sym=XStringToKeysym(name)) != NoSymbol) {
+        return sym;
+    }
+
+    sym = strtoul(name, &end, 0);
+
+    return (*end) ? NoSymbol : sym;
+}
+
+/* ************************************************************************** */
+/* Parse a list of keysyms. Return how many there are, or a negative number if
+ * one is not known. */
+int elm_x_parse_keysyms(char *list, KeySym *syms, int size)
+{
+    char *save;
+    char *name;
+    int   n = 0;
+
+    for (name=strtok_r(list, " \t", &save); name && (n < size);
+         name=strtok_r(NULL, " \t", &save))
+    {
+        if (strcmp(name, "NoSymbol") == 0) {
+            syms[n++] = NoSymbol;
+        }
+        else if ((syms[n++]=elm_x_parse_keysym(name)) == NoSymbol) {
+            return -1;
+        }
+    }
+
+    return n;
+}
+
+/* ************************************************************************** */
+/* Find the keys that have a keysym in any of their columns */
+int elm_x_get_keycodes(KeySym sym, KeyCode *codes, int size)
+{
+    KeySym *map;
+    int     min;
+    int     max;
+    int     per;
+    int     n = 0;
+    int     i;
+    int     j;
+
+    XDisplayKeycodes(XDisplay, &min, &max);
+
+    map = XGetKeyboardMapping(XDisplay, min, max-min+1, &per);
+
+    for (i=0; (i <= max-min) && (n < size); i++) {
+        for (j=0; j < per; j++) {
+            if (map[i*per+j] == sym) {
+                codes[n++] = min+i;
+                break;
+            }
+        }
+    }
+
+    XFree(map);
+
+    return n;
+}
+
+/* ************************************************************************** */
+/* Comment out the lines of an Xresources file that are meant for the C
+ * preprocessor. Return how many there are. */
+int elm_x_comment_cpp_lines(char *data)
+{
+    char *line;
+    int   count = 0;
+
+    for (line=data; line; line=strchr(line, '\n')) {
+        line += (*line == '\n');
+
+        if (*line == '#') {
+            *line = '!';
+            count++;
+        }
+    }
+
+    return count;
+}
+
+/* ************************************************************************** */
+/* Check if Xresources files with preprocessor lines are run through xrdb */
+int elm_x_use_cpp(void)
+{
+    if (!elm_conf_read("Main", "XrdbCpp")) {
+        return 0;
+    }
+
+    return (elm_conf_read_bool("Main", "XrdbCpp") > 0);
+}
+
+/* ************************************************************************** */
+/* Load a preferences file from the main loop, which owns the connection that
+ * is shared with GTK, and wait for it to finish */
+int elm_x_call(int (*load)(const char *path, uid_t uid), const char *path,
+               uid_t uid)
+{
+    ElmXCall call = {load, path, uid, 0, 0};
+
+    if (g_main_context_is_owner(NULL)) {
+        return load(path, uid);
+    }
+
+    g_mutex_init(&call.lock);
+    g_cond_init(&call.cond);
+    g_main_context_invoke(NULL, elm_x_call_ready, &call);
+    g_mutex_lock(&call.lock);
+
+    while (!call.done) {
+        g_cond_wait(&call.cond, &call.lock);
+    }
+
+    g_mutex_unlock(&call.lock);
+    g_mutex_clear(&call.lock);
+    g_cond_clear(&call.cond);
+
+    return call.status;
+}
+
+/* ************************************************************************** */
+/* Run a call on the main loop */
+gboolean elm_x_call_ready(gpointer data)
+{
+    ElmXCall *call = data;
+    int       status = call->load(call->path, call->uid);
+
+    g_mutex_lock(&call->lock);
+
+    call->status = status;
+    call->done   = 1;
+
+    g_cond_signal(&call->cond);
+    g_mutex_unlock(&call->lock);
+
+    return G_SOURCE_REMOVE;
+}
+
+/* ************************************************************************** */
+/* Run a program as the user who logs in and wait for it to finish. Off the
+ * main thread, the child is reaped by the supervisor on the main loop, which
+ * then wakes this thread up. */
+int elm_x_run_as_user(const ElmSpawnAttr *user, char *argv[])
+{
+    ElmSpawnAttr  attr = *user;
+    ElmXRun      *run;
+    gint64        deadline;
+    pid_t         pid;
+    int           done;
+
+    attr.argv  = argv;
+    attr.flags = 0;
+
+    if ((pid=elm_spawn(&attr)) < 0) {
+        return -1;
+    }
+
+    if (g_main_context_is_owner(NULL)) {
+        return elm_supervisor_wait(pid, elm_x_get_timeout()*1000);
+    }
+
+    /* One reference for this thread, and one for the exit callback */
+    run       = g_new0(ElmXRun, 1);
+    run->refs = 2;
+    deadline  = g_get_monotonic_time()
+              + (gint64)elm_x_get_timeout()*G_USEC_PER_SEC;
+
+    g_mutex_init(&run->lock);
+    g_cond_init(&run->cond);
+    elm_supervisor_watch(pid, argv[0], elm_x_run_exited, run);
+    g_mutex_lock(&run->lock);
+
+    while (!run->done) {
+        if (!g_cond_wait_until(&run->cond, &run->lock, deadline)) {
+            break;
+        }
+    }
+
+    done = run->done;
+
+    g_mutex_unlock(&run->lock);
+    elm_x_run_unref(run);
+
+    if (!done) {
+        elmprintf(LOGWARN, "'%s' (pid=%d) did not finish in time.", argv[0],
+                  pid);
+        return -2;
     }
 
     return 0;
 }
 
+/* ************************************************************************** */
+/* Wake up the thread waiting on a program run as the user */
+void elm_x_run_exited(pid_t pid, int status, const struct rusage *usage,
+                      void *data)
+{
+    ElmXRun *run = data;
+
+    g_mutex_lock(&run->lock);
+
+    run->done = 1;
+
+    g_cond_signal(&run->cond);
+    g_mutex_unlock(&run->lock);
+    elm_x_run_unref(run);
+}
+
+/* ************************************************************************** */
+/* Drop a reference to a program run as the user. The waiting thread may have
+ * given up before the program exited, so whichever side is last frees it. */
+void elm_x_run_unref(ElmXRun *run)
+{
+    if (!g_atomic_int_dec_and_test(&run->refs)) {
+        return;
+    }
+
+    g_mutex_clear(&run->lock);
+    g_cond_clear(&run->cond);
+    g_free(run);
+}
+
 /* ************************************************************************** */
 /* Set environment variables */
 int elm_x_set_env(void)
 {
     elmprintf(LOGINFO, "Setting up X server environment variables."); 
 
-    if (elm_x_set_display_env() < 0) {
+    /* With -displayfd, DISPLAY is set once Xorg reports it */
+    if (!elm_x_use_displayfd() && (elm_x_set_display_env() < 0)) {
         exit(ELM_EXIT_X_ENV_DISPLAY);
     }
 
@@ -501,13 +1327,15 @@ int elm_x_set_ttyn_env(void)
     ttyn = (strstr(tty, "pts")) ? ttyn+2 : ttyn;
 
     /* Check tty number */
-    if ((ttyn <= 0) || (ttyn > 9)) {
+    if ((ttyn <= 0) || (ttyn > MAX_NR_CONSOLES)) {
         elmprintf(LOGERR, "Invalid number from tty '%s'.", tty);
         return -1;
     }
 
     /* Set ttyn environment variable */
-    char str[2] = {ttyn+'0', 0};
+    char str[ELM_MAX_OPT_SIZE];
+
+    snprintf(str, sizeof(str), "%d", ttyn);
 
     if (elm_std_setenv("TTYN", str) < 0) {
         return -2;
@@ -646,47 +1474,96 @@ cleanup:
 
 /* ************************************************************************** */
 /* Set screen width and height. These are the dimensions of the active
- * monitor.
+ * monitor, unless they are set in the config file. They are kept up to date
+ * as monitors change, so asking costs nothing.
  */
 int elm_x_screen_dimensions(int *width, int *height)
 {
-    Window              window = DefaultRootWindow(XDisplay);
-    XRRScreenResources *screen = XRRGetScreenResources(XDisplay, window);
+    *width  = XWidth;
+    *height = XHeight;
 
-    /* Unable to determine screen info */
-    if (!screen) {
-        elmprintf(LOGERR, "Unable to set screen dimensions.");
-        return 1;
-    }
+    return (XWidth && XHeight) ? 0 : 1;
+}
 
-    /* Check if width and height already set in config file */
-    *width  = elm_conf_read_int("Main", "ScreenWidth");
-    *height = elm_conf_read_int("Main", "ScreenHeight");
+/* ************************************************************************** */
+/* Call a function with the new screen dimensions, each time they change */
+void elm_x_set_screen_callback(ElmXScreenChanged callback, void *data)
+{
+    XScreenCallback = callback;
+    XScreenData     = data;
+}
 
-    if ((*width > 0) && (*height > 0)) {
-        return 0;
+/* ************************************************************************** */
+/* Update the screen dimensions from the monitors and the config file. Return
+ * 1 if they changed. */
+int elm_x_update_screen(void)
+{
+    int width  = elm_conf_read_int("Main", "ScreenWidth");
+    int height = elm_conf_read_int("Main", "ScreenHeight");
+    int status = 0;
+
+    if ((width <= 0) || (height <= 0)) {
+        status = elm_x_query_screen((width <= 0) ? &width : NULL,
+                                    (height <= 0) ? &height : NULL);
     }
 
-    /* Width and height were not set. Set to initial values */
-    if (*width < 0) {
-        *width = 0;
+    if ((width == XWidth) && (height == XHeight)) {
+        return status;
     }
 
-    if (*height < 0) {
-        *height = 0;
+    elmprintf(LOGINFO, "Screen dimensions are %dx%d.", width, height);
+
+    XWidth  = width;
+    XHeight = height;
+
+    return (status < 0) ? status : 1;
+}
+
+/* ************************************************************************** */
+/* Query the size of the monitor at x=0. RandR 1.5 lists every monitor in one
+ * round trip, older servers are asked for each CRTC. The CRTCs are read as
+ * they are, without probing the outputs again. */
+int elm_x_query_screen(int *width, int *height)
+{
+    Window              window = DefaultRootWindow(XDisplay);
+    XRRMonitorInfo     *monitors;
+    XRRScreenResources *screen;
+    XRRCrtcInfo        *info;
+    int                 num;
+    int                 i;
+
+    XRoundTrips++;
+
+    if ((monitors=XRRGetMonitors(XDisplay, window, True, &num))) {
+        for (i=0; (i < num) && (monitors[i].x != 0); i++) {}
+
+        if (i < num) {
+            elm_x_set_size(width, height, monitors[i].width,
+                           monitors[i].height);
+        }
+
+        XRRFreeMonitors(monitors);
+
+        if (i < num) {
+            return 0;
+        }
     }
 
-    /* Set screen dimensions for the monitor at x=0 */
-    int          num = screen->ncrtc;
-    int          i;
-    XRRCrtcInfo *info;
+    XRoundTrips++;
 
-    for (i=0; i < num; i++) {
-        info = XRRGetCrtcInfo(XDisplay, screen, screen->crtcs[i]);
+    if (!(screen=XRRGetScreenResourcesCurrent(XDisplay, window))) {
+        return -1;
+    }
+
+    for (i=0; i < screen->ncrtc; i++) {
+        XRoundTrips++;
+
+        if (!(info=XRRGetCrtcInfo(XDisplay, screen, screen->crtcs[i]))) {
+            continue;
+        }
 
         if (info->x == 0) {
-            *width  = info->width;
-            *height = info->height;
+            elm_x_set_size(width, height, info->width, info->height);
             XRRFreeCrtcInfo(info);
             break;
         }
@@ -694,9 +1571,68 @@ int elm_x_screen_dimensions(int *width, int *height)
         XRRFreeCrtcInfo(info);
     }
 
+    num = screen->ncrtc;
+
     XRRFreeScreenResources(screen);
 
-    return 0;
+    return (i < num) ? 0 : -2;
+}
+
+/* ************************************************************************** */
+/* Fill in the width and height that are asked for */
+void elm_x_set_size(int *width, int *height, int w, int h)
+{
+    if (width) {
+        *width = w;
+    }
+
+    if (height) {
+        *height = h;
+    }
+}
+
+/* ************************************************************************** */
+/* Look for monitor changes among the events of the display. The handling is
+ * left for when the events of a hotplug have all come in. */
+GdkFilterReturn elm_x_screen_event(GdkXEvent *xevent, GdkEvent *event,
+                                   gpointer data)
+{
+    XEvent *ev = xevent;
+
+    if (ev->type == XRREventBase+RRScreenChangeNotify) {
+        XRRUpdateConfiguration(ev);
+    }
+    else if ((ev->type != XRREventBase+RRNotify)
+             || (((XRRNotifyEvent*)ev)->subtype != RRNotify_CrtcChange))
+    {
+        return GDK_FILTER_CONTINUE;
+    }
+
+    if (!XScreenIdle) {
+        XScreenIdle = g_idle_add(elm_x_screen_changed, NULL);
+    }
+
+    return GDK_FILTER_CONTINUE;
+}
+
+/* ************************************************************************** */
+/* Update the screen dimensions after the monitors changed */
+gboolean elm_x_screen_changed(gpointer data)
+{
+    XScreenIdle = 0;
+
+    if ((elm_x_update_screen() > 0) && XScreenCallback) {
+        XScreenCallback(XWidth, XHeight, XScreenData);
+    }
+
+    return G_SOURCE_REMOVE;
+}
+
+/* ************************************************************************** */
+/* Update the screen dimensions after they changed in the config file */
+void elm_x_screen_conf_changed(const char *group, void *data)
+{
+    elm_x_screen_changed(NULL);
 }
 
 /* ************************************************************************** */
@@ -798,27 +1734,70 @@ char * elm_x_get_random_bytes(size_t size)
 }
 
 /* ************************************************************************** */
-/* Return open tty */
+/* Return open tty. The kernel is asked first, searching /proc is the last
+ * resort since it gets slower with every running process. */
 /* Note: stackoverflow.com/questions/12181820/get-foreground-console-find-active-x-server */
 char * elm_x_get_tty(void)
 {
     char *tty;
 
-    if ((tty=elm_x_get_tty_from_proc())) {
+    if ((tty=elm_x_get_tty_from_vt())) {
         return tty;
     }
 
-    if ((tty=elm_x_get_tty_from_pts())) {
+    if ((tty=elm_x_get_tty_from_sys())) {
         return tty;
     }
 
-    if ((tty=elm_x_get_tty_from_sys())) {
+    if ((tty=elm_x_get_tty_from_proc())) {
+        return tty;
+    }
+
+    if ((tty=elm_x_get_tty_from_pts())) {
         return tty;
     }
 
     return NULL;
 }
 
+/* ************************************************************************** */
+/* Return the first free virtual terminal, as reported by the kernel. The state
+ * mask is used when the query fails, though it only covers the first 16. */
+char * elm_x_get_tty_from_vt(void)
+{
+    struct vt_stat state;
+    int            vt = -1;
+    int            fd;
+    int            i;
+
+    if ((fd=open("/dev/tty0", O_WRONLY | O_NOCTTY | O_CLOEXEC)) < 0) {
+        elmprintf(LOGERRNO, "%s '%s'", "Unable to open", "/dev/tty0");
+        return NULL;
+    }
+
+    if ((ioctl(fd, VT_OPENQRY, &vt) < 0) || (vt <= 0)) {
+        vt = -1;
+
+        if (ioctl(fd, VT_GETSTATE, &state) == 0) {
+            for (i=1; i < 16; i++) {
+                if (!(state.v_state & (1 << i))) {
+                    vt = i;
+                    break;
+                }
+            }
+        }
+    }
+
+    close(fd);
+
+    if (vt <= 0) {
+        elmprintf(LOGWARN, "Unable to find a free virtual terminal.");
+        return NULL;
+    }
+
+    return elm_str_vcopy(ELM_MAX_OPT_SIZE, "tty%d", vt);
+}
+
 /* ************************************************************************** */
 /* Return active tty from /sys/ directory */
 char * elm_x_get_tty_from_sys(void)
@@ -856,76 +1835,70 @@ char * elm_x_get_tty_from_pts(void)
 }
 
 /* ************************************************************************** */
-/* Return open tty by searching /proc directory */
+/* Return open tty by searching /proc directory. Only the open files of Xorg
+ * processes are looked at. */
 char * elm_x_get_tty_from_proc(void)
 {
+    ElmSysProc     proc;
     DIR           *dhandle;
     struct dirent *entry;
-    char          *dirpath;
+    int            ignore[MAX_NR_CONSOLES] = {0};
+    int            index;
+    int            fd;
 
-    /* Iterate over current process ids */
-    char **proc      = elm_sys_get_proc();
-    int    ignore[7] = {0};
-    int    index;
-    int    i;
+    if (elm_sys_proc_open(&proc, "/proc", ELM_SYS_ANY_UID, "Xorg") < 0) {
+        return NULL;
+    }
 
-    for (i=0; proc[i]; i++)
+    while (elm_sys_proc_next(&proc) > 0)
     {
         /* Unable to open directory */
-        dirpath = elm_str_path("/proc/%s/fd/", proc[i]);
+        if (((fd=elm_sys_proc_openat(&proc, "fd", O_RDONLY | O_DIRECTORY)) < 0)
+            || !(dhandle=fdopendir(fd)))
+        {
+            elmprintf(LOGERRNO, "%s '/proc/%s/fd'",
+                      "Unable to open directory", proc.name);
 
-        elmprintf(LOGWARN, "Proc: '%s'", proc[i]);
+            if (fd >= 0) {
+                close(fd);
+            }
 
-        if (!(dhandle=opendir(dirpath))) {
-            elmprintf(LOGERRNO, "%s '%s'",
-                      "Unable to open directory", dirpath);
-            elm_std_free(&dirpath);
-            elm_std_free(&proc[i]);
             continue;
         }
 
         /* Iterate over directory contents */
         while ((entry=readdir(dhandle)))
         {
-            if (!strcmp(entry->d_name, ".") || !strcmp(entry->d_name, "..")) {
+            if (entry->d_name[0] == '.') {
                 continue;
             }
 
-            /* Determine full path */
-            index = elm_x_get_tty_index_from_proc(dirpath, entry->d_name, proc[i]);
+            index = elm_x_get_tty_index_from_proc(fd, entry->d_name);
 
-            if ((index >= 0) && (!ignore[index])) {
+            if ((index >= 0) && (index < MAX_NR_CONSOLES)) {
                 ignore[index] = 1;
             }
         }
 
-        /* Cleanup */
         closedir(dhandle);
-        elm_std_free(&dirpath);
-        elm_std_free(&proc[i]);
     }
 
-    elm_std_free(&proc);
+    elm_sys_proc_close(&proc);
 
-    return elm_x_get_tty_open_from_proc(ignore, sizeof ignore);
+    return elm_x_get_tty_open_from_proc(ignore, MAX_NR_CONSOLES);
 }
 
 /* ************************************************************************** */
 /* Return open tty */
 char * elm_x_get_tty_open_from_proc(int *ignore, size_t size)
 {
-    char *open   = NULL;
-    int   length = 5;
+    char *open = NULL;
     int   i;
 
     /* Iterate over tty ignore list */
     for (i=0; i < size; i++) {
         if (!ignore[i]) {
-            if (!(open=calloc(length, sizeof *open))) {
-                continue;
-            }
-
-            snprintf(open, length, "tty%d", i+1);
+            open = elm_str_vcopy(ELM_MAX_OPT_SIZE, "tty%d", i+1);
             break;
         }
     }
@@ -939,34 +1912,28 @@ char * elm_x_get_tty_open_from_proc(int *ignore, size_t size)
 }
 
 /* ************************************************************************** */
-/* Return tty in index form if it should be ignored because it is in use */
-int elm_x_get_tty_index_from_proc(char *dir, char *name, char *proc)
+/* Return tty in index form if the open file of a process is a tty */
+int elm_x_get_tty_index_from_proc(int dirfd, const char *name)
 {
-    int          status      = -1;
-    char        *symlinkpath = elm_str_path("%s%s", dir, name);
-    static char  fullpath[ELM_MAX_PATH_SIZE];
+    char  fullpath[ELM_MAX_PATH_SIZE] = {0};
+    char *end;
+    long  ttyn;
 
-    memset(fullpath, 0, sizeof(fullpath));
-    readlink(symlinkpath, fullpath, sizeof(fullpath)-1);
+    if (readlinkat(dirfd, name, fullpath, sizeof(fullpath)-1) < 0) {
+        return -1;
+    }
 
-    /* Ignore tty if running Xorg */
-    if (strstr(fullpath, "/dev/tty")) {
-        char *cmdpath = elm_str_path("/proc/%s/cmdline", proc);
-        char *tty     = elm_str_readline(cmdpath);
-        int   index   = (fullpath[8]-'0')-1;
+    if (strncmp(fullpath, "/dev/tty", 8)) {
+        return -1;
+    }
 
-        if (tty && strstr(tty, "Xorg")) {
-            status = index;
-        }
+    ttyn = strtol(&fullpath[8], &end, 10);
 
-        /* Clear memory */
-        elm_std_free(&cmdpath);
-        elm_std_free(&tty);
+    if ((end == &fullpath[8]) || (*end != '\0') || (ttyn <= 0)) {
+        return -1;
     }
 
-    elm_std_free(&symlinkpath);
-
-    return status;
+    return ttyn-1;
 }
 
 /* ************************************************************************** */
@@ -975,3 +1942,54 @@ int elm_x_is_running(void)
 {
     return (getenv("DISPLAY")) ? 1 : 0;
 }
+
+/* ************************************************************************** */
+/* Read the display number from the -displayfd pipe. It is done once a full
+ * line was read, or once the pipe is closed. */
+gboolean elm_x_displayfd_ready(gint fd, GIOCondition condition, gpointer data)
+{
+    ElmXReady *ready = data;
+    size_t     size  = sizeof(ready->buffer)-1-ready->length;
+    ssize_t    nbytes;
+
+    if ((nbytes=read(fd, &ready->buffer[ready->length], size)) > 0) {
+        ready->length                += nbytes;
+        ready->buffer[ready->length]  = '\0';
+
+        if (!strchr(ready->buffer, '\n')
+            && (ready->length < sizeof(ready->buffer)-1))
+        {
+            return G_SOURCE_CONTINUE;
+        }
+
+        ready->display = atoi(ready->buffer);
+    }
+    else if ((nbytes < 0) && ((errno == EINTR) || (errno == EAGAIN))) {
+        return G_SOURCE_CONTINUE;
+    }
+    else {
+        elmprintf(LOGERR, "X server exited before it was ready.");
+    }
+
+    ready->watch = 0;
+
+    g_main_loop_quit(ready->loop);
+
+    return G_SOURCE_REMOVE;
+}
+
+/* ************************************************************************** */
+/* Stop waiting for Xorg to report its display number */
+gboolean elm_x_displayfd_timeout(gpointer data)
+{
+    ElmXReady *ready = data;
+
+    elmprintf(LOGERR, "X server was not ready after %d seconds.",
+              elm_x_get_timeout());
+
+    ready->timer = 0;
+
+    g_main_loop_quit(ready->loop);
+
+    return G_SOURCE_REMOVE;
+}
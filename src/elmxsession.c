@@ -0,0 +1,628 @@
+/* *****************************************************************************
+ * 
+ * Name:    elmxsession.c
+ * Author:  Gabriel Gonzalez
+ * Email:   gabeg@bu.edu
+ * License: The MIT License (MIT)
+ * 
+ * Description: Catalogue of the xsessions installed on the system.
+ *              
+ * Notes: The xsessions are parsed from their desktop files once, and the
+ *        result is kept in the cache directory. The cache is used as long as
+ *        the mtime of every xsession directory, and the mtime and size of
+ *        every file in it, are the same as when it was written. Adding or
+ *        removing a file changes the mtime of its directory, and editing one
+ *        changes its own, so checking the cache costs a stat() per file
+ *        instead of opening and reading each of them.
+ * 
+ *        An xsession in /usr/local overrides the one with the same file name
+ *        in /usr/share, as with XDG_DATA_DIRS, so each is listed once. Hidden
+ *        xsessions are left out of the catalogue. Those whose TryExec cannot
+ *        be run are kept in it, but left out of the menu, because installing
+ *        the program does not touch the xsession files.
+ * 
+ *        While the greeter runs, the directories are watched with inotify. A
+ *        change rescans them on a worker thread, and the new catalogue is
+ *        swapped in from the main loop, where it is only ever read.
+ * 
+ * *****************************************************************************
+ */
+
+/* Includes */
+#include "elmxsession.h"
+#include "elmdef.h"
+#include "elmio.h"
+#include "elmstd.h"
+#include "elmstr.h"
+#include "elmtrace.h"
+#include <dirent.h>
+#include <glib-unix.h>
+#include <glib/gstdio.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+
+/* Defines */
+#define ELM_XSESSION_CACHE   ELM_CACHE_DIR "/xsessions"
+#define ELM_XSESSION_VERSION 3
+#define ELM_XSESSION_DIRS    2
+
+/* Typedefs */
+typedef struct
+{
+    GPtrArray *sessions;
+    GPtrArray *available;
+    gint64     mtimes[ELM_XSESSION_DIRS];
+} ElmXSessionCatalogue;
+
+/* Private functions */
+static ElmXSessionCatalogue * elm_xsession_scan(void);
+static int                    elm_xsession_scan_dir(ElmXSessionCatalogue *catalogue,
+                                                    const char *dir,
+                                                    GHashTable *ids);
+static int                    elm_xsession_parse(ElmXSession *session,
+                                                 const char *path);
+static void                   elm_xsession_filter(ElmXSessionCatalogue *catalogue);
+static const char *           elm_xsession_get_locale(void);
+static ElmXSessionCatalogue * elm_xsession_read_cache(void);
+static int                    elm_xsession_write_cache(ElmXSessionCatalogue *catalogue);
+static ElmXSessionCatalogue * elm_xsession_catalogue_new(void);
+static void                   elm_xsession_catalogue_free(ElmXSessionCatalogue *catalogue);
+static void                   elm_xsession_free(gpointer data);
+static gint                   elm_xsession_compare(gconstpointer a,
+                                                   gconstpointer b);
+static gint64                 elm_xsession_get_mtime(const char *path,
+                                                     gint64 *size);
+static gboolean               elm_xsession_watch_event(gint fd,
+                                                       GIOCondition condition,
+                                                       gpointer data);
+static gboolean               elm_xsession_refresh_timeout(gpointer data);
+static void *                 elm_xsession_refresh(void *data);
+static gboolean               elm_xsession_refreshed(gpointer data);
+
+/* Private variables */
+/* In order of precedence, like XDG_DATA_DIRS */
+static const char           *Dirs[ELM_XSESSION_DIRS+1] = {
+    "/usr/local/share/xsessions",
+    "/usr/share/xsessions",
+    NULL
+};
+
+static const guint           RefreshDelay    = 250;
+static ElmXSessionCatalogue *Catalogue       = NULL;
+static ElmXSessionChanged    ChangedCallback = NULL;
+static void                 *ChangedData     = NULL;
+static int                   WatchFd         = -1;
+static guint                 RefreshId       = 0;
+static int                   Refreshing      = 0;
+static int                   Pending         = 0;
+
+/* ************************************************************************** */
+/* Load the xsession catalogue from the cache, or else scan the xsession
+ * directories and write the cache. Meant to run before the greeter is built,
+ * it is not locked. */
+int elm_xsession_load(void)
+{
+    int64_t     start  = elm_trace_begin();
+    const char *source = "cache";
+
+    if (Catalogue) {
+        return 0;
+    }
+
+    if (!(Catalogue=elm_xsession_read_cache())) {
+        source    = "scan";
+        Catalogue = elm_xsession_scan();
+
+        elm_xsession_write_cache(Catalogue);
+    }
+
+    elm_xsession_filter(Catalogue);
+    elmprintf(LOGINFO, "Loaded %u of %u xsession(s) from %s.",
+              Catalogue->available->len, Catalogue->sessions->len, source);
+    elm_trace_end("xsessions", start);
+
+    return 0;
+}
+
+/* ************************************************************************** */
+/* Return an xsession, or NULL past the last one. Only call from the main
+ * loop. */
+const ElmXSession * elm_xsession_get(size_t index)
+{
+    elm_xsession_load();
+
+    if (index >= Catalogue->available->len) {
+        return NULL;
+    }
+
+    return g_ptr_array_index(Catalogue->available, index);
+}
+
+/* ************************************************************************** */
+/* Watch the xsession directories, and call a function each time the catalogue
+ * changed */
+int elm_xsession_watch(ElmXSessionChanged callback, void *data)
+{
+    uint32_t mask = (IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE
+                     | IN_DELETE | IN_ONLYDIR);
+    size_t   i;
+
+    ChangedCallback = callback;
+    ChangedData     = data;
+
+    if (WatchFd >= 0) {
+        return 0;
+    }
+
+    if ((WatchFd=inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) < 0) {
+        elmprintf(LOGERRNO, "Unable to initialize inotify");
+        return -1;
+    }
+
+    for (i=0; Dirs[i]; i++)
+    {
+        if (inotify_add_watch(WatchFd, Dirs[i], mask) < 0) {
+            elmprintf(LOGDEBUG, "Not watching xsession directory '%s'.",
+                      Dirs[i]);
+        }
+    }
+
+    g_unix_fd_add(WatchFd, G_IO_IN, elm_xsession_watch_event, NULL);
+
+    return 0;
+}
+
+/* ************************************************************************** */
+/* Scan the xsession directories into a new catalogue. An xsession is known by
+ * its desktop file ID, the file name, and the first directory that has it
+ * wins. The catalogue is sorted once every directory was merged. */
+ElmXSessionCatalogue * elm_xsession_scan(void)
+{
+    ElmXSessionCatalogue *catalogue = elm_xsession_catalogue_new();
+    GHashTable           *ids       = g_hash_table_new_full(g_str_hash,
+                                                            g_str_equal,
+                                                            g_free, NULL);
+    size_t                i;
+
+    for (i=0; Dirs[i]; i++)
+    {
+        catalogue->mtimes[i] = elm_xsession_get_mtime(Dirs[i], NULL);
+
+        elm_xsession_scan_dir(catalogue, Dirs[i], ids);
+    }
+
+    g_hash_table_destroy(ids);
+    g_ptr_array_sort(catalogue->sessions, elm_xsession_compare);
+
+    return catalogue;
+}
+
+/* ************************************************************************** */
+/* Add the xsessions in a directory to a catalogue, except the ones whose ID is
+ * already taken. A hidden or invalid file still takes its ID, so that it can
+ * hide the same xsession in a directory further down. */
+int elm_xsession_scan_dir(ElmXSessionCatalogue *catalogue, const char *dir,
+                          GHashTable *ids)
+{
+    DIR           *dhandle = opendir(dir);
+    struct dirent *entry;
+    ElmXSession   *session;
+    char          *path;
+
+    if (!dhandle) {
+        return -1;
+    }
+
+    while ((entry=readdir(dhandle)))
+    {
+        if (((entry->d_type != DT_REG) && (entry->d_type != DT_UNKNOWN))
+            || !g_str_has_suffix(entry->d_name, ".desktop"))
+        {
+            continue;
+        }
+
+        if (g_hash_table_contains(ids, entry->d_name)) {
+            continue;
+        }
+
+        g_hash_table_add(ids, g_strdup(entry->d_name));
+
+        path    = g_strdup_printf("%s/%s", dir, entry->d_name);
+        session = g_new0(ElmXSession, 1);
+
+        session->file  = path;
+        session->mtime = elm_xsession_get_mtime(path, &session->size);
+
+        if ((session->mtime < 0) || (elm_xsession_parse(session, path) != 0)) {
+            elm_xsession_free(session);
+            continue;
+        }
+
+        g_ptr_array_add(catalogue->sessions, session);
+    }
+
+    closedir(dhandle);
+
+    return 0;
+}
+
+/* ************************************************************************** */
+/* Read the name and command of an xsession from its desktop file. Return 1 if
+ * it is hidden. */
+int elm_xsession_parse(ElmXSession *session, const char *path)
+{
+    ElmStrDesktopEntry entry;
+
+    if (elm_str_read_desktop_entry(path, elm_xsession_get_locale(),
+                                   &entry) < 0)
+    {
+        elmprintf(LOGWARN, "Ignoring invalid xsession '%s'.", path);
+        return -1;
+    }
+
+    if (entry.hidden) {
+        elm_str_free_desktop_entry(&entry);
+        return 1;
+    }
+
+    session->name    = g_strdup(entry.name);
+    session->exec    = g_strdup(entry.exec);
+    session->tryexec = g_strdup(entry.tryexec);
+
+    elm_str_free_desktop_entry(&entry);
+
+    return 0;
+}
+
+/* ************************************************************************** */
+/* List the xsessions of a catalogue whose TryExec, if any, can be run */
+void elm_xsession_filter(ElmXSessionCatalogue *catalogue)
+{
+    ElmXSession *session;
+    size_t       i;
+
+    g_ptr_array_set_size(catalogue->available, 0);
+
+    for (i=0; i < catalogue->sessions->len; i++)
+    {
+        session = g_ptr_array_index(catalogue->sessions, i);
+
+        if (!session->tryexec || elm_str_is_executable(session->tryexec)) {
+            g_ptr_array_add(catalogue->available, session);
+        }
+    }
+}
+
+/* ************************************************************************** */
+/* Return the locale that xsession names are shown in */
+const char * elm_xsession_get_locale(void)
+{
+    static const char *vars[] = {"LC_ALL", "LC_MESSAGES", "LANG", NULL};
+    const char        *locale;
+    size_t             i;
+
+    for (i=0; vars[i]; i++)
+    {
+        if ((locale=getenv(vars[i])) && *locale) {
+            return locale;
+        }
+    }
+
+    return "C";
+}
+
+/* ************************************************************************** */
+/* Return the catalogue in the cache, or NULL if the cache is missing or out of
+ * date */
+ElmXSessionCatalogue * elm_xsession_read_cache(void)
+{
+    ElmXSessionCatalogue  *catalogue = NULL;
+    ElmXSession           *session;
+    GKeyFile              *keyfile   = g_key_file_new();
+    char                 **groups    = NULL;
+    char                  *locale    = NULL;
+    char                   key[ELM_MAX_CONF_SIZE];
+    const char            *path;
+    gint64                 size;
+    size_t                 i;
+
+    if (!g_key_file_load_from_file(keyfile, ELM_XSESSION_CACHE,
+                                   G_KEY_FILE_NONE, NULL)
+        || (g_key_file_get_integer(keyfile, "Catalogue", "Version", NULL)
+            != ELM_XSESSION_VERSION))
+    {
+        goto cleanup;
+    }
+
+    /* The names were localized for another locale */
+    locale = g_key_file_get_string(keyfile, "Catalogue", "Locale", NULL);
+
+    if (g_strcmp0(locale, elm_xsession_get_locale()) != 0) {
+        goto cleanup;
+    }
+
+    /* A file was added to or removed from a directory */
+    for (i=0; Dirs[i]; i++)
+    {
+        snprintf(key, sizeof(key), "MTime%zu", i);
+
+        if (g_key_file_get_int64(keyfile, "Catalogue", key, NULL)
+            != elm_xsession_get_mtime(Dirs[i], NULL))
+        {
+            goto cleanup;
+        }
+    }
+
+    catalogue = elm_xsession_catalogue_new();
+    groups    = g_key_file_get_groups(keyfile, NULL);
+
+    for (i=0; groups[i]; i++)
+    {
+        if (!g_str_has_prefix(groups[i], "Session ")) {
+            continue;
+        }
+
+        session = g_new0(ElmXSession, 1);
+
+        g_ptr_array_add(catalogue->sessions, session);
+
+        session->file    = g_key_file_get_string(keyfile, groups[i], "File",
+                                                 NULL);
+        session->name    = g_key_file_get_string(keyfile, groups[i], "Name",
+                                                 NULL);
+        session->exec    = g_key_file_get_string(keyfile, groups[i], "Exec",
+                                                 NULL);
+        session->tryexec = g_key_file_get_string(keyfile, groups[i], "TryExec",
+                                                 NULL);
+        session->mtime   = g_key_file_get_int64(keyfile, groups[i], "MTime",
+                                                NULL);
+        session->size    = g_key_file_get_int64(keyfile, groups[i], "Size",
+                                                NULL);
+        path             = session->file;
+
+        /* A file was edited in place */
+        if (!path || !session->name || !session->exec
+            || (elm_xsession_get_mtime(path, &size) != session->mtime)
+            || (size != session->size))
+        {
+            elm_xsession_catalogue_free(catalogue);
+            catalogue = NULL;
+            break;
+        }
+    }
+
+cleanup:
+    g_free(locale);
+    g_strfreev(groups);
+    g_key_file_free(keyfile);
+
+    return catalogue;
+}
+
+/* ************************************************************************** */
+/* Write a catalogue to the cache */
+int elm_xsession_write_cache(ElmXSessionCatalogue *catalogue)
+{
+    ElmXSession *session;
+    GKeyFile    *keyfile = g_key_file_new();
+    GError      *err     = NULL;
+    char         group[ELM_MAX_CONF_SIZE];
+    char         key[ELM_MAX_CONF_SIZE];
+    size_t       i;
+
+    g_key_file_set_integer(keyfile, "Catalogue", "Version",
+                           ELM_XSESSION_VERSION);
+    g_key_file_set_string(keyfile, "Catalogue", "Locale",
+                          elm_xsession_get_locale());
+
+    for (i=0; Dirs[i]; i++)
+    {
+        snprintf(key, sizeof(key), "MTime%zu", i);
+        g_key_file_set_int64(keyfile, "Catalogue", key, catalogue->mtimes[i]);
+    }
+
+    for (i=0; i < catalogue->sessions->len; i++)
+    {
+        session = g_ptr_array_index(catalogue->sessions, i);
+
+        snprintf(group, sizeof(group), "Session %zu", i);
+        g_key_file_set_string(keyfile, group, "File", session->file);
+        g_key_file_set_string(keyfile, group, "Name", session->name);
+        g_key_file_set_string(keyfile, group, "Exec", session->exec);
+
+        if (session->tryexec) {
+            g_key_file_set_string(keyfile, group, "TryExec", session->tryexec);
+        }
+
+        g_key_file_set_int64(keyfile, group, "MTime", session->mtime);
+        g_key_file_set_int64(keyfile, group, "Size", session->size);
+    }
+
+    /* Same mode as the background cache, which shares the directory */
+    if (g_mkdir_with_parents(ELM_CACHE_DIR, 0755) < 0) {
+        elmprintf(LOGERRNO, "%s '%s'", "Unable to create directory",
+                  ELM_CACHE_DIR);
+        g_key_file_free(keyfile);
+        return -1;
+    }
+
+    /* Written to a temporary file and renamed over the cache */
+    if (!g_key_file_save_to_file(keyfile, ELM_XSESSION_CACHE, &err)) {
+        elmprintf(LOGWARN, "Unable to write xsession cache '%s': %s.",
+                  ELM_XSESSION_CACHE, err->message);
+        g_error_free(err);
+        g_key_file_free(keyfile);
+        return -1;
+    }
+
+    g_key_file_free(keyfile);
+
+    return 0;
+}
+
+/* ************************************************************************** */
+/* Create an empty catalogue */
+ElmXSessionCatalogue * elm_xsession_catalogue_new(void)
+{
+    ElmXSessionCatalogue *catalogue = g_new0(ElmXSessionCatalogue, 1);
+
+    catalogue->sessions  = g_ptr_array_new_with_free_func(elm_xsession_free);
+    catalogue->available = g_ptr_array_new();
+
+    return catalogue;
+}
+
+/* ************************************************************************** */
+/* Free a catalogue and its xsessions */
+void elm_xsession_catalogue_free(ElmXSessionCatalogue *catalogue)
+{
+    if (!catalogue) {
+        return;
+    }
+
+    g_ptr_array_free(catalogue->available, TRUE);
+    g_ptr_array_free(catalogue->sessions, TRUE);
+    g_free(catalogue);
+}
+
+/* ************************************************************************** */
+/* Free an xsession */
+void elm_xsession_free(gpointer data)
+{
+    ElmXSession *session = data;
+
+    g_free(session->name);
+    g_free(session->exec);
+    g_free(session->tryexec);
+    g_free(session->file);
+    g_free(session);
+}
+
+/* ************************************************************************** */
+/* Compare two xsessions by name, for sorting */
+gint elm_xsession_compare(gconstpointer a, gconstpointer b)
+{
+    const ElmXSession *sa = *(ElmXSession* const*)a;
+    const ElmXSession *sb = *(ElmXSession* const*)b;
+
+    return g_strcmp0(sa->name, sb->name);
+}
+
+/* ************************************************************************** */
+/* Return the mtime of a file in nanoseconds, and its size. A file that does
+ * not exist has an mtime of -1. */
+gint64 elm_xsession_get_mtime(const char *path, gint64 *size)
+{
+    struct stat info;
+
+    if (stat(path, &info) < 0) {
+        return -1;
+    }
+
+    if (size) {
+        *size = info.st_size;
+    }
+
+    return (gint64)info.st_mtim.tv_sec * G_GINT64_CONSTANT(1000000000)
+        + info.st_mtim.tv_nsec;
+}
+
+/* ************************************************************************** */
+/* Handle inotify events in the xsession directories. Refreshing is delayed a
+ * little so that a package installing several xsessions results in a single
+ * refresh. */
+gboolean elm_xsession_watch_event(gint fd, GIOCondition condition,
+                                  gpointer data)
+{
+    char                        buf[4096]
+                                __attribute__((aligned(__alignof__(struct inotify_event))));
+    const struct inotify_event *event;
+    ssize_t                     nbytes;
+    char                       *ptr;
+    int                         refresh = 0;
+
+    while ((nbytes=read(fd, buf, sizeof(buf))) > 0)
+    {
+        for (ptr=buf; ptr < buf+nbytes; ptr += sizeof(*event)+event->len)
+        {
+            event    = (const struct inotify_event*) ptr;
+            refresh |= (event->len && g_str_has_suffix(event->name, ".desktop"));
+        }
+    }
+
+    if (refresh && !RefreshId) {
+        RefreshId = g_timeout_add(RefreshDelay, elm_xsession_refresh_timeout,
+                                  NULL);
+    }
+
+    return G_SOURCE_CONTINUE;
+}
+
+/* ************************************************************************** */
+/* Start rescanning the xsession directories once they settle down. A change
+ * that comes in during a rescan is picked up by another one right after. */
+gboolean elm_xsession_refresh_timeout(gpointer data)
+{
+    pthread_t thread;
+
+    RefreshId = 0;
+
+    if (Refreshing) {
+        Pending = 1;
+        return G_SOURCE_REMOVE;
+    }
+
+    if (pthread_create(&thread, NULL, elm_xsession_refresh, NULL) != 0) {
+        elmprintf(LOGERR, "Unable to start xsession refresh.");
+        return G_SOURCE_REMOVE;
+    }
+
+    pthread_detach(thread);
+
+    Refreshing = 1;
+
+    return G_SOURCE_REMOVE;
+}
+
+/* ************************************************************************** */
+/* Rescan the xsession directories. Runs on its own thread. */
+void * elm_xsession_refresh(void *data)
+{
+    ElmXSessionCatalogue *catalogue = elm_xsession_scan();
+
+    elm_xsession_write_cache(catalogue);
+    g_idle_add(elm_xsession_refreshed, catalogue);
+
+    return NULL;
+}
+
+/* ************************************************************************** */
+/* Swap in a rescanned catalogue, from the main loop */
+gboolean elm_xsession_refreshed(gpointer data)
+{
+    ElmXSessionCatalogue *old = Catalogue;
+
+    Catalogue  = data;
+    Refreshing = 0;
+
+    elm_xsession_filter(Catalogue);
+    elmprintf(LOGINFO, "Refreshed xsessions, %u of %u available.",
+              Catalogue->available->len, Catalogue->sessions->len);
+    elm_xsession_catalogue_free(old);
+
+    if (ChangedCallback) {
+        ChangedCallback(ChangedData);
+    }
+
+    if (Pending) {
+        Pending = 0;
+        elm_xsession_refresh_timeout(NULL);
+    }
+
+    return G_SOURCE_REMOVE;
+}